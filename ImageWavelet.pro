@@ -2,28 +2,17 @@
 #
 # Project created by QtCreator 2015-05-03T18:01:20
 #
+# core  - статическая библиотека поиска (без графического интерфейса)
+# app   - приложение ImageWavelet
+# batch - пакетная обработка без графического интерфейса
+# bench - проверка и замеры вычислительных процедур
+#
 #-------------------------------------------------
 
-QT       += core gui concurrent
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-TARGET = ImageWavelet
-TEMPLATE = app
-
+TEMPLATE = subdirs
 
-SOURCES += main.cpp\
-        mainwindow.cpp \
-    imageviewer.cpp \
-    wavelet.cpp \
-    imageutils.cpp \
-    matrixutils.cpp
+SUBDIRS = core app batch bench
 
-HEADERS  += mainwindow.h \
-    imageviewer.h \
-    wavelet.h \
-    performancetimer.h \
-    performancetimer.h \
-    imageutils.h \
-    matrix.h \
-    matrixutils.h
+app.depends = core
+batch.depends = core
+bench.depends = core
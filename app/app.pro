@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Project created by QtCreator 2015-05-03T18:01:20
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11
+
+TARGET = ImageWavelet
+TEMPLATE = app
+
+include(../corelib.pri)
+
+SOURCES += ../main.cpp\
+        ../mainwindow.cpp \
+    ../imageviewer.cpp \
+    ../imageutils.cpp
+
+HEADERS  += ../mainwindow.h \
+    ../imageviewer.h \
+    ../imageutils.h
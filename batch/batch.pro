@@ -0,0 +1,26 @@
+#-------------------------------------------------
+#
+# Пакетный поиск без графического интерфейса
+# (результаты выводятся в формате JSON Lines)
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = ImageWaveletBatch
+TEMPLATE = app
+
+include(../corelib.pri)
+
+SOURCES += ../batchmain.cpp \
+    ../batchprocessor.cpp \
+    ../scanlinereader.cpp \
+    ../imageutils.cpp
+
+HEADERS += ../batchprocessor.h \
+    ../scanlinereader.h \
+    ../imageutils.h
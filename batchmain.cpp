@@ -0,0 +1,178 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+#include <QtConcurrent/QtConcurrent>
+
+#include "batchprocessor.h"
+#include "circlesearch.h"
+#include "detector.h"
+#include "trace.h"
+#include "tuning.h"
+
+#include <cstdio>
+
+
+// Пакетный поиск шарика в изображениях без графического интерфейса.
+// Пример запуска:
+// ImageWaveletBatch --recursive --output results.jsonl images/ extra.png
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("ImageWaveletBatch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Find a light circle on the dark background in images "
+                                     "and print results as JSON Lines.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("paths", "Image files or directories.", "[paths...]");
+
+    QCommandLineOption listOption(QStringList() << "l" << "list",
+                                  "Read image paths (one per line) from <file> ('-' for stdin).",
+                                  "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Write results to <file> instead of stdout.", "file");
+    QCommandLineOption recursiveOption(QStringList() << "r" << "recursive",
+                                       "Scan directories recursively.");
+    QCommandLineOption trackOption(QStringList() << "t" << "track",
+                                   "Treat images as a frame sequence and track the circle between frames.");
+    QCommandLineOption threadsOption("decode-threads",
+                                     "Number of image decoding threads.", "count");
+    QCommandLineOption pendingOption("max-pending",
+                                     "Maximum number of decoded images waiting for search.", "count");
+    QCommandLineOption tileOption("tile",
+                                  "Read each image in tiles of <size> pixels with bounded memory "
+                                  "(for very large binary PGM/PPM or uncompressed BMP images).", "size");
+    QCommandLineOption maxDiameterOption("max-diameter",
+                                         "Maximum circle diameter in pixels for --tile (default 256).",
+                                         "pixels");
+    QCommandLineOption traceOption("trace",
+                                   "Write stage timings to <file> in Chrome trace event format "
+                                   "(with per-stage histograms).", "file");
+    QCommandLineOption profileOption("profile",
+                                     "Load the performance profile from <file> instead of the "
+                                     "default one (with --calibrate - save it to <file>).", "file");
+    QCommandLineOption calibrateOption("calibrate",
+                                       "Measure search speed on this machine, choose the performance "
+                                       "profile for a search time of <ms> per frame, save it and exit.",
+                                       "ms");
+    parser.addOption(listOption);
+    parser.addOption(outputOption);
+    parser.addOption(recursiveOption);
+    parser.addOption(trackOption);
+    parser.addOption(threadsOption);
+    parser.addOption(pendingOption);
+    parser.addOption(tileOption);
+    parser.addOption(maxDiameterOption);
+    parser.addOption(traceOption);
+    parser.addOption(profileOption);
+    parser.addOption(calibrateOption);
+    parser.process(a);
+
+    const QString profilePath(parser.isSet(profileOption) ? parser.value(profileOption)
+                                                          : Tuning::getDefaultPath());
+
+    // Подбор профиля производительности (без файлов изображений)
+    if (parser.isSet(calibrateOption)) {
+        const double targetMs = parser.value(calibrateOption).toDouble();
+        if (targetMs <= 0.0)
+            parser.showHelp(2);
+        const Tuning::Profile profile(Tuning::calibrate(targetMs));
+        if (!Tuning::save(profilePath, profile)) {
+            qCritical("Cannot write profile file \"%s\"", qPrintable(profilePath));
+            return 2;
+        }
+        QFile outFile;
+        outFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+        outFile.write(Tuning::toJson(profile) + '\n');
+        return 0;
+    }
+
+    // Профиль производительности загружается до первого поиска
+    // (файл по-умолчанию может отсутствовать - тогда профиль по-умолчанию)
+    Tuning::Profile profile;
+    if (Tuning::load(profilePath, &profile)) {
+        Tuning::setProfile(profile);
+    }
+    else if (parser.isSet(profileOption)) {
+        qCritical("Cannot read profile file \"%s\"", qPrintable(profilePath));
+        return 2;
+    }
+
+    // Собрать пути к изображениям
+    QStringList paths(parser.positionalArguments());
+    if (parser.isSet(listOption)) {
+        QFile listFile;
+        const QString listPath(parser.value(listOption));
+        bool opened = false;
+        if (listPath == "-") {
+            opened = listFile.open(stdin, QIODevice::ReadOnly | QIODevice::Text);
+        }
+        else {
+            listFile.setFileName(listPath);
+            opened = listFile.open(QIODevice::ReadOnly | QIODevice::Text);
+        }
+        if (!opened) {
+            qCritical("Cannot open list file \"%s\"", qPrintable(listPath));
+            return 2;
+        }
+        QTextStream list(&listFile);
+        while (!list.atEnd()) {
+            const QString line(list.readLine().trimmed());
+            if (!line.isEmpty())
+                paths.append(line);
+        }
+    }
+    if (paths.isEmpty())
+        parser.showHelp(2);
+
+    // Открыть выходной поток
+    QFile outFile;
+    bool opened = false;
+    if (parser.isSet(outputOption)) {
+        outFile.setFileName(parser.value(outputOption));
+        opened = outFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+    }
+    else {
+        opened = outFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!opened) {
+        qCritical("Cannot open output file \"%s\"", qPrintable(parser.value(outputOption)));
+        return 2;
+    }
+    QTextStream out(&outFile);
+
+    // Матрицы вейвлета строятся в фоне, пока загружаются первые изображения
+    QFuture<void> prewarm(QtConcurrent::run(CircleSearch::prewarmKernels));
+
+    BatchProcessor processor(&out);
+    processor.setTracking(parser.isSet(trackOption));
+    if (parser.isSet(threadsOption))
+        processor.setDecodeThreads(qMax(1, parser.value(threadsOption).toInt()));
+    if (parser.isSet(pendingOption))
+        processor.setMaxPending(qMax(1, parser.value(pendingOption).toInt()));
+    if (parser.isSet(tileOption)) {
+        const float maxDiameter = parser.isSet(maxDiameterOption)
+                ? parser.value(maxDiameterOption).toFloat() : Detector::TileOptions().maxDiameter;
+        processor.setTiling(qMax(1, parser.value(tileOption).toInt()),
+                            maxDiameter > 0 ? maxDiameter : Detector::TileOptions().maxDiameter);
+    }
+
+    Trace::setEnabled(parser.isSet(traceOption));
+    const int failed = processor.process(BatchProcessor::collectFiles(paths, parser.isSet(recursiveOption)));
+
+    // Поток глобального пула не должен заполнять кеш матриц при завершении процесса
+    prewarm.waitForFinished();
+
+    // Записать интервалы этапов (все задачи поиска завершены)
+    if (parser.isSet(traceOption)) {
+        Trace::setEnabled(false);
+        QFile traceFile(parser.value(traceOption));
+        if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+                traceFile.write(Trace::toChromeTrace()) < 0) {
+            qCritical("Cannot write trace file \"%s\"", qPrintable(parser.value(traceOption)));
+            return 2;
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#include "batchprocessor.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QQueue>
+#include <cstring>
+
+#include "imageutils.h"
+#include "scanlinereader.h"
+#include "trace.h"
+
+
+namespace {
+
+    // Объём полосы строк в режиме плиток. Полоса занимает всю ширину
+    // изображения, поэтому для широких изображений высота плиток
+    // уменьшается (см. BatchProcessor::searchTiled)
+    const qint64 Max_Band_Bytes = 256 * 1024 * 1024;
+
+    // Источник плиток файла изображения, строки которого читаются
+    // последовательно сверху вниз (см. ScanlineReader). В памяти хранится
+    // только полоса строк текущего ряда плиток (вместе с перекрытием)
+    // в оттенках серого, поэтому расход памяти не зависит от высоты
+    // изображения (но пропорционален ширине), а каждая строка файла
+    // декодируется один раз.
+    // Ряды плиток должны запрашиваться сверху вниз (как в Detector::detectTiled).
+    // Файлы форматов, которые нельзя читать по строкам, не загружаются
+    // (getSize возвращает пустой размер, причина - в getError).
+    class ImageFileTileSource : public Detector::TileSource {
+    public:
+        explicit ImageFileTileSource(const QString& path)
+            : bandTop(0), bandRows(0)
+        {
+            if (!reader.open(path))
+                error = reader.getError();
+        }
+
+        QSize getSize(void) const { return reader.getSize(); }
+
+        bool readTile(const QRect& rect, quint8* out, int stride)
+        {
+            if (!readBand(rect.top(), rect.bottom()))
+                return false;
+
+            const int width = reader.getSize().width();
+            for (int y = 0; y < rect.height(); ++y)
+                memcpy(out + (qint64) y * stride,
+                       band.constData() + (qint64) (rect.top() - bandTop + y) * width + rect.left(),
+                       rect.width());
+            return true;
+        }
+
+        // Получить описание последней ошибки
+        const QString& getError(void) const { return error; }
+
+    private:
+        // Сдвинуть полосу к строкам top..bottom: строки выше top
+        // отбрасываются, недостающие строки читаются из файла
+        bool readBand(int top, int bottom)
+        {
+            if (top < bandTop) {
+                error = QString("Tiles must be read from top to bottom");
+                return false;
+            }
+
+            const int width = reader.getSize().width();
+            const int dropped = qMin(top - bandTop, bandRows);
+            if (dropped > 0)
+                memmove(band.data(), band.constData() + (qint64) dropped * width,
+                        (qint64) (bandRows - dropped) * width);
+            bandTop += dropped;
+            bandRows -= dropped;
+
+            band.resize(qMax(bandRows, bottom - top + 1) * width);
+            Q_ASSERT (reader.getNextRow() == bandTop + bandRows);
+
+            // Строки файла между полосой и плиткой пропускаются
+            for (; bandTop < top; ++bandTop)
+                if (!reader.readRow(band.data()))
+                    break;
+
+            for (; bandTop == top && bandTop + bandRows <= bottom; ++bandRows)
+                if (!reader.readRow(band.data() + (qint64) bandRows * width))
+                    break;
+
+            if (bandTop + bandRows <= bottom) {
+                error = reader.getError();
+                return false;
+            }
+            return true;
+        }
+
+        ScanlineReader reader;  // Последовательное чтение строк файла
+        QVector<quint8> band;   // Строки bandTop.. в оттенках серого
+        int bandTop;            // Первая строка полосы
+        int bandRows;           // Кол-во строк полосы
+        QString error;          // Описание ошибки
+    };
+
+}   // namespace
+
+
+BatchProcessor::BatchProcessor(QTextStream* out)
+    : out(out), tracking(false)
+{
+    Q_ASSERT (out);
+
+    tileOptions.tileSize = 0;
+
+    // Загрузка в основном ограничена чтением файлов и декодированием,
+    // поэтому ей отводится часть потоков, остальные - поиску
+    setDecodeThreads(qMax(1, QThread::idealThreadCount() / 2));
+    setMaxPending(2 * decodePool.maxThreadCount());
+}
+
+
+BatchProcessor::~BatchProcessor()
+{
+    decodePool.waitForDone();
+}
+
+
+void BatchProcessor::setDecodeThreads(int count)
+{
+    Q_ASSERT (count > 0);
+    decodePool.setMaxThreadCount(count);
+}
+
+
+void BatchProcessor::setMaxPending(int count)
+{
+    Q_ASSERT (count > 0);
+    maxPending = count;
+}
+
+
+void BatchProcessor::setTiling(int tileSize, float maxDiameter)
+{
+    Q_ASSERT (tileSize >= 0);
+    Q_ASSERT (maxDiameter > 0);
+    tileOptions.tileSize = tileSize;
+    tileOptions.maxDiameter = maxDiameter;
+}
+
+
+int BatchProcessor::process(const QStringList& files)
+{
+    int failed = 0;     // Кол-во файлов, которые не удалось загрузить
+
+    // В режиме плиток файлы читаются внутри поиска
+    if (tileOptions.tileSize > 0) {
+        foreach (const QString& path, files)
+            if (!searchTiled(path))
+                ++failed;
+        out->flush();
+        return failed;
+    }
+
+    int next = 0;       // Индекс следующего загружаемого файла
+
+    // Загружаемые изображения в порядке списка
+    QQueue<QSharedPointer<DecodeTask> > pending;
+    while (next < files.size() || !pending.isEmpty()) {
+        // Запустить загрузку следующих файлов
+        while (next < files.size() && pending.size() < maxPending) {
+            QSharedPointer<DecodeTask> task(new DecodeTask(files.at(next++)));
+            decodePool.start(task.data());
+            pending.enqueue(task);
+        }
+
+        // Обработать самое раннее изображение (с ожиданием его загрузки)
+        QSharedPointer<DecodeTask> task(pending.dequeue());
+        task->done.acquire();
+        if (!search(task->image))
+            ++failed;
+    }
+
+    out->flush();
+    return failed;
+}
+
+
+QStringList BatchProcessor::collectFiles(const QStringList& paths, bool recursive)
+{
+    // Фильтр файлов поддерживаемых форматов
+    QStringList filters;
+    foreach (const QByteArray& format, QImageReader::supportedImageFormats())
+        filters.append(QString("*.%1").arg(QString::fromLatin1(format)));
+
+    QStringList files;
+    foreach (const QString& path, paths) {
+        if (!QFileInfo(path).isDir()) {
+            files.append(path);
+            continue;
+        }
+
+        QStringList dirFiles;
+        QDirIterator it(path, filters, QDir::Files,
+                        recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+        while (it.hasNext())
+            dirFiles.append(it.next());
+        dirFiles.sort();
+        files.append(dirFiles);
+    }
+    return files;
+}
+
+
+BatchProcessor::DecodedImage BatchProcessor::decode(const QString& path)
+{
+    DecodedImage decoded;
+    decoded.path = path;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // 1. Загрузить изображение
+    QImageReader reader(path);
+    QImage image;
+    {
+        Trace::Span span(Trace::Stage_Decode);
+        image = reader.read();
+    }
+    if (image.isNull()) {
+        decoded.error = reader.errorString();
+        return decoded;
+    }
+    decoded.decodeTime = timer.nsecsElapsed() / 1e6;
+
+    // 2. Преобразовать изображение в матрицу
+    timer.restart();
+    decoded.matrix = QSharedPointer<Matrix::Matrix2D<quint8> >(new Matrix::Matrix2D<quint8>);
+    ImageUtils::imageToMatrix(image, decoded.matrix.data());
+    decoded.convertTime = timer.nsecsElapsed() / 1e6;
+    return decoded;
+}
+
+
+bool BatchProcessor::search(const DecodedImage& image)
+{
+    QJsonObject result;
+    result.insert("file", image.path);
+
+    if (image.matrix.isNull()) {
+        result.insert("error", image.error);
+        *out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+        return false;
+    }
+
+    // 3. Найти шарик
+    const Matrix::Matrix2D<quint8>& matrix = *image.matrix;
+    QElapsedTimer timer;
+    timer.start();
+    const CircleSearch::Extremums found(tracking ? tracker.track(matrix)
+                                                 : circleSearch.run(matrix));
+    const double searchTime = timer.nsecsElapsed() / 1e6;
+
+    result.insert("width", matrix.getWidth());
+    result.insert("height", matrix.getHeight());
+    result.insert("found", found.diameter > 0);
+    if (found.diameter > 0) {
+        // Перевести относительные величины в пикселы
+        const int minSide = qMin(matrix.getWidth(), matrix.getHeight());
+        QJsonObject center;
+        center.insert("x", matrix.getWidth() * found.maxPoint.x());
+        center.insert("y", matrix.getHeight() * found.maxPoint.y());
+        result.insert("center", center);
+        result.insert("diameter", found.diameter * minSide);
+        result.insert("maxVal", found.maxVal);
+    }
+    if (tracking) {
+        result.insert("iterations", tracker.getIterations());
+        result.insert("tracked", tracker.isTracked());
+    }
+    else {
+        result.insert("iterations", circleSearch.getIterations());
+    }
+
+    QJsonObject timings;
+    timings.insert("decode", image.decodeTime);
+    timings.insert("convert", image.convertTime);
+    timings.insert("search", searchTime);
+    result.insert("timings", timings);
+
+    *out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+    out->flush();
+    return true;
+}
+
+
+bool BatchProcessor::searchTiled(const QString& path)
+{
+    QJsonObject result;
+    result.insert("file", path);
+
+    QElapsedTimer timer;
+    timer.start();
+    ImageFileTileSource source(path);
+    const QSize size(source.getSize());
+
+    // Высота плиток ограничивается так, чтобы полоса строк ряда плиток
+    // с перекрытием сверху и снизу не превышала Max_Band_Bytes
+    // (но не меньше двух перекрытий, см. Detector::getTileGrid)
+    Detector::TileOptions options(tileOptions);
+    if (!size.isEmpty()) {
+        const qint64 bandRows = Max_Band_Bytes / size.width()
+                                - 2 * Detector::getTileHalo(options.maxDiameter);
+        options.tileHeight = (int) qBound((qint64) 1, bandRows, (qint64) options.tileSize);
+    }
+
+    QVector<Detector::Result> candidates;
+    const Detector::Result found(size.isEmpty() ? Detector::Result()
+                                                : Detector::detectTiled(&source, options,
+                                                                        &candidates));
+    const double searchTime = timer.nsecsElapsed() / 1e6;
+
+    if (size.isEmpty() || !source.getError().isEmpty()) {
+        result.insert("error", source.getError());
+        *out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+        return false;
+    }
+
+    const QSize grid(Detector::getTileGrid(size, options));
+    result.insert("width", size.width());
+    result.insert("height", size.height());
+    result.insert("found", found.found);
+    if (found.found) {
+        QJsonObject center;
+        center.insert("x", found.center.x());
+        center.insert("y", found.center.y());
+        result.insert("center", center);
+        result.insert("diameter", found.diameter);
+        result.insert("maxVal", found.maxVal);
+    }
+    result.insert("iterations", found.iterations);
+    result.insert("tiles", grid.width() * grid.height());
+    result.insert("candidates", candidates.size());
+
+    QJsonObject timings;
+    timings.insert("search", searchTime);
+    result.insert("timings", timings);
+
+    *out << QJsonDocument(result).toJson(QJsonDocument::Compact) << '\n';
+    out->flush();
+    return true;
+}
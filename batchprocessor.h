@@ -0,0 +1,130 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSharedPointer>
+
+#include "matrix.h"
+#include "circlesearch.h"
+#include "circletracker.h"
+#include "detector.h"
+
+/*!
+ * \brief The BatchProcessor класс пакетного поиска шарика в списке изображений
+ * без графического интерфейса.
+ * Обработка выполняется конвейером: загрузка изображения и его преобразование
+ * в матрицу выполняются в отдельном ограниченном пуле потоков для нескольких
+ * следующих файлов одновременно, пока для текущего файла выполняется поиск
+ * (задачи поиска вычисляются в глобальном пуле потоков, см. CircleSearch).
+ * Поэтому чтение и декодирование файлов не простаивают в ожидании поиска,
+ * а поиск - в ожидании чтения. Кол-во загруженных, но ещё не обработанных
+ * изображений ограничено (setMaxPending), что ограничивает расход памяти.
+ *
+ * Результат каждого файла записывается в выходной поток в порядке списка
+ * одной строкой JSON (JSON Lines):
+ * {"file": "...", "width": 640, "height": 480, "found": true,
+ *  "center": {"x": 401.0, "y": 208.0}, "diameter": 120.5, "maxVal": 52012,
+ *  "iterations": 7, "timings": {"decode": 3.1, "convert": 0.4, "search": 25.7}}
+ * В режиме слежения (setTracking) файлы считаются последовательностью кадров
+ * и обрабатываются CircleTracker, а в результат добавляется поле "tracked".
+ * Координаты и диаметр задаются в пикселах исходного изображения,
+ * время - в миллисекундах. Для файлов, которые не удалось загрузить,
+ * записывается {"file": "...", "error": "..."}.
+ *
+ * В режиме плиток (setTiling) каждый файл обрабатывается Detector::detectTiled:
+ * строки изображения читаются из файла последовательно (см. ScanlineReader,
+ * поддерживаются PGM, PPM и BMP без сжатия, остальные форматы отклоняются
+ * с ошибкой), в памяти хранится только полоса строк текущего ряда плиток
+ * (не более 256 МБ: для широких изображений высота плиток уменьшается,
+ * но не меньше двух перекрытий, т.е. полоса - не меньше
+ * 4 * Detector::getTileHalo(maxDiameter) строк полной ширины),
+ * и в результат добавляются поля "tiles"
+ * (кол-во плиток) и "candidates" (кол-во шариков, найденных в плитках).
+ * Загрузка выполняется внутри поиска, поэтому в "timings" записывается
+ * только общее время "search". Файлы обрабатываются по очереди.
+ */
+class BatchProcessor
+{
+public:
+    explicit BatchProcessor(QTextStream* out);
+    ~BatchProcessor();
+
+    // Задать кол-во потоков загрузки изображений
+    void setDecodeThreads(int count);
+
+    // Задать максимальное кол-во загруженных, но не обработанных изображений
+    void setMaxPending(int count);
+
+    // Включить режим слежения за шариком в последовательности кадров
+    void setTracking(bool enabled) { tracking = enabled; }
+
+    // Включить режим плиток для очень больших изображений
+    // (tileSize = 0 - выключить, см. Detector::TileOptions)
+    void setTiling(int tileSize, float maxDiameter);
+
+    /*!
+     * \brief process - обработать список файлов изображений
+     * \param files - пути к файлам
+     * \return кол-во файлов, которые не удалось загрузить
+     */
+    int process(const QStringList& files);
+
+    /*!
+     * \brief collectFiles - получить список файлов изображений
+     * по путям к файлам и каталогам
+     * \param paths - пути к файлам (добавляются как есть) и каталогам
+     * (добавляются файлы поддерживаемых форматов, упорядоченные по имени)
+     * \param recursive - обходить вложенные каталоги
+     */
+    static QStringList collectFiles(const QStringList& paths, bool recursive);
+
+private:
+    BatchProcessor(const BatchProcessor&);
+    BatchProcessor& operator= (const BatchProcessor&);
+
+    // Загруженное изображение (результат первых этапов конвейера)
+    struct DecodedImage {
+        QString path;                       // Путь к файлу
+        QSharedPointer<Matrix::Matrix2D<quint8> > matrix;    // Матрица (пусто, если ошибка)
+        QString error;                      // Описание ошибки загрузки
+        double decodeTime;                  // Время загрузки, мс
+        double convertTime;                 // Время преобразования в матрицу, мс
+        DecodedImage() : decodeTime(0.0), convertTime(0.0) {}
+    };
+
+    // Задача загрузки одного изображения в пуле потоков загрузки
+    struct DecodeTask : public QRunnable {
+        QString path;           // Путь к файлу
+        DecodedImage image;     // Результат (доступен после захвата done)
+        QSemaphore done;        // Освобождается по завершении загрузки
+        explicit DecodeTask(const QString& p) : path(p) { setAutoDelete(false); }
+        void run() { image = decode(path); done.release(); }
+    };
+
+    // Загрузить изображение path и преобразовать его в матрицу
+    // (выполняется в пуле потоков загрузки)
+    static DecodedImage decode(const QString& path);
+
+    // Найти шарик в загруженном изображении и записать результат
+    // (возвращает false, если изображение не загружено)
+    bool search(const DecodedImage& image);
+
+    // Найти шарик в файле path по плиткам и записать результат
+    // (возвращает false, если изображение не удалось прочитать)
+    bool searchTiled(const QString& path);
+
+    QTextStream* out;           // Выходной поток результатов
+    QThreadPool decodePool;     // Пул потоков загрузки изображений
+    int maxPending;             // Макс. кол-во загруженных, но не обработанных изображений
+    bool tracking;              // Режим слежения
+    Detector::TileOptions tileOptions;  // Параметры режима плиток (tileSize = 0 - выключен)
+    CircleSearch circleSearch;  // Поиск шарика
+    CircleTracker tracker;      // Слежение за шариком (в режиме слежения)
+};
+
+#endif // BATCHPROCESSOR_H
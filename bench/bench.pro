@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Проверка соответствия оптимизированных вычислительных
+# процедур эталонным и замеры их производительности
+# (результаты выводятся в формате JSON Lines)
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+QT       -= widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = ImageWaveletBench
+TEMPLATE = app
+
+include(../corelib.pri)
+
+SOURCES += benchmain.cpp \
+    benchmark.cpp \
+    ../imageutils.cpp
+
+HEADERS += benchmark.h \
+    ../imageutils.h
@@ -0,0 +1,67 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTextStream>
+
+#include "benchmark.h"
+#include "tuning.h"
+
+
+// Проверка оптимизированных вычислительных процедур и замеры на синтетических кадрах.
+// Пример запуска:
+// ImageWaveletBench --check
+// ImageWaveletBench --sizes 256,1024 --repeats 5
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("ImageWaveletBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Check optimized kernels against the reference ones and "
+                                     "measure their throughput on synthetic frames (JSON Lines).");
+    parser.addHelpOption();
+
+    QCommandLineOption checkOption("check",
+                                   "Only check optimized kernels against the reference ones.");
+    QCommandLineOption sizesOption("sizes",
+                                   "Comma-separated frame sides (default 256,1024,4096,8192).", "sizes");
+    QCommandLineOption repeatsOption("repeats",
+                                     "Number of repeats of each measurement (the best one is printed).",
+                                     "count");
+    QCommandLineOption profileOption("profile",
+                                     "Load the performance profile from <file> instead of the "
+                                     "default one.", "file");
+    parser.addOption(checkOption);
+    parser.addOption(sizesOption);
+    parser.addOption(repeatsOption);
+    parser.addOption(profileOption);
+    parser.process(a);
+
+    // Замеры поиска выполняются с профилем производительности машины
+    // (файл по-умолчанию может отсутствовать - тогда профиль по-умолчанию)
+    const QString profilePath(parser.isSet(profileOption) ? parser.value(profileOption)
+                                                          : Tuning::getDefaultPath());
+    Tuning::Profile profile;
+    if (Tuning::load(profilePath, &profile)) {
+        Tuning::setProfile(profile);
+    }
+    else if (parser.isSet(profileOption)) {
+        qCritical("Cannot read profile file \"%s\"", qPrintable(profilePath));
+        return 2;
+    }
+
+    Benchmark::Options options;
+    options.checkOnly = parser.isSet(checkOption);
+    if (parser.isSet(sizesOption)) {
+        options.sizes.clear();
+        foreach (const QString& size, parser.value(sizesOption).split(',', QString::SkipEmptyParts))
+            options.sizes.append(size.toInt());
+    }
+    if (parser.isSet(repeatsOption))
+        options.repeats = qMax(1, parser.value(repeatsOption).toInt());
+
+    QFile outFile;
+    outFile.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    QTextStream out(&outFile);
+    return Benchmark::run(&out, options) > 0 ? 1 : 0;
+}
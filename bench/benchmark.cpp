@@ -0,0 +1,664 @@
+#include "benchmark.h"
+
+#include <QImage>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <cmath>
+
+#include "matrix.h"
+#include "matrixutils.h"
+#include "wavelet.h"
+#include "fhatengine.h"
+#include "fftengine.h"
+#include "circlesearch.h"
+#include "imageutils.h"
+#include "pixelsimd.h"
+#include "simd.h"
+#include "parallel.h"
+#include "performancetimer.h"
+
+namespace {
+
+    // Яркость фона и шарика синтетического кадра
+    const int Dark_Level = 20;
+    const int Bright_Level = 230;
+
+    // Масштаб значений вейвлета (как в CircleSearch)
+    const float Wavelet_Ratio = 1000.0;
+
+    // Наибольшая сторона матрицы в замере свёртки (свёртка в поиске
+    // вычисляется на уменьшенной матрице, см. CircleSearch::getOptimumSizes)
+    const int Max_Impose_Side = 256;
+
+    // Допустимое отличие Matrix::scaleMatrix от Matrix::scaleMatrixReference
+    const int Scale_Tolerance = 1;
+
+    // Ширина и наибольшее значение матрицы данных int при проверке
+    // 64-битных префиксных сумм FhatEngine: сумма строки не помещается
+    // в qint32, а результат свёртки (не более Max_Wide_Value * Wavelet_Ratio)
+    // помещается
+    const int Wide_Width = 4096;
+    const int Max_Wide_Value = 1 << 20;
+
+    // Наибольший модуль значений при проверке halveRows
+    const int Max_Halve_Value = 1 << 20;
+
+    // Начальное значение генератора случайных чисел
+    const quint32 Random_Seed = 12345;
+
+
+    // Генератор псевдослучайных чисел
+    // (одинаковая последовательность на всех платформах, в отличие от qrand)
+    class Random {
+    public:
+        explicit Random(quint32 seed) : state(seed * 2654435761u + 1) {}
+
+        quint32 next(void) {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        }
+
+        // Случайное число от 0 до n - 1
+        int uniform(int n) { return next() % n; }
+
+    private:
+        quint32 state;
+    };
+
+
+    // Параметры синтетического кадра
+    struct FrameParams {
+        QSize size;
+        QPointF center;     // Центр шарика в пикселах
+        float diameter;     // Диаметр шарика в пикселах
+        float blur;         // Ширина размытой границы в пикселах (0 - чёткая)
+        int noise;          // Амплитуда равномерного шума
+    };
+
+
+    // Построить кадр со светлым шариком на тёмном фоне
+    void makeFrame(Matrix::Matrix2D<quint8>* frame, const FrameParams& params)
+    {
+        frame->resize(params.size);
+        const float radius = params.diameter / 2;
+        Parallel::forRange(0, params.size.height(), 64, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                Random random(Random_Seed + y);
+                quint8* row = frame->getRow(y);
+                const float dy = y + 0.5 - params.center.y();
+                for (int x = 0; x < params.size.width(); ++x) {
+                    const float dx = x + 0.5 - params.center.x();
+                    const float d = sqrt(dx * dx + dy * dy);
+                    const float coverage = (params.blur > 0)
+                            ? qBound(0.0f, (radius - d) / params.blur + 0.5f, 1.0f)
+                            : (d <= radius ? 1.0f : 0.0f);
+                    int v = qRound(Dark_Level + (Bright_Level - Dark_Level) * coverage);
+                    if (params.noise > 0)
+                        v += random.uniform(2 * params.noise + 1) - params.noise;
+                    row[x] = (quint8) qBound(0, v, 255);
+                }
+            }
+        });
+    }
+
+
+    // Заполнить матрицу случайными значениями от 0 до maxValue
+    template <class T>
+    void fillRandom(Matrix::Matrix2D<T>* matrix, const QSize& size, int maxValue, Random* random)
+    {
+        matrix->resize(size);
+        for (int y = 0; y < size.height(); ++y) {
+            T* row = matrix->getRow(y);
+            for (int x = 0; x < size.width(); ++x)
+                row[x] = (T) random->uniform(maxValue + 1);
+        }
+    }
+
+
+    // Кол-во элементов матриц одного размера, отличающихся более чем на tolerance
+    template <class A, class B>
+    int countMismatches(const Matrix::MatrixView<const A>& a, const Matrix::MatrixView<const B>& b,
+                        int tolerance = 0)
+    {
+        Q_ASSERT (a.getSize() == b.getSize());
+        int count = 0;
+        for (int y = 0; y < a.getHeight(); ++y)
+            for (int x = 0; x < a.getWidth(); ++x)
+                if (qAbs((qint64) a.getRow(y)[x] - (qint64) b.getRow(y)[x]) > tolerance)
+                    ++count;
+        return count;
+    }
+
+
+    // Получить наименьшее время выполнения fun из repeats повторений в мс
+    template <class F>
+    double measure(int repeats, F fun)
+    {
+        double best = -1.0;
+        for (int r = 0; r < qMax(1, repeats); ++r) {
+            CTimer timer;
+            timer.Start();
+            fun();
+            const double ms = timer.Time() * 1e3;
+            best = (best < 0) ? ms : qMin(best, ms);
+        }
+        return best;
+    }
+
+
+    void print(QTextStream* out, const QJsonObject& object)
+    {
+        *out << QJsonDocument(object).toJson(QJsonDocument::Compact) << '\n';
+        out->flush();
+    }
+
+
+    // Вывести результат проверки на уровне SIMD level.
+    // Возвращает true, если найдены несовпадения.
+    bool printCheck(QTextStream* out, const char* name, Simd::Level level, int cases, int mismatches)
+    {
+        QJsonObject result;
+        result.insert("check", QString(name));
+        result.insert("simd", QString(Simd::getLevelName(level)));
+        result.insert("cases", cases);
+        result.insert("mismatches", mismatches);
+        print(out, result);
+        return mismatches > 0;
+    }
+
+
+    // Вывести результат замера для count элементов (пикселов)
+    void printBenchmark(QTextStream* out, const char* name, const QSize& size,
+                        double ms, qint64 count, QJsonObject result = QJsonObject())
+    {
+        result.insert("benchmark", QString(name));
+        result.insert("width", size.width());
+        result.insert("height", size.height());
+        result.insert("ms", ms);
+        result.insert("mpixPerSec", (ms > 0) ? count / (ms * 1e3) : 0.0);
+        print(out, result);
+    }
+
+
+    // Получить уровни SIMD, поддерживаемые процессором
+    QList<Simd::Level> getLevels(void)
+    {
+        QList<Simd::Level> levels;
+        for (int level = Simd::Level_Scalar; level <= Simd::getSupportedLevel(); ++level)
+            levels.append((Simd::Level) level);
+        return levels;
+    }
+
+
+    // Получить матрицу вейвлета FHAT, как в поиске
+    void getKernel(Matrix::Matrix2D<int>* kernel, unsigned int size)
+    {
+        Wavelet::getWavelet2dMatrix<int>(kernel, Wavelet::Fhat2d(), size, Wavelet_Ratio);
+    }
+
+
+    // ПРОВЕРКИ СООТВЕТСТВИЯ (возвращают кол-во уровней SIMD с несовпадениями)
+
+    // Преобразование изображения в матрицу: совпадение с qGray(QImage::pixel)
+    int checkImageToMatrix(QTextStream* out)
+    {
+        QList<QImage::Format> formats;
+        formats << QImage::Format_Indexed8 << QImage::Format_RGB32 << QImage::Format_ARGB32
+                << QImage::Format_ARGB32_Premultiplied << QImage::Format_RGB888;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+        formats << QImage::Format_Grayscale8;
+#endif
+
+        int failed = 0;
+        foreach (Simd::Level level, getLevels()) {
+            Simd::setLevel(level);
+            Random random(Random_Seed);
+            int mismatches = 0;
+            foreach (QImage::Format format, formats) {
+                QImage image(QSize(331, 97), format);
+                for (int y = 0; y < image.height(); ++y) {
+                    uchar* line = image.scanLine(y);
+                    for (int x = 0; x < image.bytesPerLine(); ++x)
+                        line[x] = (uchar) random.uniform(256);
+                }
+                if (format == QImage::Format_Indexed8) {
+                    QVector<QRgb> table;
+                    for (int i = 0; i < 200; ++i)
+                        table.append(random.next());
+                    image.setColorTable(table);
+                }
+
+                Matrix::Matrix2D<int> matrix;
+                Matrix::Matrix2D<quint8> matrix8;
+                ImageUtils::imageToMatrix(image, &matrix);
+                ImageUtils::imageToMatrix(image, &matrix8);
+                for (int y = 0; y < image.height(); ++y)
+                    for (int x = 0; x < image.width(); ++x) {
+                        const int gray = qGray(image.pixel(x, y));
+                        mismatches += (matrix.getRow(y)[x] != gray) + (matrix8.getRow(y)[x] != gray);
+                    }
+            }
+            if (printCheck(out, "imageToMatrix", level, formats.size(), mismatches))
+                ++failed;
+        }
+        return failed;
+    }
+
+
+    // Кол-во элементов halveRows пары строк rows (count элементов результата),
+    // не совпадающих со скалярным вычислением
+    template <class T>
+    int countHalveMismatches(const Matrix::Matrix2D<T>& rows, int count)
+    {
+        const T* row0 = rows.getRow(0);
+        const T* row1 = rows.getRow(1);
+        QVector<T> result(count);
+        ImageUtils::halveRows(result.data(), row0, row1, count);
+        int mismatches = 0;
+        for (int x = 0; x < count; ++x)
+            if (result[x] != (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) / 4)
+                ++mismatches;
+        return mismatches;
+    }
+
+
+    // Уменьшение пары строк (int и 8 бит): результат каждого уровня SIMD
+    // совпадает со скалярным вычислением (в том числе для отрицательных
+    // значений int и неполных векторов в конце строки)
+    int checkHalveRows(QTextStream* out)
+    {
+        const int cases = 16;
+        int failed = 0;
+        foreach (Simd::Level level, getLevels()) {
+            Simd::setLevel(level);
+            Random random(Random_Seed);
+            int mismatches = 0, mismatches8 = 0;
+            for (int c = 0; c < cases; ++c) {
+                const int count = 1 + random.uniform(100);
+                Matrix::Matrix2D<int> rows;
+                fillRandom(&rows, QSize(2 * count, 2), 2 * Max_Halve_Value, &random);
+                for (int y = 0; y < 2; ++y)
+                    for (int x = 0; x < 2 * count; ++x)
+                        rows.getRow(y)[x] -= Max_Halve_Value;
+                mismatches += countHalveMismatches(rows, count);
+
+                Matrix::Matrix2D<quint8> rows8;
+                fillRandom(&rows8, QSize(2 * count, 2), 255, &random);
+                mismatches8 += countHalveMismatches(rows8, count);
+            }
+            failed += printCheck(out, "halveRows", level, cases, mismatches) ? 1 : 0;
+            failed += printCheck(out, "halveRows<quint8>", level, cases, mismatches8) ? 1 : 0;
+        }
+        return failed;
+    }
+
+
+    // Масштабирование матрицы in в матрицу размером outSize: отличие
+    // от scaleMatrixReference не более Scale_Tolerance, результат уровня SIMD
+    // совпадает с результатом скалярного уровня (*scalar при первом вызове)
+    template <class T>
+    int checkScaleMatrix(const Matrix::Matrix2D<T>& in, const QSize& outSize, Matrix::Matrix2D<T>* scalar)
+    {
+        Matrix::Matrix2D<T> result(outSize);
+        Matrix::Matrix2D<T> reference(outSize);
+        Matrix::scaleMatrix(result.view(), in);
+        Matrix::scaleMatrixReference(reference.view(), in);
+        int mismatches = countMismatches<T, T>(result, reference, Scale_Tolerance);
+
+        if (Simd::getLevel() == Simd::Level_Scalar)
+            *scalar = result;
+        else
+            mismatches += countMismatches<T, T>(result, *scalar);
+        return mismatches;
+    }
+
+
+    // Масштабирование матрицы (8, 16 бит и int) для всех уровней SIMD.
+    // Половина случаев - масштаб, близкий к 1 (наибольшее кол-во
+    // дробных весов по краям элементов).
+    int checkScaleMatrix(QTextStream* out)
+    {
+        const int cases = 24;
+        QVector<Matrix::Matrix2D<int> > scalar(cases);
+        QVector<Matrix::Matrix2D<quint16> > scalar16(cases);
+        QVector<Matrix::Matrix2D<quint8> > scalar8(cases);
+
+        int failed = 0;
+        foreach (Simd::Level level, getLevels()) {
+            Simd::setLevel(level);
+            Random random(Random_Seed);
+            int mismatches = 0;
+            for (int c = 0; c < cases; ++c) {
+                const QSize inSize(16 + random.uniform(200), 16 + random.uniform(200));
+                QSize outSize(1 + random.uniform(inSize.width()), 1 + random.uniform(inSize.height()));
+                if (c % 2)
+                    outSize = QSize(inSize.width() - random.uniform(inSize.width() / 8),
+                                    inSize.height() - random.uniform(inSize.height() / 8));
+
+                Matrix::Matrix2D<int> in;
+                Matrix::Matrix2D<quint16> in16;
+                Matrix::Matrix2D<quint8> in8;
+                fillRandom(&in, inSize, 1 << 20, &random);
+                fillRandom(&in16, inSize, 65535, &random);
+                fillRandom(&in8, inSize, 255, &random);
+                mismatches += checkScaleMatrix(in, outSize, &scalar[c]);
+                mismatches += checkScaleMatrix(in16, outSize, &scalar16[c]);
+                mismatches += checkScaleMatrix(in8, outSize, &scalar8[c]);
+            }
+            if (printCheck(out, "scaleMatrix", level, cases, mismatches))
+                ++failed;
+        }
+        return failed;
+    }
+
+
+    // Матрица вейвлета: совпадение с прямым вычислением каждого элемента
+    // (без отражения четвертей)
+    int checkWaveletMatrix(QTextStream* out)
+    {
+        const int cases = 128;
+        int mismatches = 0;
+        for (unsigned int size = 0; size < (unsigned int) cases; ++size) {
+            Matrix::Matrix2D<int> kernel;
+            getKernel(&kernel, size);
+            const int mSize = size * 2 + 1;
+            const float center = (float) mSize / 2;
+            for (int j = 0; j < mSize; ++j)
+                for (int i = 0; i < mSize; ++i) {
+                    const float dx = center - i - 0.5;
+                    const float dy = center - j - 0.5;
+                    const float d = sqrt(dx * dx + dy * dy);
+                    const int value = (int) (Wavelet::getFhat2d(d / center) * Wavelet_Ratio);
+                    if (kernel.getRow(j)[i] != value)
+                        ++mismatches;
+                }
+        }
+        return printCheck(out, "getWavelet2dMatrix", Simd::getLevel(), cases, mismatches) ? 1 : 0;
+    }
+
+
+    // Получить прямым суммированием Wavelet::imposeReference свёртку
+    // области region матрицы данных in любого типа
+    template <class T>
+    void getReference(Matrix::Matrix2D<int>* reference, const Matrix::Matrix2D<T>& in,
+                      const Matrix::Matrix2D<int>& kernel, const QRect& region,
+                      Matrix::BorderMode borderMode = Matrix::Border_Constant)
+    {
+        Matrix::Matrix2D<int> in32(in.getSize());
+        for (int y = 0; y < in.getHeight(); ++y)
+            for (int x = 0; x < in.getWidth(); ++x)
+                in32.getRow(y)[x] = in.getRow(y)[x];
+        reference->resize(region.size());
+        Wavelet::imposeReference(reference->view(), in32, kernel, 255, region, borderMode);
+    }
+
+
+    // imposeWavelet для 16- или 8-битной матрицы данных in совпадает
+    // с прямым суммированием при всех способах продолжения за границы
+    template <class T>
+    int checkImposeWavelet(const Matrix::Matrix2D<T>& in, const Matrix::Matrix2D<int>& kernel, const QRect& region)
+    {
+        int mismatches = 0;
+        Matrix::Matrix2D<int> reference, result(region.size());
+        for (int mode = Matrix::Border_Constant; mode <= Matrix::Border_Mirror; ++mode) {
+            const Matrix::BorderMode borderMode = (Matrix::BorderMode) mode;
+            getReference(&reference, in, kernel, region, borderMode);
+            Wavelet::imposeWavelet(result.view(), in, kernel, 255, region, borderMode);
+            mismatches += countMismatches<int, int>(result, reference);
+        }
+        return mismatches;
+    }
+
+
+    // FhatEngine для матрицы данных in совпадает с прямым суммированием
+    template <class T>
+    int checkFhatEngine(const Matrix::Matrix2D<T>& in, const Matrix::Matrix2D<int>& kernel, const QRect& region)
+    {
+        Matrix::Matrix2D<int> reference, result(region.size());
+        getReference(&reference, in, kernel, region);
+        Wavelet::FhatEngine fhatEngine;
+        fhatEngine.setInput(in, 255);
+        fhatEngine.setWavelet(kernel);
+        fhatEngine.impose(result.view(), region);
+        return countMismatches<int, int>(result, reference);
+    }
+
+
+    // FftEngine для 8-битной матрицы данных in (как в поиске) совпадает
+    // с прямым суммированием
+    int checkFftEngine(const Matrix::Matrix2D<quint8>& in, const Matrix::Matrix2D<int>& kernel, const QRect& region)
+    {
+        Matrix::Matrix2D<int> reference, result(region.size());
+        getReference(&reference, in, kernel, region);
+        Wavelet::FftEngine fftEngine;
+        Matrix::ExtremumsAccumulator found;
+        fftEngine.impose(&found, in, kernel, 255, region, result.view());
+        return countMismatches<int, int>(result, reference);
+    }
+
+
+    // Свёртка: imposeWavelet (все способы продолжения за границы, также для
+    // матриц данных 8 и 16 бит), FhatEngine и FftEngine совпадают с прямым
+    // суммированием Wavelet::imposeReference.
+    // FhatEngine проверяется для матриц данных 8 и 16 бит (16-битные значения
+    // требуют 64-битного аккумулятора) и для больших значений int
+    // (64-битные префиксные суммы), FftEngine - также для 8 бит.
+    int checkImpose(QTextStream* out)
+    {
+        const int cases = 12;
+        int failed = 0;
+        foreach (Simd::Level level, getLevels()) {
+            Simd::setLevel(level);
+            Random random(Random_Seed);
+            int imposeMismatches = 0, fhatMismatches = 0, fftMismatches = 0;
+            int impose8Mismatches = 0, impose16Mismatches = 0;
+            int fhat8Mismatches = 0, fhat16Mismatches = 0, fhatWideMismatches = 0, fft8Mismatches = 0;
+            for (int c = 0; c < cases; ++c) {
+                const QSize inSize(24 + random.uniform(100), 24 + random.uniform(100));
+                Matrix::Matrix2D<int> in;
+                fillRandom(&in, inSize, 255, &random);
+                Matrix::Matrix2D<int> kernel;
+                getKernel(&kernel, 1 + random.uniform(15));
+
+                const QPoint topLeft(random.uniform(inSize.width() / 2), random.uniform(inSize.height() / 2));
+                const QRect region(topLeft, QSize(1 + random.uniform(inSize.width() - topLeft.x()),
+                                                  1 + random.uniform(inSize.height() - topLeft.y())));
+                Matrix::Matrix2D<int> reference(region.size()), result(region.size());
+
+                for (int mode = Matrix::Border_Constant; mode <= Matrix::Border_Mirror; ++mode) {
+                    const Matrix::BorderMode borderMode = (Matrix::BorderMode) mode;
+                    Wavelet::imposeReference(reference.view(), in, kernel, 255, region, borderMode);
+                    Wavelet::imposeWavelet(result.view(), in, kernel, 255, region, borderMode);
+                    imposeMismatches += countMismatches<int, int>(result, reference);
+                }
+
+                // Способы вычисления в поиске (за границами - значение 255)
+                Wavelet::imposeReference(reference.view(), in, kernel, 255, region);
+                Wavelet::FhatEngine fhatEngine;
+                fhatEngine.setInput(in, 255);
+                fhatEngine.setWavelet(kernel);
+                fhatEngine.impose(result.view(), region);
+                fhatMismatches += countMismatches<int, int>(result, reference);
+
+                Wavelet::FftEngine fftEngine;
+                fftEngine.impose(result.view(), in, kernel, 255, region);
+                fftMismatches += countMismatches<int, int>(result, reference);
+
+                Matrix::Matrix2D<quint8> in8;
+                Matrix::Matrix2D<quint16> in16;
+                fillRandom(&in8, inSize, 255, &random);
+                fillRandom(&in16, inSize, 65535, &random);
+                impose8Mismatches += checkImposeWavelet(in8, kernel, region);
+                impose16Mismatches += checkImposeWavelet(in16, kernel, region);
+                fhat8Mismatches += checkFhatEngine(in8, kernel, region);
+                fft8Mismatches += checkFftEngine(in8, kernel, region);
+                fhat16Mismatches += checkFhatEngine(in16, kernel, region);
+
+                // Область той же ширины у краёв и в середине широкой матрицы
+                Matrix::Matrix2D<int> inWide;
+                fillRandom(&inWide, QSize(Wide_Width, inSize.height()), Max_Wide_Value, &random);
+                const int wideLeft = (c % 3) * (Wide_Width - region.width()) / 2;
+                fhatWideMismatches += checkFhatEngine(inWide, kernel, QRect(QPoint(wideLeft, region.top()),
+                                                                            region.size()));
+            }
+            failed += printCheck(out, "imposeWavelet", level, cases, imposeMismatches) ? 1 : 0;
+            failed += printCheck(out, "imposeWavelet<quint8>", level, cases, impose8Mismatches) ? 1 : 0;
+            failed += printCheck(out, "imposeWavelet<quint16>", level, cases, impose16Mismatches) ? 1 : 0;
+            failed += printCheck(out, "FhatEngine", level, cases, fhatMismatches) ? 1 : 0;
+            failed += printCheck(out, "FhatEngine<quint8>", level, cases, fhat8Mismatches) ? 1 : 0;
+            failed += printCheck(out, "FhatEngine<quint16>", level, cases, fhat16Mismatches) ? 1 : 0;
+            failed += printCheck(out, "FhatEngine<qint64>", level, cases, fhatWideMismatches) ? 1 : 0;
+            failed += printCheck(out, "FftEngine", level, cases, fftMismatches) ? 1 : 0;
+            failed += printCheck(out, "FftEngine<quint8>", level, cases, fft8Mismatches) ? 1 : 0;
+        }
+        return failed;
+    }
+
+
+    // ЗАМЕРЫ
+
+    // Замеры вычислительных процедур для кадра стороной side
+    void benchmarkKernels(QTextStream* out, int side, int repeats)
+    {
+        const QSize size(side, side);
+        const qint64 pixels = (qint64) side * side;
+
+        FrameParams params;
+        params.size = size;
+        params.center = QPointF(side * 0.45, side * 0.55);
+        params.diameter = side * 0.25f;
+        params.blur = 0.0;
+        params.noise = 0;
+        Matrix::Matrix2D<quint8> frame;
+        makeFrame(&frame, params);
+
+        // Изображение RGB32 с оттенками серого кадра
+        QImage image(size, QImage::Format_RGB32);
+        for (int y = 0; y < side; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const quint8* row = frame.getRow(y);
+            for (int x = 0; x < side; ++x)
+                line[x] = qRgb(row[x], row[x], row[x]);
+        }
+
+        Matrix::Matrix2D<quint8> matrix8;
+        printBenchmark(out, "imageToMatrix<quint8>", size,
+                       measure(repeats, [&]() { ImageUtils::imageToMatrix(image, &matrix8); }), pixels);
+        Matrix::Matrix2D<int> matrix;
+        printBenchmark(out, "imageToMatrix<int>", size,
+                       measure(repeats, [&]() { ImageUtils::imageToMatrix(image, &matrix); }), pixels);
+        image = QImage();
+
+        Matrix::Matrix2D<int> half;
+        printBenchmark(out, "scaleMatrix", size,
+                       measure(repeats, [&]() { Matrix::scaleMatrix(&half, matrix, size / 2); }), pixels);
+        Matrix::Matrix2D<quint8> half8;
+        printBenchmark(out, "scaleMatrix<quint8>", size,
+                       measure(repeats, [&]() { Matrix::scaleMatrix(&half8, matrix8, size / 2); }), pixels);
+
+        // Свёртка на уменьшенной матрице с вейвлетом под диаметр шарика
+        const int scaledSide = qMin(side, Max_Impose_Side);
+        Matrix::Matrix2D<int> scaled;
+        Matrix::scaleMatrix(&scaled, matrix, QSize(scaledSide, scaledSide));
+        matrix.clear();
+        Matrix::Matrix2D<quint8> scaled8;
+        Matrix::scaleMatrix(&scaled8, matrix8, QSize(scaledSide, scaledSide));
+        const int wSize = params.diameter * scaledSide / side * sqrt(3.0);
+        Matrix::Matrix2D<int> kernel;
+        QJsonObject kernelInfo;
+        kernelInfo.insert("kernelSide", wSize | 1);
+        printBenchmark(out, "getWavelet2dMatrix", QSize(wSize | 1, wSize | 1),
+                       measure(repeats, [&]() { getKernel(&kernel, wSize >> 1); }),
+                       (qint64) (wSize | 1) * (wSize | 1));
+
+        Matrix::Matrix2D<int> response;
+        printBenchmark(out, "imposeWavelet", scaled.getSize(),
+                       measure(repeats, [&]() { Wavelet::imposeWavelet(&response, scaled, kernel, 255); }),
+                       (qint64) scaledSide * scaledSide, kernelInfo);
+        Wavelet::FhatEngine fhatEngine;
+        printBenchmark(out, "FhatEngine", scaled.getSize(),
+                       measure(repeats, [&]() {
+                           fhatEngine.setInput(scaled, 255);
+                           fhatEngine.setWavelet(kernel);
+                           fhatEngine.impose(&response);
+                       }),
+                       (qint64) scaledSide * scaledSide, kernelInfo);
+        printBenchmark(out, "FhatEngine<quint8>", scaled8.getSize(),
+                       measure(repeats, [&]() {
+                           fhatEngine.setInput(scaled8, 255);
+                           fhatEngine.setWavelet(kernel);
+                           fhatEngine.impose(&response);
+                       }),
+                       (qint64) scaledSide * scaledSide, kernelInfo);
+    }
+
+
+    // Замеры полного поиска для кадров стороной side
+    // с разными диаметрами, размытием и шумом
+    void benchmarkSearch(QTextStream* out, int side, int repeats)
+    {
+        const QSize size(side, side);
+        const float diameters[] = {0.1f, 0.3f};
+        const float blurs[] = {0.0f, 0.1f};     // Доля диаметра
+        const int noises[] = {0, 24};
+
+        CircleSearch search;
+        Matrix::Matrix2D<quint8> frame;
+        for (int d = 0; d < 2; ++d)
+            for (int b = 0; b < 2; ++b)
+                for (int n = 0; n < 2; ++n) {
+                    FrameParams params;
+                    params.size = size;
+                    params.center = QPointF(side * 0.45, side * 0.55);
+                    params.diameter = side * diameters[d];
+                    params.blur = params.diameter * blurs[b];
+                    params.noise = noises[n];
+                    makeFrame(&frame, params);
+
+                    CircleSearch::Extremums found;
+                    const double ms = measure(repeats, [&]() { found = search.run(frame); });
+
+                    QJsonObject result;
+                    result.insert("diameter", params.diameter);
+                    result.insert("blur", params.blur);
+                    result.insert("noise", params.noise);
+                    result.insert("found", found.diameter > 0);
+                    if (found.diameter > 0) {
+                        const QPointF center(found.maxPoint.x() * side, found.maxPoint.y() * side);
+                        const QPointF error(center - params.center);
+                        result.insert("centerError", sqrt(error.x() * error.x() + error.y() * error.y()));
+                        result.insert("diameterError", found.diameter * side - params.diameter);
+                    }
+                    printBenchmark(out, "search", size, ms, (qint64) side * side, result);
+                }
+    }
+
+}   // namespace
+
+
+// Выполнить проверки и замеры
+int Benchmark::run(QTextStream* out, const Options& options)
+{
+    Q_ASSERT (out);
+
+    int failed = 0;
+    failed += checkImageToMatrix(out);
+    failed += checkHalveRows(out);
+    failed += checkScaleMatrix(out);
+    failed += checkWaveletMatrix(out);
+    failed += checkImpose(out);
+    Simd::setLevel(Simd::getSupportedLevel());
+
+    if (options.checkOnly)
+        return failed;
+
+    // Матрицы вейвлета поиска строятся заранее, чтобы не учитывать их в замерах поиска
+    CircleSearch::prewarmKernels();
+    foreach (int side, options.sizes) {
+        if (side < 64)
+            continue;
+        benchmarkKernels(out, side, options.repeats);
+        benchmarkSearch(out, side, options.repeats);
+    }
+    return failed;
+}
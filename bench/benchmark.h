@@ -0,0 +1,41 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QList>
+#include <QTextStream>
+
+// Замер производительности и проверка соответствия вычислительных процедур
+// на синтетических кадрах (светлый шарик на тёмном фоне с размытой границей
+// и шумом). Результат каждого замера или проверки выводится одной строкой
+// JSON (JSON Lines):
+// {"check": "imposeWavelet", "simd": "AVX2", "cases": 12, "mismatches": 0}
+// {"benchmark": "scaleMatrix", "width": 4096, "height": 4096, "ms": 3.2,
+//  "mpixPerSec": 5242.9}
+// {"benchmark": "search", "width": 4096, "height": 4096, "diameter": 409.6,
+//  "blur": 0, "noise": 24, "ms": 85.1, "mpixPerSec": 197.2,
+//  "found": true, "centerError": 0.5, "diameterError": 3.1}
+//
+// Проверки сравнивают оптимизированные реализации с эталонными
+// (прямое суммирование без векторных инструкций) на всех уровнях SIMD,
+// поддерживаемых процессором, поэтому изменение оптимизированной
+// реализации можно принимать, если проверки не находят несовпадений.
+// Время замера - наименьшее из repeats повторений в миллисекундах.
+namespace Benchmark {
+
+    // Параметры замеров
+    struct Options {
+        QList<int> sizes;       // Стороны квадратных кадров в пикселах
+        int repeats;            // Кол-во повторений каждого замера
+        bool checkOnly;         // Только проверки соответствия (без замеров)
+        Options() : repeats(3), checkOnly(false) {
+            sizes << 256 << 1024 << 4096 << 8192;
+        }
+    };
+
+    // Выполнить проверки и замеры и вывести результаты в out.
+    // Возвращает кол-во проверок, нашедших несовпадения.
+    int run(QTextStream* out, const Options& options = Options());
+
+}   // namespace Benchmark
+
+#endif // BENCHMARK_H
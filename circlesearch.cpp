@@ -0,0 +1,471 @@
+#include "circlesearch.h"
+
+#include <QtConcurrent/QtConcurrent>
+#include <cmath>
+
+#include "matrixutils.h"
+#include "wavelet.h"
+#include "kernelcache.h"
+#include "trace.h"
+#include "tuning.h"
+
+namespace {
+
+    // масштабирующий коэффициент для более точного целочисленного вычисления
+    const float Wavelet_Ratio = 1000.0;
+
+}   // namespace
+
+
+CircleSearch::CircleSearch()
+    : stage(Stage_Idle), iterations(0), scratchPeakBytes(0), pyramidBytes(0)
+{
+}
+
+
+CircleSearch::~CircleSearch()
+{
+
+}
+
+
+void CircleSearch::prewarmKernels(void)
+{
+    Wavelet::KernelCache::prewarm<Wavelet::Fhat2d>(0, (getMaxWaveletSize() - 1) >> 1, Wavelet_Ratio);
+}
+
+
+void CircleSearch::start(const Matrix::MatrixView<const int>& image, const Window& window)
+{
+    // Построить пирамиду уменьшенных матриц для всего поиска
+    // (октавы очень большой матрицы пропускаются, см. Max_Search_Elements)
+    pyramid.build(image, Matrix::ImagePyramid::getSkipLevels(image.getSize(), Max_Search_Elements));
+    reset(pyramid.getSize(), window);
+}
+
+
+void CircleSearch::start(const Matrix::MatrixView<const quint8>& image, const Window& window)
+{
+    pyramid.build(image, Matrix::ImagePyramid::getSkipLevels(image.getSize(), Max_Search_Elements));
+    reset(pyramid.getSize(), window);
+}
+
+
+void CircleSearch::start(const Matrix::ImagePyramid::RowSource& source, const Window& window)
+{
+    pyramid.build(source, Matrix::ImagePyramid::getSkipLevels(source.getSize(), Max_Search_Elements));
+    reset(pyramid.getSize(), window);
+}
+
+
+void CircleSearch::reset(const QSize& size, const Window& window)
+{
+    // Размеры матрицы должны быть ненулевыми
+    Q_ASSERT (size.width() > 0);
+    Q_ASSERT (size.height() > 0);
+
+    imageSize = size;
+    area = window.area;
+    stage = Stage_Started;
+    iterations = 0;                         // Итерация поиска
+    extrems.clear();
+
+    // Диаметр шара измеряется в относительных единицах от минимальной стороны матрицы
+    // 1.0 - Диаметр шара равен минимальной стороне матрицы
+    // 0.5 - Диаметр шара равен половине минимальной стороны матрицы
+    // Т.е. не важно для какого размера матрица
+
+    // Начальные условия
+    const int minSide = qMin(imageSize.width(), imageSize.height());
+    float begin = qMax(getMinDiameter(imageSize), window.minDiameter);    // Начать с диаметра
+    float end = qMin(getMaxDiameter(), window.maxDiameter);               // Закончить диаметром
+    if (begin >= end) {
+        // Диапазон окна не пересекается с допустимым - искать во всём диапазоне
+        begin = getMinDiameter(imageSize);
+        end = getMaxDiameter();
+    }
+
+    optimizer.reset(DiameterOptimizer::create(Search_Optimizer,
+                                              Search_Diameter_Intervals,
+                                              Search_Iterations));
+    optimizer->reset(begin, end, (float) Search_Tolerance_Pixels / minSide);
+    bestExtrems = Extremums();
+}
+
+
+bool CircleSearch::advance(void)
+{
+    switch (stage) {
+    case Stage_Idle:
+        return false;
+
+    case Stage_Refine:
+        // Уточнение центра завершено
+        bestExtrems = extrems.first();
+        ++iterations;
+        finish();
+        return false;
+
+    case Stage_Diameter: {
+        // Передать отклики вычисленных диаметров оптимизатору
+        // (некорректные экстремумы не учитываются)
+        QVector<float> values;
+        for (int i = 0; i < extrems.size(); ++i)
+            values.append(extrems.at(i).diameter > 0 ? (float) extrems.at(i).maxVal
+                                                     : DiameterOptimizer::Invalid_Value);
+        optimizer->setValues(values);
+
+        // Запомнить лучший из всех вычисленных экстремумов
+        int maxIndex = findIndexMaximum(extrems);       // Найти индекс максимального
+        if (maxIndex >= 0 &&
+                (bestExtrems.diameter <= 0 || extrems.at(maxIndex).maxVal > bestExtrems.maxVal))
+            bestExtrems = extrems.at(maxIndex);
+        ++iterations;
+        break;
+    }
+
+    case Stage_Started:
+        stage = Stage_Diameter;
+        break;
+    }
+
+    // Диаметры следующего вычисления
+    QVector<float> diameters(optimizer->getNext());
+    extrems.clear();    // Очистить старый список экстремумов
+    if (!diameters.isEmpty()) {
+        for (int i = 0; i < diameters.size(); ++i)
+            extrems.append(Extremums(diameters.at(i)));
+        return true;
+    }
+
+    // Уточнить центр найденного экстремума на более высоком разрешении
+    if (Refine_Center && bestExtrems.diameter > 0) {
+        stage = Stage_Refine;
+        extrems.append(bestExtrems);
+        return true;
+    }
+
+    finish();
+    return false;
+}
+
+
+void CircleSearch::compute(void)
+{
+    Q_ASSERT (stage == Stage_Diameter || stage == Stage_Refine);
+
+    HandleWrapper wrap(this);
+    QtConcurrent::blockingMap(extrems, wrap);
+}
+
+
+QFuture<void> CircleSearch::computeAsync(void)
+{
+    Q_ASSERT (stage == Stage_Diameter || stage == Stage_Refine);
+
+    HandleWrapper wrap(this);
+    return QtConcurrent::map(extrems, wrap);
+}
+
+
+CircleSearch::Extremums CircleSearch::run(const Matrix::MatrixView<const int>& image,
+                                          const Window& window)
+{
+    Trace::Span span(Trace::Stage_Search);
+    start(image, window);
+    while (advance())
+        compute();
+    return bestExtrems;
+}
+
+
+CircleSearch::Extremums CircleSearch::run(const Matrix::MatrixView<const quint8>& image,
+                                          const Window& window)
+{
+    Trace::Span span(Trace::Stage_Search);
+    start(image, window);
+    while (advance())
+        compute();
+    return bestExtrems;
+}
+
+
+CircleSearch::Extremums CircleSearch::run(const Matrix::ImagePyramid::RowSource& source,
+                                          const Window& window)
+{
+    Trace::Span span(Trace::Stage_Search);
+    start(source, window);
+    while (advance())
+        compute();
+    return bestExtrems;
+}
+
+
+float CircleSearch::getProgress(void) const
+{
+    switch (stage) {
+    case Stage_Idle:
+        return 1.0;
+    case Stage_Started:
+        return 0.0;
+    default:
+        return optimizer->getProgress();
+    }
+}
+
+
+void CircleSearch::finish(void)
+{
+    // Поиск завершён
+    stage = Stage_Idle;
+    extrems.clear();
+    optimizer.reset();
+
+    // Освободить временные матрицы поиска
+    scratchPeakBytes = scratchPool.getPeakBytes();
+    pyramidBytes = pyramid.getBytes();
+    scratchPool.clear();
+    scratchPool.resetPeakBytes();
+    pyramid.clear();
+}
+
+
+// Вычилить экстремумы для указанной матрицы и указанного диаметра
+CircleSearch::Extremums CircleSearch::computeExtremums(const Matrix::ImagePyramid& pyramid, float diameter,
+                                                       const QRectF& area, Matrix::ScratchBuffers* scratch)
+{
+    Q_ASSERT (scratch);
+
+    // Размеры матрицы должны быть ненулевыми
+    Q_ASSERT (pyramid.getSize().width() > 0);
+    Q_ASSERT (pyramid.getSize().height() > 0);
+
+    // Найти оптимальный размер вейвлета и размер матрицы,
+    // исходя из исходного размера матрицы и заданного диаметра.
+    QPair<int, QSize> optSizes(getOptimumSizes(pyramid.getSize(), diameter));
+
+    // Если размер матрицы вейвлета равен нулю, то исключаем текущий диаметр из поиска
+    if (optSizes.first <= 0)
+        return Extremums();
+
+    // Получить матрицу вейвлета (из кеша матриц)
+    unsigned int waveletSize = (optSizes.first - 1) >> 1;     // Коэффициент размера вейвлета
+    Wavelet::KernelCache::KernelPointer kernel(
+                Wavelet::KernelCache::get<Wavelet::Fhat2d>(waveletSize, Wavelet_Ratio));
+    const Matrix::Matrix2D<int>& wMatrix = *kernel;
+
+    // Получить уменьшенную матрицу исходной (из пирамиды поиска)
+    const Matrix::ImagePyramid::Level scaled(pyramid.getScaled(optSizes.second));
+
+    // Область центров, для которых вычисляется свёртка
+    const QSize scaledSize(scaled.view.getSize());
+    const QRect bounds(QPoint(0, 0), scaledSize);
+    const QRect region(QRect(QPoint(floor(area.left() * scaledSize.width()),
+                                    floor(area.top() * scaledSize.height())),
+                             QPoint(ceil(area.right() * scaledSize.width()) - 1,
+                                    ceil(area.bottom() * scaledSize.height()) - 1)) & bounds);
+    if (region.isEmpty())
+        return Extremums();
+
+    // Входные данные - область, расширенная на радиус вейвлета.
+    // Элементы за её пределами лежат вне матрицы и заменяются значением 255,
+    // поэтому свёртка в области совпадает со свёрткой всей матрицы.
+    const int wRadius = wMatrix.getWidth() >> 1;
+    const QRect input(region.adjusted(-wRadius, -wRadius, wRadius, wRadius) & bounds);
+    const Matrix::MatrixView<const quint8> inView(scaled.view.region(input));
+    const QRect inRegion(region.translated(-input.topLeft()));
+
+    // Матрица результата свёртки сохраняется только в отладочном режиме,
+    // экстремумы находятся по строкам результата по мере их вычисления
+    Matrix::MatrixView<int> outView;
+    if (Keep_Response_Map) {
+        scratch->outMatrix.resize(region.size());
+        outView = scratch->outMatrix.view();
+    }
+
+    // Найти минимумы и максимумы
+    Matrix::ExtremumsAccumulator found(Wavelet_Ratio * 255, -Wavelet_Ratio * 255);
+
+    // Наложить вейвлет на входное изображение.
+    // Для небольших вейвлетов свёртка вычисляется по префиксным суммам строк
+    // (вейвлет FHAT состоит из участков с постоянным значением),
+    // для больших - через БПФ. Результат обоих способов совпадает
+    // с Wavelet::imposeWavelet. Матрица данных читается в 8 битах
+    // (вчетверо меньше обращений к памяти, чем для int).
+    bool useFft = false;
+    getConvolutionCost(wMatrix.getWidth(), input.size(), &useFft);
+    Trace::Span span(Trace::Stage_Impose);
+    if (useFft) {
+        scratch->fftEngine.impose(&found, inView, wMatrix, 255, inRegion, outView);
+    }
+    else {
+        Wavelet::FhatEngine& fhatEngine = scratch->fhatEngine;
+        fhatEngine.setInput(inView, 255);
+        fhatEngine.setWavelet(wMatrix);
+        fhatEngine.impose(&found, inRegion, outView);
+    }
+
+    // Перевести координаты экстремумов в относительные
+    const QPoint maxPoint(region.topLeft() + found.maxPoint);
+    const QPoint minPoint(region.topLeft() + found.minPoint);
+    Extremums extrems;
+    extrems.diameter = diameter;
+    extrems.maxVal = found.maxVal;
+    extrems.minVal = found.minVal;
+    extrems.maxPoint = QPointF((float) maxPoint.x() / scaledSize.width(),
+                               (float) maxPoint.y() / scaledSize.height());
+    extrems.minPoint = QPointF((float) minPoint.x() / scaledSize.width(),
+                               (float) minPoint.y() / scaledSize.height());
+    return extrems;
+}
+
+
+// Уточнить положение максимума экстремума coarse на более высоком разрешении
+CircleSearch::Extremums CircleSearch::refineExtremums(const Matrix::ImagePyramid& pyramid,
+                                                      const Extremums& coarse,
+                                                      Matrix::ScratchBuffers* scratch)
+{
+    Q_ASSERT (scratch);
+    Q_ASSERT (coarse.diameter > 0.0);
+    Q_ASSERT (Refine_Scale_Step > 1);
+    Q_ASSERT (Refine_Window_Radius > 0);
+
+    Trace::Span span(Trace::Stage_Refine);
+    const QSize fullSize(pyramid.getSize());
+    QSize size(getOptimumSizes(fullSize, coarse.diameter).second);
+
+    Extremums refined(coarse);
+    while (size.width() < fullSize.width() && size.height() < fullSize.height()) {
+        // Следующее разрешение (последнее - исходная матрица)
+        const int prevWidth = size.width();
+        size *= Refine_Scale_Step;
+        if (size.width() >= fullSize.width() || size.height() >= fullSize.height())
+            size = fullSize;
+        const float scale = (float) size.width() / prevWidth;
+
+        // Размер вейвлета для текущего разрешения (см. getOptimumSizes)
+        const int wSize = coarse.diameter * qMin(size.width(), size.height()) * sqrt(3.0);
+        if (wSize <= 0)
+            continue;
+        unsigned int waveletSize = (wSize - 1) >> 1;
+        Wavelet::KernelCache::KernelPointer kernel(
+                    Wavelet::KernelCache::get<Wavelet::Fhat2d>(waveletSize, Wavelet_Ratio));
+        const Matrix::Matrix2D<int>& wMatrix = *kernel;
+
+        // Окно поиска вокруг максимума, найденного на предыдущем разрешении.
+        // Максимум предыдущего разрешения смещён не более чем на элемент,
+        // которому соответствует scale элементов текущего.
+        const QRect bounds(QPoint(0, 0), size);
+        const int radius = (int) ceil(scale * Refine_Window_Radius);
+        const QPoint peak(size.width() * refined.maxPoint.x(),
+                          size.height() * refined.maxPoint.y());
+        const QRect window(QRect(peak - QPoint(radius, radius),
+                                 peak + QPoint(radius, radius)) & bounds);
+        if (window.isEmpty())
+            break;
+
+        // Входные данные - окно, расширенное на радиус вейвлета.
+        // Элементы за его пределами лежат вне матрицы и заменяются значением 255,
+        // поэтому свёртка в окне совпадает со свёрткой всей матрицы.
+        const int wRadius = wMatrix.getWidth() >> 1;
+        const QRect input(window.adjusted(-wRadius, -wRadius, wRadius, wRadius) & bounds);
+        const Matrix::ImagePyramid::Level scaled(pyramid.getScaled(size));
+
+        Matrix::ExtremumsAccumulator found(Wavelet_Ratio * 255, -Wavelet_Ratio * 255);
+        Wavelet::FhatEngine& fhatEngine = scratch->fhatEngine;
+        fhatEngine.setInput(scaled.view.region(input), 255);
+        fhatEngine.setWavelet(wMatrix);
+        fhatEngine.impose(&found, window.translated(-input.topLeft()));
+        if (!found.maxFound)
+            break;
+
+        const QPoint maxPoint(window.topLeft() + found.maxPoint);
+        refined.maxVal = found.maxVal;
+        refined.maxPoint = QPointF((float) maxPoint.x() / size.width(),
+                                   (float) maxPoint.y() / size.height());
+    }
+
+    return refined;
+}
+
+
+// Найти оптимальный размер вейвлета и размер матрицы.
+// Диаметр вычисляется по меньшей стороне.
+QPair<int, QSize> CircleSearch::getOptimumSizes(QSize matrixSize, float diameter)
+{
+    // Минимальный размер исходной матрицы, ниже которого нельзя
+    // его делать меньше
+    const int Min_Matrix_Size = 16;
+
+    Q_ASSERT (Min_Matrix_Size > 0);
+    Q_ASSERT (matrixSize.width() >= Min_Matrix_Size);
+    Q_ASSERT (matrixSize.height() >= Min_Matrix_Size);
+    Q_ASSERT (diameter > 0.0 && diameter <= getMaxDiameter());
+
+    const int performanceCriteria = Tuning::getProfile().performanceCriteria;
+    Q_ASSERT (performanceCriteria > 10);
+    const float Optimum_Value = pow(performanceCriteria, 4);
+
+    // Начинаем поиск от самого высокого разрешения (от исходного
+    // размера матрицы), а потом начинаем уменьшать его,
+    // чтобы достигнуть заданного оптимального значения
+
+    int mWidth = matrixSize.width();     // ширина матрицы
+    int mHeight = matrixSize.height();     // высота матрицы
+    float mRatio = (float) mWidth / mHeight;    // Коэффициент пропорциональности сторон
+    float wSize = 0;            // размер вейвлета
+    float diameterSize = 0.0;   // диаметр шарика
+    float sizesMult = 0.0;      // оценка трудоёмкости свёртки
+    while (mWidth > Min_Matrix_Size &&
+           mHeight > Min_Matrix_Size) {
+        // Определить размер шарика для текущего размера матрицы
+        diameterSize = diameter * qMin(mWidth, mHeight);
+        // Определить размер вейвлета (для выбранного вейвлета "Французская шляпа"
+        // размер вейвлета будет на sqrt(3) больше диаметра шара)
+        wSize = diameterSize * sqrt(3.0);
+
+        // Если размеры вейвлета и матрицы не оптимальны,
+        // то уменьшаем размер исходной матрицы
+        sizesMult = getConvolutionCost((int) wSize, QSize(mWidth, mHeight));
+        if ( (sizesMult <= Optimum_Value) ||
+             ( (mWidth - 1) < Min_Matrix_Size) ||
+             ( ((float) mWidth / mRatio) < Min_Matrix_Size))
+            break;
+        mWidth--;
+        mHeight = (float) mWidth / mRatio;
+    }
+
+    return QPair<int, QSize>((int) wSize, QSize(mWidth, mHeight));
+}
+
+
+// Получить максимальный размер вейвлета, который может выбрать getOptimumSizes
+int CircleSearch::getMaxWaveletSize(void)
+{
+    const float Optimum_Value = pow(Tuning::getProfile().performanceCriteria, 4);
+
+    // Размер вейвлета не больше меньшей стороны матрицы данных
+    int wSize = 1;
+    while (getConvolutionCost(wSize + 1, QSize(wSize + 1, wSize + 1)) <= Optimum_Value)
+        ++wSize;
+    return wSize;
+}
+
+
+// Оценить трудоёмкость свёртки матрицы размером matrixSize
+// с вейвлетом размером wSize и выбрать способ вычисления
+float CircleSearch::getConvolutionCost(int wSize, const QSize& matrixSize, bool* useFft)
+{
+    const float count = (float) matrixSize.width() * matrixSize.height();
+
+    // Свёртка по префиксным суммам: wSize строк вейвлета
+    // по Fhat_Taps_Per_Row обращений на каждый элемент
+    const float fhatCost = (float) wSize * Fhat_Taps_Per_Row * count;
+
+    // Свёртка через БПФ: не зависит от размера вейвлета
+    const float fftCost = Tuning::getProfile().fftOpsPerElementLog * log2(qMax(count, 2.0f)) * count;
+
+    if (useFft)
+        *useFft = (fftCost < fhatCost);
+    return qMin(fhatCost, fftCost);
+}
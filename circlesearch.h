@@ -0,0 +1,390 @@
+#ifndef CIRCLESEARCH_H
+#define CIRCLESEARCH_H
+
+#include <QVector>
+#include <QPair>
+#include <QPointF>
+#include <QRectF>
+#include <QFuture>
+#include <QScopedPointer>
+#include <cmath>
+
+#include "matrix.h"
+#include "scratchpool.h"
+#include "imagepyramid.h"
+#include "diameteroptimizer.h"
+#include "trace.h"
+
+/*!
+ * \brief The CircleSearch класс поиска в матрице изображения светлого шарика
+ * на тёмном фоне (не зависит от графического интерфейса).
+ * Шарик может иметь как чёткие, так и расплывчатые границы.
+ * Предельные размеры шарика:
+ * Минимальный диаметр шарика - 16 пикселей
+ * Максимальный диаметр шарика - 1 / sqrt(3) от минимальной стороны изображения
+ *
+ * Поиск производится вейвлет анализом с простейшим паттерном - "французская шляпа",
+ * модифицированным для двухмероного анализа изображения.
+ * Поиск выполняется по шагам: на каждом шаге вычисляется множество задач
+ * (экстремумы для нескольких диаметров или уточнение центра), после чего
+ * advance() подготавливает задачи следующего шага. Задачи шага вычисляются
+ * параллельно в глобальном пуле потоков синхронно (compute) или
+ * асинхронно (computeAsync), поэтому поиск может выполняться как в окне
+ * приложения, так и без графического интерфейса.
+ *
+ * Пример использования:
+ * CircleSearch search;
+ * search.start(imageMatrix);
+ * while (search.advance())
+ *     search.compute();
+ * CircleSearch::Extremums result(search.getResult());
+ *
+ * \note Один объект выполняет один поиск одновременно. Для параллельного
+ * поиска в нескольких изображениях используются разные объекты.
+ */
+class CircleSearch
+{
+public:
+    /*!
+     * \brief The Extremums struct - структура с информацией об экстремумах,
+     * если diameter = -1.0, значит экстремум не инициализирован
+     */
+    struct Extremums {
+        float diameter;         // Относительный диаметр (от 0 до 1.0)
+        QPointF maxPoint;       // Относительная точка максимума (от 0 до 1.0)
+        int maxVal;             // Значение максимума
+        QPointF minPoint;       // Относительная точка минимума (от 0 до 1.0)
+        int minVal;             // Значение минимума
+        Extremums() : diameter(-1.0)  {}
+        Extremums(float d) : diameter(d)  {}
+    };
+
+    /*!
+     * \brief The Window struct - ограничение поиска (например, при слежении
+     * за шариком в последовательности кадров): диапазон относительных
+     * диаметров и относительная область, в которой ищется центр шарика.
+     * Свёртка вычисляется только для элементов области, поэтому
+     * трудоёмкость поиска пропорциональна её площади.
+     * По-умолчанию поиск не ограничен.
+     */
+    struct Window {
+        float minDiameter;      // Минимальный относительный диаметр
+        float maxDiameter;      // Максимальный относительный диаметр
+        QRectF area;            // Относительная область центра (от 0 до 1.0)
+        Window() : minDiameter(0.0), maxDiameter(1.0), area(0.0, 0.0, 1.0, 1.0) {}
+    };
+
+    CircleSearch();
+    ~CircleSearch();
+
+    /*!
+     * \brief start - начать поиск в матрице image оттенков серого
+     * (матрица копируется в 8-битную пирамиду поиска со значениями,
+     * ограниченными пределами 0..255, и может быть изменена после вызова)
+     * \param window - ограничение поиска. Если диапазон диаметров окна
+     * не пересекается с допустимым, то поиск выполняется во всём диапазоне.
+     */
+    void start(const Matrix::MatrixView<const int>& image, const Window& window = Window());
+
+    /*!
+     * \brief start - начать поиск в 8-битной матрице оттенков серого image
+     * (например, в буфере кадра). Если image не больше Max_Search_Elements,
+     * она не копируется и становится исходным уровнем пирамиды поиска,
+     * поэтому её данные должны оставаться неизменными до завершения поиска
+     * (пока advance() не вернёт false). Иначе строки читаются
+     * в уменьшенную октаву без преобразования.
+     */
+    void start(const Matrix::MatrixView<const quint8>& image, const Window& window = Window());
+
+    /*!
+     * \brief start - начать поиск в матрице, строки которой читаются из source
+     * (например, в изображении без промежуточной матрицы исходного размера)
+     */
+    void start(const Matrix::ImagePyramid::RowSource& source, const Window& window = Window());
+
+    /*!
+     * \brief advance - обработать результаты вычисленного шага и подготовить
+     * задачи следующего шага. Первый вызов после start() подготавливает первый шаг.
+     * \return false, если поиск завершён (результат доступен в getResult())
+     */
+    bool advance(void);
+
+    /*!
+     * \brief compute - вычислить задачи текущего шага (с ожиданием завершения)
+     */
+    void compute(void);
+
+    /*!
+     * \brief computeAsync - запустить вычисление задач текущего шага
+     * \return future для ожидания завершения вычисления
+     */
+    QFuture<void> computeAsync(void);
+
+    /*!
+     * \brief run - выполнить весь поиск в матрице image синхронно (см. start)
+     * \return найденный экстремум (diameter = -1.0, если шарик не найден)
+     */
+    Extremums run(const Matrix::MatrixView<const int>& image, const Window& window = Window());
+    Extremums run(const Matrix::MatrixView<const quint8>& image, const Window& window = Window());
+    Extremums run(const Matrix::ImagePyramid::RowSource& source, const Window& window = Window());
+
+    // Активен ли поиск (start() вызван, а advance() ещё не вернул false)
+    bool isActive(void) const { return stage != Stage_Idle; }
+
+    // Получить долю выполненной работы (от 0 до 1.0)
+    float getProgress(void) const;
+
+    // Получить кол-во выполненных шагов поиска
+    int getIterations(void) const { return iterations; }
+
+    // Получить наибольший объём временных матриц и объём пирамиды
+    // последнего завершённого поиска в байтах
+    size_t getScratchPeakBytes(void) const { return scratchPeakBytes; }
+    size_t getPyramidBytes(void) const { return pyramidBytes; }
+
+    // Получить результат завершённого поиска
+    // (diameter = -1.0, если шарик не найден)
+    const Extremums& getResult(void) const { return bestExtrems; }
+
+    /*!
+     * \brief getMinDiameter - получить минимальный относительный диаметр шарика
+     * для заданного размера изображения (матрицы)
+     * \param size - размер изображения (или матрицы) для которой будет
+     * вычислен минмиальный относительный диаметр шарика
+     * \return значение минимального относительного диаметра шарика.
+     */
+    static float getMinDiameter(const QSize& size) {
+        // Минимальный диаметр шарика определяется относительно минимальной стороны изображения
+
+        const float Min_Diameter_Pixels = 16.0;     // Минимальный диаметр в пикселах
+
+        return Min_Diameter_Pixels / qMin(size.width(), size.height());
+    }
+
+
+    /*!
+     * \brief getMaxDiameter - получить максимальный относительный диаметр
+     * шарика (относительно минимальной стороны изображения)
+     * \return
+     */
+    static float getMaxDiameter(void) {
+        // Для вейвлета "Французская шляпа" оптимизированного по двумерные вычисления
+        static const float val = 1.0 / sqrt(3.0);
+        return val;
+    }
+
+
+    // Кол-во обращений к префиксным суммам на строку вейвлета FHAT
+    // (по одному на каждую границу участков: кольцо - круг - кольцо).
+    // Обращение к префиксной сумме - единица трудоёмкости свёртки
+    // (см. getConvolutionCost и Tuning::calibrate)
+    static const int Fhat_Taps_Per_Row = 4;
+
+    // Макс. кол-во элементов исходного уровня пирамиды поиска.
+    // Первые октавы матрицы большего размера пропускаются (предварительное
+    // прореживание при построении пирамиды), поэтому память и время поиска
+    // в очень больших изображениях ограничены, а точность центра
+    // ограничена разрешением исходного уровня (см. Tuning::calibrate).
+    static const int Max_Search_Elements = 16 * 1024 * 1024;
+
+
+    /*!
+     * \brief prewarmKernels - построить в кеше матриц вейвлета матрицы всех
+     * размеров, которые может выбрать getOptimumSizes при текущем профиле
+     * производительности (поэтому вызывается после загрузки профиля, см. Tuning::load)
+     */
+    static void prewarmKernels(void);
+
+private:
+    CircleSearch(const CircleSearch&);
+    CircleSearch& operator= (const CircleSearch&);
+
+    // Способ поиска диаметра (см. DiameterOptimizer)
+    static const DiameterOptimizer::Type Search_Optimizer = DiameterOptimizer::Type_Brent;
+
+    // Точность определения диаметра в пикселах
+    static const int Search_Tolerance_Pixels = 1;
+
+    // Кол-во интервалов для поиска диаметра на каждом шаге итерации
+    // (для начальной сетки DiameterOptimizer::Type_Brent и Type_GoldenSection)
+    static const int Search_Diameter_Intervals = 5;
+
+    // Кол-во итераций поиска (только для DiameterOptimizer::Type_Grid)
+    static const int Search_Iterations = 5;
+
+    // Критерий оптимальной производительности и трудоёмкость свёртки
+    // через БПФ индивидуальны для каждой вычислительной машины
+    // и задаются профилем Tuning::getProfile()
+
+    // Сохранять матрицу результата свёртки в наборе временных матриц
+    // (для отладки). Иначе экстремумы находятся по строкам результата
+    // по мере их вычисления, и матрица результата не выделяется.
+    static const bool Keep_Response_Map = false;
+
+    // Уточнять центр найденного экстремума на более высоком разрешении
+    // (вплоть до исходного уровня пирамиды) в окне вокруг максимума, найденного при поиске
+    static const bool Refine_Center = true;
+
+    // Во сколько раз увеличивается разрешение на каждом шаге уточнения
+    static const int Refine_Scale_Step = 2;
+
+    // Радиус окна уточнения в элементах предыдущего разрешения
+    static const int Refine_Window_Radius = 2;
+
+    // Этап поиска
+    enum Stage {
+        Stage_Idle,         // Поиск не активен
+        Stage_Started,      // Поиск начат, задачи ещё не подготовлены
+        Stage_Diameter,     // Вычисление экстремумов для диаметров оптимизатора
+        Stage_Refine        // Уточнение центра найденного экстремума
+    };
+
+
+    /*!
+     * \brief The HandleWrapper структура для запуска асинхронного вычисления
+     * задач шага
+     */
+    struct HandleWrapper {
+        CircleSearch *instance;
+        HandleWrapper(CircleSearch *s): instance(s) {}
+        void operator()(CircleSearch::Extremums& ex) {
+            instance->handleExtremums(ex);
+        }
+    };
+
+
+    /*!
+     * \brief reset - сбросить состояние и подготовить оптимизатор диаметра
+     * для поиска в матрице размером size
+     */
+    void reset(const QSize& size, const Window& window);
+
+
+    /*!
+     * \brief finish - завершить поиск: освободить временные матрицы
+     */
+    void finish(void);
+
+
+    /*!
+     * \brief computeExtremums - вычилисть экстремумы для матрицы и диаметра diameter
+     * \param pyramid - пирамида уменьшенных копий матрицы значений, для которой
+     * выполняется поиск. Точки экстремумов задаются относительно матрицы.
+     * \param diameter - диаметр структуры, для которой будут вычисляться экстремы
+     * \param area - относительная область, в которой ищутся экстремумы
+     * \param scratch - набор временных матриц для промежуточных результатов
+     * \return экстремумы. Если возвращает экстремум с diameter = -1.0, то данный
+     * экстремум не был определён.
+     */
+    static Extremums computeExtremums(const Matrix::ImagePyramid& pyramid, float diameter,
+                                      const QRectF& area, Matrix::ScratchBuffers* scratch);
+
+
+    /*!
+     * \brief getOptimumSizes - получить оптимальный размер вейвлета и размер матрицы данных
+     * \param matrixSize - размер матрицы данных
+     * \param diameter - диаметр шарика, для которого требуется найти оптимальные
+     * размеры матрицы данных и матрицы вейвлета
+     * \return пара значений - размер матрицы вейвлета и размер матрицы данных.
+     */
+    static QPair<int, QSize> getOptimumSizes(QSize matrixSize, float diameter);
+
+
+    /*!
+     * \brief refineExtremums - уточнить положение максимума экстремума.
+     * Начиная с разрешения, выбранного getOptimumSizes, разрешение увеличивается
+     * в Refine_Scale_Step раз до исходного, и на каждом шаге свёртка вычисляется
+     * только в окне радиусом Refine_Window_Radius элементов предыдущего
+     * разрешения вокруг найденного на нём максимума. Трудоёмкость шага
+     * пропорциональна площади окна, а не всей матрицы.
+     * \param pyramid - пирамида уменьшенных копий матрицы значений
+     * \param coarse - экстремум, найденный при поиске (diameter > 0)
+     * \param scratch - набор временных матриц для промежуточных результатов
+     * \return экстремум с уточнёнными maxPoint и maxVal
+     * (минимум не уточняется)
+     */
+    static Extremums refineExtremums(const Matrix::ImagePyramid& pyramid, const Extremums& coarse,
+                                     Matrix::ScratchBuffers* scratch);
+
+
+    /*!
+     * \brief getMaxWaveletSize - получить максимальный размер вейвлета,
+     * который может выбрать getOptimumSizes (размер вейвлета не больше
+     * меньшей стороны матрицы данных, а трудоёмкость свёртки - не больше
+     * Tuning::Profile::performanceCriteria ^ 4)
+     * \return размер стороны матрицы вейвлета
+     */
+    static int getMaxWaveletSize(void);
+
+
+    /*!
+     * \brief getConvolutionCost - оценить трудоёмкость свёртки и выбрать способ её вычисления
+     * \param wSize - размер стороны матрицы вейвлета
+     * \param matrixSize - размер матрицы данных
+     * \param useFft - если задан, то в него записывается true, если свёртку
+     * выгоднее вычислять через БПФ, и false - если по префиксным суммам
+     * \return оценка кол-ва операций для выбранного способа
+     */
+    static float getConvolutionCost(int wSize, const QSize& matrixSize, bool* useFft = NULL);
+
+
+    /*!
+     * \brief findIndexMaximum - Найти среди списка экстремумов максимальный, и вернуть его индекс.
+     * \param vect - Список экстремумов.
+     * \return индекс, если экстремум найден, -1 - если не найден.
+     */
+    static int findIndexMaximum(const QVector<Extremums>& vect) {
+        // Найти максимумальный экстремум
+        int maxIndex = -1;
+        int maxValue = 0;
+        for (int i = 0; i < vect.size(); ++i)
+            if (vect.at(i).maxVal > maxValue) {
+                maxValue = vect.at(i).maxVal;
+                maxIndex = i;
+            }
+        return maxIndex;
+    }
+
+
+    /*!
+     * \brief handleExtremums - процедура вычисления задачи текущего шага.
+     * Данная процедура используется для асинхронного вычисления.
+     * \param ex - экстремум, из которого берётся значение диаметра для поиска
+     * (или найденный экстремум для уточнения центра)
+     * и в него кладутся вычисленные данные.
+     */
+    void handleExtremums(CircleSearch::Extremums& ex) {
+        // Интервалы задачи помечаются диаметром в пикселах и номером шага
+        const QSize size(pyramid.getSize());
+        Trace::Context context(qRound(ex.diameter * qMin(size.width(), size.height())), iterations);
+        Matrix::ScratchLocker scratch(&scratchPool);
+        if (stage == Stage_Refine)
+            ex = refineExtremums(pyramid, ex, scratch.get());
+        else
+            ex = computeExtremums(pyramid, ex.diameter, area, scratch.get());
+    }
+
+    Stage stage;                // Текущий этап поиска
+    int iterations;             // Счётчик шагов поиска
+    QSize imageSize;            // Размер исходного уровня пирамиды поиска
+    QRectF area;                // Относительная область поиска центра
+
+    // Пул временных матриц текущего поиска (освобождается по окончании поиска)
+    Matrix::ScratchPool scratchPool;
+
+    // Уменьшенные копии матрицы изображения текущего поиска (освобождаются по окончании поиска)
+    Matrix::ImagePyramid pyramid;
+    size_t scratchPeakBytes;    // Объёмы памяти последнего завершённого поиска
+    size_t pyramidBytes;
+
+    // Список экстремумов (задач текущего шага), которые асинхронно обрабатываются
+    QVector<CircleSearch::Extremums> extrems;
+
+    // Оптимизатор диаметра текущего поиска
+    QScopedPointer<DiameterOptimizer> optimizer;
+
+    // Экстремум с максимальным откликом среди всех вычисленных в текущем поиске
+    CircleSearch::Extremums bestExtrems;
+};
+
+#endif // CIRCLESEARCH_H
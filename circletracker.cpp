@@ -0,0 +1,75 @@
+#include "circletracker.h"
+
+
+CircleTracker::CircleTracker()
+    : referenceVal(0), tracked(false)
+{
+}
+
+
+void CircleTracker::reset(void)
+{
+    previous = CircleSearch::Extremums();
+    previousSize = QSize();
+    referenceVal = 0;
+    tracked = false;
+}
+
+
+CircleSearch::Extremums CircleTracker::track(const Matrix::MatrixView<const int>& frame)
+{
+    return trackFrame(frame);
+}
+
+
+CircleSearch::Extremums CircleTracker::track(const Matrix::MatrixView<const quint8>& frame)
+{
+    return trackFrame(frame);
+}
+
+
+template <class T>
+CircleSearch::Extremums CircleTracker::trackFrame(const Matrix::MatrixView<const T>& frame)
+{
+    Q_ASSERT (!frame.isNull());
+
+    // Ограниченный поиск вокруг шарика предыдущего кадра
+    // (если шарик был найден в кадре того же размера)
+    if (previous.diameter > 0 && frame.getSize() == previousSize) {
+        CircleSearch::Extremums found(search.run(frame, getWindow(previous, frame.getSize())));
+        if (found.diameter > 0 &&
+                (qint64) found.maxVal * 100 >= (qint64) referenceVal * Track_Min_Response_Percent) {
+            previous = found;
+            tracked = true;
+            return found;
+        }
+    }
+
+    // Полный поиск
+    CircleSearch::Extremums found(search.run(frame));
+    previous = found;
+    previousSize = frame.getSize();
+    referenceVal = (found.diameter > 0) ? found.maxVal : 0;
+    tracked = false;
+    return found;
+}
+
+
+CircleSearch::Window CircleTracker::getWindow(const CircleSearch::Extremums& previous,
+                                              const QSize& size)
+{
+    Q_ASSERT (previous.diameter > 0);
+
+    CircleSearch::Window window;
+    window.minDiameter = previous.diameter * (100 - Track_Diameter_Percent) / 100;
+    window.maxDiameter = previous.diameter * (100 + Track_Diameter_Percent) / 100;
+
+    // Радиус области центра в пикселах
+    const float radius = previous.diameter * qMin(size.width(), size.height()) *
+            Track_Position_Percent / 100;
+    const float rx = radius / size.width();
+    const float ry = radius / size.height();
+    window.area = QRectF(previous.maxPoint.x() - rx, previous.maxPoint.y() - ry,
+                         2 * rx, 2 * ry);
+    return window;
+}
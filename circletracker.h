@@ -0,0 +1,75 @@
+#ifndef CIRCLETRACKER_H
+#define CIRCLETRACKER_H
+
+#include "matrix.h"
+#include "circlesearch.h"
+
+/*!
+ * \brief The CircleTracker класс слежения за шариком в последовательности кадров
+ * (например, с камеры), в которой шарик смещается между кадрами незначительно.
+ * Первый кадр обрабатывается полным поиском. Для следующих кадров поиск
+ * ограничивается (см. CircleSearch::Window) диапазоном диаметров
+ * вокруг предыдущего диаметра и областью вокруг предыдущего центра,
+ * поэтому обработка кадра сводится к нескольким свёрткам в небольшой области.
+ * Если отклик найденного экстремума (maxVal) падает ниже доли
+ * Track_Min_Response_Percent от отклика последнего полного поиска,
+ * то шарик считается потерянным, и кадр обрабатывается полным поиском.
+ *
+ * Пример использования:
+ * CircleTracker tracker;
+ * foreach (кадр)
+ *     CircleSearch::Extremums found(tracker.track(frameMatrix));
+ */
+class CircleTracker
+{
+public:
+    CircleTracker();
+
+    /*!
+     * \brief track - найти шарик в очередном кадре
+     * \param frame - матрица кадра (размер кадров может меняться)
+     * \return найденный экстремум (diameter = -1.0, если шарик не найден)
+     */
+    CircleSearch::Extremums track(const Matrix::MatrixView<const int>& frame);
+    CircleSearch::Extremums track(const Matrix::MatrixView<const quint8>& frame);
+
+    // Сбросить слежение (следующий кадр обрабатывается полным поиском)
+    void reset(void);
+
+    // Найден ли шарик в последнем кадре ограниченным поиском (без полного поиска)
+    bool isTracked(void) const { return tracked; }
+
+    // Получить кол-во шагов поиска последнего кадра
+    int getIterations(void) const { return search.getIterations(); }
+
+private:
+    CircleTracker(const CircleTracker&);
+    CircleTracker& operator= (const CircleTracker&);
+
+    // Полуширина диапазона диаметров в процентах от предыдущего диаметра
+    static const int Track_Diameter_Percent = 20;
+
+    // Радиус области поиска центра в процентах от предыдущего диаметра
+    static const int Track_Position_Percent = 50;
+
+    // Минимальный отклик ограниченного поиска в процентах от отклика
+    // последнего полного поиска (ниже - шарик считается потерянным)
+    static const int Track_Min_Response_Percent = 70;
+
+    // Найти шарик в кадре матрицы любого типа
+    template <class T>
+    CircleSearch::Extremums trackFrame(const Matrix::MatrixView<const T>& frame);
+
+    // Получить ограничение поиска вокруг экстремума previous
+    // для кадра размером size
+    static CircleSearch::Window getWindow(const CircleSearch::Extremums& previous,
+                                          const QSize& size);
+
+    CircleSearch search;                // Поиск шарика
+    CircleSearch::Extremums previous;   // Экстремум предыдущего кадра
+    QSize previousSize;                 // Размер предыдущего кадра
+    int referenceVal;                   // Отклик последнего полного поиска
+    bool tracked;                       // Найден ли шарик ограниченным поиском
+};
+
+#endif // CIRCLETRACKER_H
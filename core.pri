@@ -0,0 +1,44 @@
+# Поиск шарика в матрице изображения (без графического интерфейса).
+# Исходные файлы статической библиотеки ImageWaveletCore (core/core.pro).
+
+SOURCES += \
+    $$PWD/detector.cpp \
+    $$PWD/circlesearch.cpp \
+    $$PWD/circletracker.cpp \
+    $$PWD/wavelet.cpp \
+    $$PWD/matrixutils.cpp \
+    $$PWD/scratchpool.cpp \
+    $$PWD/fhatengine.cpp \
+    $$PWD/fftengine.cpp \
+    $$PWD/separablekernel.cpp \
+    $$PWD/simd.cpp \
+    $$PWD/waveletsimd.cpp \
+    $$PWD/pixelsimd.cpp \
+    $$PWD/parallel.cpp \
+    $$PWD/imagepyramid.cpp \
+    $$PWD/kernelcache.cpp \
+    $$PWD/diameteroptimizer.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/tuning.cpp
+
+HEADERS += \
+    $$PWD/detector.h \
+    $$PWD/circlesearch.h \
+    $$PWD/circletracker.h \
+    $$PWD/wavelet.h \
+    $$PWD/matrix.h \
+    $$PWD/matrixutils.h \
+    $$PWD/scratchpool.h \
+    $$PWD/fhatengine.h \
+    $$PWD/fftengine.h \
+    $$PWD/separablekernel.h \
+    $$PWD/simd.h \
+    $$PWD/waveletsimd.h \
+    $$PWD/pixelsimd.h \
+    $$PWD/parallel.h \
+    $$PWD/imagepyramid.h \
+    $$PWD/kernelcache.h \
+    $$PWD/diameteroptimizer.h \
+    $$PWD/trace.h \
+    $$PWD/tuning.h \
+    $$PWD/performancetimer.h
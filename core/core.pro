@@ -0,0 +1,15 @@
+#-------------------------------------------------
+#
+# Статическая библиотека поиска шарика
+# (без зависимостей от QtGui и QtWidgets)
+#
+#-------------------------------------------------
+
+QT       = core concurrent
+
+CONFIG += c++11 staticlib
+
+TARGET = ImageWaveletCore
+TEMPLATE = lib
+
+include(../core.pri)
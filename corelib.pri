@@ -0,0 +1,14 @@
+# Подключение статической библиотеки поиска ImageWaveletCore (core/core.pro)
+# к проектам приложений
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+CORE_LIB_DIR = $$OUT_PWD/../core
+win32:CONFIG(release, debug|release): CORE_LIB_DIR = $$CORE_LIB_DIR/release
+else:win32:CONFIG(debug, debug|release): CORE_LIB_DIR = $$CORE_LIB_DIR/debug
+
+LIBS += -L$$CORE_LIB_DIR -lImageWaveletCore
+
+win32-msvc*: PRE_TARGETDEPS += $$CORE_LIB_DIR/ImageWaveletCore.lib
+else: PRE_TARGETDEPS += $$CORE_LIB_DIR/libImageWaveletCore.a
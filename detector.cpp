@@ -0,0 +1,187 @@
+#include "detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "matrix.h"
+#include "circlesearch.h"
+
+namespace {
+
+    // Перевести ограничения поиска в пикселах в относительные единицы
+    // матрицы размером size
+    CircleSearch::Window getWindow(const QSize& size, float minDiameter, float maxDiameter,
+                                   const QRect& area)
+    {
+        const int minSide = qMin(size.width(), size.height());
+        CircleSearch::Window window;
+        if (minDiameter > 0)
+            window.minDiameter = minDiameter / minSide;
+        if (maxDiameter > 0)
+            window.maxDiameter = maxDiameter / minSide;
+        if (!area.isEmpty())
+            window.area = QRectF((float) area.left() / size.width(),
+                                 (float) area.top() / size.height(),
+                                 (float) area.width() / size.width(),
+                                 (float) area.height() / size.height());
+        return window;
+    }
+
+
+    // Найти шарик в матрице image и перевести результат в пикселы
+    // (origin - положение матрицы в изображении)
+    Detector::Result searchImage(CircleSearch* search, const Matrix::MatrixView<const quint8>& image,
+                            const CircleSearch::Window& window, const QPoint& origin = QPoint())
+    {
+        const CircleSearch::Extremums found(search->run(image, window));
+
+        Detector::Result result;
+        result.iterations = search->getIterations();
+        if (found.diameter > 0) {
+            result.found = true;
+            result.center = QPointF(origin.x() + image.getWidth() * found.maxPoint.x(),
+                                    origin.y() + image.getHeight() * found.maxPoint.y());
+            result.diameter = found.diameter * qMin(image.getWidth(), image.getHeight());
+            result.maxVal = found.maxVal;
+        }
+        return result;
+    }
+
+
+    // Сравнение результатов по убыванию отклика
+    bool greaterResponse(const Detector::Result& a, const Detector::Result& b) {
+        return a.maxVal > b.maxVal;
+    }
+
+
+    // Источник плиток 8-битного буфера изображения
+    class BufferTileSource : public Detector::TileSource {
+    public:
+        BufferTileSource(const quint8* pixels, int width, int height, int stride)
+            : pixels(pixels), size(width, height), stride(stride) {}
+
+        QSize getSize(void) const { return size; }
+
+        bool readTile(const QRect& rect, quint8* out, int outStride) {
+            for (int y = 0; y < rect.height(); ++y)
+                memcpy(out + (qint64) y * outStride,
+                       pixels + (qint64) (rect.top() + y) * stride + rect.left(), rect.width());
+            return true;
+        }
+
+    private:
+        const quint8* pixels;
+        QSize size;
+        int stride;
+    };
+
+}   // namespace
+
+
+Detector::Result Detector::detect(const quint8* pixels, int width, int height, int stride,
+                                  const Options& options)
+{
+    Q_ASSERT (pixels);
+    Q_ASSERT (width > 0 && height > 0);
+    Q_ASSERT (stride >= width);
+
+    const Matrix::MatrixView<const quint8> image(pixels, QSize(width, height), stride);
+
+    CircleSearch circleSearch;
+    return searchImage(&circleSearch, image,
+                       getWindow(image.getSize(), options.minDiameter, options.maxDiameter,
+                                 options.area));
+}
+
+
+Detector::Result Detector::detectTiled(TileSource* source, const TileOptions& options,
+                                       QVector<Result>* candidates)
+{
+    Q_ASSERT (source);
+    Q_ASSERT (options.tileSize > 0);
+    Q_ASSERT (options.tileHeight >= 0);
+    Q_ASSERT (options.maxDiameter > 0);
+
+    const QSize size(source->getSize());
+    Q_ASSERT (!size.isEmpty());
+    const QRect bounds(QPoint(0, 0), size);
+
+    // Части плиток без перекрытия делят стороны изображения поровну
+    const int halo = getTileHalo(options.maxDiameter);
+    const QSize grid(getTileGrid(size, options));
+    const int columns = grid.width();
+    const int rows = grid.height();
+
+    QVector<quint8> buffer;     // Плитка с перекрытием
+    CircleSearch circleSearch;  // Поиск (временные матрицы используются всеми плитками)
+    QVector<Result> found;
+    int iterations = 0;
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            const QRect core(QPoint((qint64) size.width() * column / columns,
+                                    (qint64) size.height() * row / rows),
+                             QPoint((qint64) size.width() * (column + 1) / columns - 1,
+                                    (qint64) size.height() * (row + 1) / rows - 1));
+            const QRect tile(core.adjusted(-halo, -halo, halo, halo) & bounds);
+
+            buffer.resize(tile.width() * tile.height());
+            if (!source->readTile(tile, buffer.data(), tile.width()))
+                return Result();
+
+            const Matrix::MatrixView<const quint8> image(buffer.constData(), tile.size(),
+                                                         tile.width());
+            const Result result(searchImage(&circleSearch, image,
+                                            getWindow(tile.size(), options.minDiameter,
+                                                      options.maxDiameter,
+                                                      core.translated(-tile.topLeft())),
+                                            tile.topLeft()));
+            iterations += result.iterations;
+            // Плитки без шарика (например, однородный фон) дают нулевой отклик
+            if (result.found && result.maxVal > 0)
+                found.append(result);
+        }
+    }
+
+    std::stable_sort(found.begin(), found.end(), greaterResponse);
+    if (candidates)
+        *candidates = found;
+
+    Result result(found.isEmpty() ? Result() : found.first());
+    result.iterations = iterations;
+    return result;
+}
+
+
+Detector::Result Detector::detectTiled(const quint8* pixels, int width, int height, int stride,
+                                       const TileOptions& options, QVector<Result>* candidates)
+{
+    Q_ASSERT (pixels);
+    Q_ASSERT (width > 0 && height > 0);
+    Q_ASSERT (stride >= width);
+
+    BufferTileSource source(pixels, width, height, stride);
+    return detectTiled(&source, options, candidates);
+}
+
+
+QSize Detector::getTileGrid(const QSize& size, const TileOptions& options)
+{
+    Q_ASSERT (options.tileSize > 0);
+
+    // Плитка с перекрытием должна вмещать вейвлет наибольшего диаметра
+    const int minSize = 2 * getTileHalo(options.maxDiameter);
+    const int tileWidth = qMax(options.tileSize, minSize);
+    const int tileHeight = qMax((options.tileHeight > 0) ? options.tileHeight : options.tileSize,
+                                minSize);
+    return QSize((size.width() + tileWidth - 1) / tileWidth,
+                 (size.height() + tileHeight - 1) / tileHeight);
+}
+
+
+int Detector::getTileHalo(float maxDiameter)
+{
+    Q_ASSERT (maxDiameter > 0);
+
+    // Размер вейвлета "Французская шляпа" в sqrt(3) раз больше диаметра шара
+    return (int) ceil(maxDiameter * sqrt(3.0) / 2) + 1;
+}
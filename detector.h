@@ -0,0 +1,109 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <QRect>
+#include <QPointF>
+#include <QVector>
+
+#include "tuning.h"
+
+// Синхронный поиск светлого шарика на тёмном фоне в буфере изображения.
+// Не зависит от модулей QtGui и QtWidgets (входит в статическую библиотеку
+// ImageWaveletCore), поэтому может встраиваться в сторонние сервисы.
+// Очень большие изображения прореживаются при построении пирамиды поиска
+// (см. CircleSearch::Max_Search_Elements) без копии исходного размера.
+//
+// Пример использования:
+// Detector::Result result(Detector::detect(frame.data, frame.width, frame.height,
+//                                          frame.bytesPerLine));
+// if (result.found)
+//     process(result.center, result.diameter);
+namespace Detector {
+
+    // Параметры поиска (по-умолчанию поиск не ограничен)
+    struct Options {
+        float minDiameter;      // Минимальный диаметр в пикселах (0 - без ограничения)
+        float maxDiameter;      // Максимальный диаметр в пикселах (0 - без ограничения)
+        QRect area;             // Область центра шарика в пикселах (пустая - всё изображение)
+        Options() : minDiameter(0.0), maxDiameter(0.0) {}
+    };
+
+    // Результат поиска
+    struct Result {
+        bool found;             // Найден ли шарик
+        QPointF center;         // Центр шарика в пикселах
+        float diameter;         // Диаметр шарика в пикселах
+        int maxVal;             // Отклик вейвлета в центре шарика
+        int iterations;         // Кол-во шагов поиска
+        Result() : found(false), diameter(0.0), maxVal(0), iterations(0) {}
+    };
+
+    // Найти шарик в 8-битном изображении в оттенках серого.
+    // pixels - буфер изображения размером width x height,
+    // stride - шаг строк буфера в байтах (не меньше width).
+    // Буфер читается непосредственно (без создания QImage и промежуточной
+    // копии изображения) и должен оставаться неизменным до возврата из функции.
+    // Вычисления выполняются в глобальном пуле потоков, функция потокобезопасна.
+    Result detect(const quint8* pixels, int width, int height, int stride,
+                  const Options& options = Options());
+
+
+    // Источник областей изображения для поиска по плиткам
+    // (например, декодер файла, который умеет читать часть изображения)
+    class TileSource {
+    public:
+        virtual ~TileSource() {}
+
+        // Получить размер изображения
+        virtual QSize getSize(void) const = 0;
+
+        // Прочитать оттенки серого области rect (лежит внутри изображения)
+        // в буфер out размером rect.size() с шагом строк stride в байтах.
+        // Возвращает false при ошибке чтения.
+        virtual bool readTile(const QRect& rect, quint8* out, int stride) = 0;
+    };
+
+    // Параметры поиска по плиткам
+    struct TileOptions {
+        int tileSize;           // Сторона плитки без перекрытия в пикселах (по-умолчанию - из профиля)
+        int tileHeight;         // Высота плитки без перекрытия (0 - равна tileSize)
+        float minDiameter;      // Минимальный диаметр в пикселах (0 - без ограничения)
+        float maxDiameter;      // Максимальный диаметр в пикселах (определяет перекрытие плиток)
+        TileOptions() : tileSize(Tuning::getProfile().tileSize), tileHeight(0),
+                        minDiameter(0.0), maxDiameter(256.0) {}
+    };
+
+    // Найти шарик в изображении, которое читается плитками (например,
+    // в многогигапиксельном скане, который не помещается в память целиком).
+    // Изображение делится на плитки шириной не более tileSize и высотой
+    // не более tileHeight (если задана, иначе - tileSize), каждая читается
+    // с перекрытием на радиус наибольшего вейвлета (halo), поэтому отклик
+    // в плитке совпадает с откликом во всём изображении. Центр ищется только
+    // в своей части плитки (без перекрытия), т.е. каждый центр принадлежит
+    // одной плитке. Из найденных в плитках шариков выбирается шарик
+    // с наибольшим откликом. Плитки обрабатываются по очереди, поэтому
+    // расход памяти определяется размером плитки, а не размером изображения.
+    // Шарики диаметром больше maxDiameter не ищутся.
+    // candidates - если не NULL, то шарики всех плиток (с положительным
+    // откликом) по убыванию отклика.
+    // Возвращает found = false, если плитку не удалось прочитать.
+    Result detectTiled(TileSource* source, const TileOptions& options = TileOptions(),
+                       QVector<Result>* candidates = NULL);
+
+    // Найти шарик по плиткам в 8-битном буфере изображения
+    // (например, в отображённом в память файле, см. QFile::map)
+    Result detectTiled(const quint8* pixels, int width, int height, int stride,
+                       const TileOptions& options = TileOptions(),
+                       QVector<Result>* candidates = NULL);
+
+    // Получить кол-во столбцов и строк плиток изображения размером size
+    // (ширина и высота плитки без перекрытия не меньше двух перекрытий, см. getTileHalo)
+    QSize getTileGrid(const QSize& size, const TileOptions& options);
+
+    // Получить перекрытие плиток (радиус наибольшего вейвлета) в пикселах
+    // для максимального диаметра maxDiameter
+    int getTileHalo(float maxDiameter);
+
+}   // namespace Detector
+
+#endif // DETECTOR_H
@@ -0,0 +1,323 @@
+#include "diameteroptimizer.h"
+
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+    // Доля золотого сечения: (3 - sqrt(5)) / 2
+    const float Golden_Ratio = 0.381966f;
+
+    // Максимальное кол-во шагов метода Брента (защита от зацикливания)
+    const int Max_Brent_Steps = 100;
+
+    // Получить |a| со знаком b
+    inline float withSign(float a, float b) {
+        return (b >= 0.0f) ? fabs(a) : -fabs(a);
+    }
+
+}   // namespace
+
+
+const float DiameterOptimizer::Invalid_Value = -FLT_MAX;
+
+
+// Создать оптимизатор указанного типа
+DiameterOptimizer* DiameterOptimizer::create(Type type, int intervals, int iterations)
+{
+    switch (type) {
+    case Type_Grid:
+        return new GridOptimizer(intervals, iterations);
+    case Type_GoldenSection:
+        return new BrentOptimizer(intervals, false);
+    case Type_Brent:
+        return new BrentOptimizer(intervals, true);
+    }
+    return NULL;
+}
+
+
+GridOptimizer::GridOptimizer(int intervalCount, int iterationCount) :
+    intervals(intervalCount), iterations(iterationCount),
+    iter(0), begin(0.0f), end(0.0f), finished(true)
+{
+    Q_ASSERT (intervals > 0);
+    Q_ASSERT (iterations > 0);
+}
+
+
+void GridOptimizer::reset(float b, float e, float)
+{
+    begin = b;
+    end = e;
+    iter = 0;
+    finished = false;
+    pending.clear();
+}
+
+
+QVector<float> GridOptimizer::getNext(void)
+{
+    if (finished)
+        return QVector<float>();
+
+    const float step = (end - begin) / intervals;
+    pending.clear();
+    float diameter = begin;
+    while (diameter < end) {
+        pending.append(diameter);
+        diameter += step;
+    }
+    // Начиная со второй итерации интервал задан вычисленными диаметрами
+    if (iter > 0)
+        pending.append(end);
+    return pending;
+}
+
+
+void GridOptimizer::setValues(const QVector<float>& values)
+{
+    Q_ASSERT (values.size() == pending.size());
+
+    // Некорректные диаметры исключаются
+    QVector<float> diameters;
+    int maxIndex = -1;
+    float maxValue = 0.0f;
+    for (int i = 0; i < values.size(); ++i) {
+        if (values.at(i) == Invalid_Value)
+            continue;
+        if (values.at(i) > maxValue) {
+            maxValue = values.at(i);
+            maxIndex = diameters.size();
+        }
+        diameters.append(pending.at(i));
+    }
+
+    ++iter;
+    if (maxIndex < 0 || iter >= iterations) {
+        finished = true;
+        return;
+    }
+
+    // Продолжать поиск относительно максимального значения слева и справа
+    begin = diameters.at(qMax(maxIndex - 1, 0));
+    end = diameters.at(qMin(maxIndex + 1, diameters.size() - 1));
+}
+
+
+float GridOptimizer::getProgress(void) const
+{
+    return finished ? 1.0f : (float) iter / iterations;
+}
+
+
+BrentOptimizer::BrentOptimizer(int intervalCount, bool useParabolic) :
+    intervals(intervalCount), parabolic(useParabolic),
+    tolerance(0.0f), initialWidth(0.0f), gridDone(false), finished(true), tied(false), steps(0),
+    a(0.0f), b(0.0f), x(0.0f), w(0.0f), v(0.0f),
+    fx(0.0f), fw(0.0f), fv(0.0f), d(0.0f), e(0.0f)
+{
+    Q_ASSERT (intervals >= 2);
+}
+
+
+void BrentOptimizer::reset(float begin, float end, float tol)
+{
+    Q_ASSERT (tol > 0.0f);
+
+    tolerance = tol;
+    gridDone = false;
+    finished = false;
+    tied = false;
+    steps = 0;
+    a = begin;
+    b = end;
+
+    // Равномерная сетка (вычисляется параллельно)
+    pending.clear();
+    for (int i = 0; i <= intervals; ++i)
+        pending.append(begin + (end - begin) * i / intervals);
+}
+
+
+QVector<float> BrentOptimizer::getNext(void)
+{
+    if (finished)
+        return QVector<float>();
+    return pending;
+}
+
+
+void BrentOptimizer::setValues(const QVector<float>& values)
+{
+    Q_ASSERT (values.size() == pending.size());
+
+    if (!gridDone) {
+        gridDone = true;
+
+        // Лучшая точка сетки и её соседи задают начальный интервал
+        int best = -1;
+        for (int i = 0; i < values.size(); ++i)
+            if (values.at(i) != Invalid_Value && (best < 0 || values.at(i) > values.at(best)))
+                best = i;
+        if (best < 0) {
+            finished = true;
+            return;
+        }
+        const int left = qMax(best - 1, 0);
+        const int right = qMin(best + 1, values.size() - 1);
+        a = pending.at(left);
+        b = pending.at(right);
+        x = pending.at(best);
+        fx = -values.at(best);
+
+        // Соседи - вторая и третья точки для параболы
+        w = v = x;
+        fw = fv = fx;
+        if (left != best) {
+            w = pending.at(left);
+            fw = -values.at(left);
+        }
+        if (right != best) {
+            v = pending.at(right);
+            fv = -values.at(right);
+            if (fv < fw || w == x) {
+                qSwap(v, w);
+                qSwap(fv, fw);
+            }
+        }
+        d = 0.0f;
+        e = b - a;      // Разрешить параболу на первом шаге
+        initialWidth = b - a;
+    }
+    else {
+        // Точки шага учитываются по очереди; точка, оказавшаяся за пределами
+        // интервала после учёта предыдущей, не учитывается.
+        // Отклик постоянен на участках диаметров с одинаковыми размерами
+        // вейвлета и матрицы, поэтому значение, равное значению в x,
+        // не говорит, с какой стороны максимум, и тоже не учитывается.
+        bool changed = false;
+        for (int i = 0; i < pending.size(); ++i) {
+            const float u = pending.at(i);
+            const float fu = (values.at(i) == Invalid_Value) ? FLT_MAX : -values.at(i);
+            if (u <= a || u >= b || fu == fx)
+                continue;
+            update(u, fu);
+            changed = true;
+        }
+
+        // Шаг без новых значений повторяется золотым сечением (дальше от x);
+        // если и оно их не дало, то отклик постоянен вокруг x и поиск завершается
+        if (!changed && tied) {
+            finished = true;
+            return;
+        }
+        tied = !changed;
+    }
+
+    if (steps >= Max_Brent_Steps || !step())
+        finished = true;
+    ++steps;
+}
+
+
+// Учесть значение fu в точке u внутри интервала [a, b]
+void BrentOptimizer::update(float u, float fu)
+{
+    if (fu <= fx) {
+        if (u >= x)
+            a = x;
+        else
+            b = x;
+        v = w; fv = fw;
+        w = x; fw = fx;
+        x = u; fx = fu;
+    }
+    else {
+        if (u < x)
+            a = u;
+        else
+            b = u;
+        if (fu <= fw || w == x) {
+            v = w; fv = fw;
+            w = u; fw = fu;
+        }
+        else if (fu <= fv || v == x || v == w) {
+            v = u; fv = fu;
+        }
+    }
+}
+
+
+// Вычислить следующие диаметры
+bool BrentOptimizer::step(void)
+{
+    // Поиск завершается, когда x не дальше tol2 = tolerance от обоих концов
+    // интервала (его ширина не больше 2 * tolerance), а значит, и от максимума
+    const float xm = 0.5f * (a + b);
+    const float tol1 = 0.5f * tolerance;
+    const float tol2 = 2.0f * tol1;
+
+    if (fabs(x - xm) <= tol2 - 0.5f * (b - a))
+        return false;
+
+    bool golden = true;
+    if (parabolic && fabs(e) > tol1 && !tied) {
+        // Вершина параболы через точки x, w, v
+        const float r = (x - w) * (fx - fv);
+        float q = (x - v) * (fx - fw);
+        float p = (x - v) * q - (x - w) * r;
+        q = 2.0f * (q - r);
+        if (q > 0.0f)
+            p = -p;
+        q = fabs(q);
+        const float etemp = e;
+        e = d;
+        // Вершина принимается, если она внутри интервала
+        // и шаг меньше половины шага перед предыдущим
+        if (!(fabs(p) >= fabs(0.5f * q * etemp) || p <= q * (a - x) || p >= q * (b - x))) {
+            d = p / q;
+            const float u = x + d;
+            if (u - a < tol2 || b - u < tol2)
+                d = withSign(tol1, xm - x);
+            golden = false;
+        }
+    }
+    if (golden) {
+        e = (x >= xm) ? a - x : b - x;
+        d = Golden_Ratio * e;
+    }
+
+    const float u = (fabs(d) >= tol1) ? x + d : x + withSign(tol1, d);
+    pending.clear();
+    pending.append(u);
+
+    // Дополнительные точки шага (вычисляются параллельно с u):
+    // соседи вершины параболы на расстоянии tol2 - если вершина точна,
+    // то интервал сужается до 2 * tol2 за один шаг, - и золотое сечение
+    // интервала по другую сторону от x - если x останется лучшей точкой,
+    // то интервал сузится с обеих сторон
+    QVector<float> extra;
+    if (!golden) {
+        extra.append(u - tol2);
+        extra.append(u + tol2);
+    }
+    extra.append(x + Golden_Ratio * ((u >= x) ? a - x : b - x));
+    for (int i = 0; i < extra.size(); ++i) {
+        const float c = extra.at(i);
+        if (c > a && c < b && fabs(c - x) >= tol1 && fabs(c - u) >= tol1)
+            pending.append(c);
+    }
+    return true;
+}
+
+
+float BrentOptimizer::getProgress(void) const
+{
+    if (finished)
+        return 1.0f;
+    if (!gridDone || initialWidth <= 2.0f * tolerance)
+        return 0.0f;
+    const float progress = log(initialWidth / (b - a)) / log(initialWidth / (2.0f * tolerance));
+    return qBound(0.0f, progress, 1.0f);
+}
@@ -0,0 +1,110 @@
+#ifndef DIAMETEROPTIMIZER_H
+#define DIAMETEROPTIMIZER_H
+
+#include <QVector>
+
+// Поиск диаметра, при котором отклик вейвлета максимален.
+// Оптимизатор предлагает наборы диаметров (getNext), значения отклика
+// для которых вычисляются параллельно и передаются обратно (setValues),
+// пока диаметр не будет определён с заданной точностью.
+// Недопустимым диаметрам соответствует значение Invalid_Value.
+class DiameterOptimizer {
+public:
+    // Значение отклика для диаметра, который не удалось вычислить
+    static const float Invalid_Value;
+
+    // Способ поиска
+    enum Type {
+        Type_Grid = 0,          // Сужение равномерной сетки вокруг максимума
+        Type_GoldenSection,     // Сетка, затем метод золотого сечения
+        Type_Brent              // Сетка, затем метод Брента (параболы и золотое сечение)
+    };
+
+    // Создать оптимизатор указанного типа.
+    // intervals - кол-во интервалов равномерной сетки,
+    // iterations - кол-во итераций сужения сетки (для Type_Grid).
+    static DiameterOptimizer* create(Type type, int intervals, int iterations);
+
+    virtual ~DiameterOptimizer() {}
+
+    // Начать поиск на интервале [begin, end] с точностью tolerance
+    // (в тех же единицах, что и диаметр)
+    virtual void reset(float begin, float end, float tolerance) = 0;
+
+    // Получить диаметры для следующего вычисления
+    // (пустой набор - поиск завершён)
+    virtual QVector<float> getNext(void) = 0;
+
+    // Передать значения отклика для диаметров, полученных из getNext (в том же порядке)
+    virtual void setValues(const QVector<float>& values) = 0;
+
+    // Получить долю выполненного поиска (от 0 до 1.0)
+    virtual float getProgress(void) const = 0;
+};
+
+
+// Сужение равномерной сетки: на каждой итерации вычисляются intervals + 1
+// диаметров, и интервал сужается до соседей диаметра с максимальным
+// откликом. Поиск завершается через iterations итераций
+// (точность не учитывается).
+class GridOptimizer : public DiameterOptimizer {
+public:
+    GridOptimizer(int intervals, int iterations);
+
+    void reset(float begin, float end, float tolerance);
+    QVector<float> getNext(void);
+    void setValues(const QVector<float>& values);
+    float getProgress(void) const;
+
+private:
+    int intervals, iterations;
+    int iter;                   // Номер текущей итерации
+    float begin, end;           // Текущий интервал
+    bool finished;
+    QVector<float> pending;     // Диаметры текущей итерации
+};
+
+
+// Поиск максимума унимодальной функции методом Брента на отрезке, найденном
+// по равномерной сетке из intervals + 1 диаметров (вычисляются параллельно).
+// Далее на каждом шаге параллельно вычисляются несколько диаметров: точка
+// метода Брента (вершина параболы, проходящей через три лучших точки, и её
+// соседи на расстоянии tolerance, а если вершина ненадёжна - точка золотого
+// сечения большего из интервалов) и точка золотого сечения интервала
+// по другую сторону от лучшей точки.
+// Без парабол (parabolic = false) выполняется поиск методом золотого сечения.
+// Поиск завершается, когда интервал, содержащий максимум, сужается
+// до 2 * tolerance (диаметр определён с точностью tolerance).
+class BrentOptimizer : public DiameterOptimizer {
+public:
+    BrentOptimizer(int intervals, bool parabolic);
+
+    void reset(float begin, float end, float tolerance);
+    QVector<float> getNext(void);
+    void setValues(const QVector<float>& values);
+    float getProgress(void) const;
+
+private:
+    // Вычислить следующие диаметры; false - точность достигнута
+    bool step(void);
+
+    // Учесть значение fu (со знаком минус) в точке u внутри интервала
+    void update(float u, float fu);
+
+    int intervals;
+    bool parabolic;
+    float tolerance;
+    float initialWidth;         // Ширина интервала после вычисления сетки
+    bool gridDone, finished;
+    bool tied;                  // Предыдущий шаг не дал новых значений
+    int steps;                  // Кол-во выполненных шагов метода Брента
+    QVector<float> pending;     // Диаметры, ожидающие значений
+
+    // Состояние метода Брента (минимизируется значение отклика со знаком минус):
+    // [a, b] - интервал, содержащий минимум; x - лучшая точка,
+    // w - вторая по значению, v - предыдущее значение w;
+    // d - последний шаг, e - шаг перед предыдущим
+    float a, b, x, w, v, fx, fw, fv, d, e;
+};
+
+#endif // DIAMETEROPTIMIZER_H
@@ -0,0 +1,528 @@
+#include "fftengine.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QCache>
+#include <qmath.h>
+#include <climits>
+
+#include "wavelet.h"
+#include "parallel.h"
+
+using namespace Wavelet;
+
+namespace Wavelet {
+
+    // Спектр вейвлета в кеше спектров
+    struct FftSpectrum {
+        QSize wSize;
+        QVector<int> values;            // Значения вейвлета (для проверки совпадения)
+        Matrix::Matrix2D<Complex> data; // Сопряжённый спектр
+    };
+
+}   // namespace Wavelet
+
+namespace {
+
+    // Ключ кеша спектров вейвлетов
+    struct SpectrumKey {
+        quint64 hash;       // Хеш значений вейвлета
+        QSize wSize;        // Размер вейвлета
+        QSize nSize;        // Размер преобразования
+        bool operator== (const SpectrumKey& right) const {
+            return hash == right.hash && wSize == right.wSize && nSize == right.nSize;
+        }
+    };
+
+    inline uint qHash(const SpectrumKey& key, uint seed = 0) {
+        return ::qHash(key.hash, seed) ^ (key.nSize.width() * 31 + key.nSize.height());
+    }
+
+    // Ограничение объёма кеша спектров по-умолчанию (в килобайтах)
+    const int Default_Spectrum_Cache_KBytes = 256 * 1024;
+
+    QMutex planMutex;
+    QHash<int, QSharedPointer<const FftPlan> > planCache;
+
+    QMutex spectrumMutex;
+    QCache<SpectrumKey, QSharedPointer<const FftSpectrum> > spectrumCache(Default_Spectrum_Cache_KBytes);
+
+    // Получить наименьшую степень двойки, не меньшую n (и не меньшую 2)
+    int nextPowerOfTwo(int n) {
+        int p = 2;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    // Умножение комплексных чисел без проверок на бесконечность
+    inline Complex mul(const Complex& a, const Complex& b) {
+        return Complex(a.real() * b.real() - a.imag() * b.imag(),
+                       a.real() * b.imag() + a.imag() * b.real());
+    }
+
+    // Объём строк (столбцов) преобразования в части, выполняемой одним потоком
+    // (кеш второго уровня)
+    const int Chunk_Cache_Bytes = 256 * 1024;
+
+    // Минимальное кол-во строк (столбцов) в части
+    const int Min_Chunk_Lines = 4;
+
+    // Получить кол-во строк (столбцов) длиной length в части из count строк
+    inline int getLineChunk(int count, int length) {
+        return Parallel::getChunkSize(count, Min_Chunk_Lines,
+                                      qMax(Min_Chunk_Lines, Chunk_Cache_Bytes / (int) (length * sizeof(Complex))));
+    }
+
+}   // namespace
+
+
+FftPlan::FftPlan(int n) : size(n)
+{
+    Q_ASSERT (n >= 2 && (n & (n - 1)) == 0);
+
+    twiddles.resize(n / 2);
+    for (int k = 0; k < n / 2; ++k) {
+        const double angle = -2.0 * M_PI * k / n;
+        twiddles[k] = Complex(cos(angle), sin(angle));
+    }
+
+    int bits = 0;
+    while ((1 << bits) < n)
+        ++bits;
+    bitReverse.resize(n);
+    for (int i = 0; i < n; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b)
+            if (i & (1 << b))
+                r |= 1 << (bits - 1 - b);
+        bitReverse[i] = r;
+    }
+}
+
+
+// Выполнить преобразование на месте
+void FftPlan::transform(Complex* data, bool inverse) const
+{
+    Q_ASSERT (data);
+
+    for (int i = 0; i < size; ++i) {
+        const int j = bitReverse.at(i);
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    const Complex* tw = twiddles.constData();
+    for (int len = 2; len <= size; len <<= 1) {
+        const int half = len >> 1;
+        const int step = size / len;
+        for (int i = 0; i < size; i += len)
+            for (int k = 0; k < half; ++k) {
+                const Complex w = inverse ? std::conj(tw[k * step]) : tw[k * step];
+                const Complex u = data[i + k];
+                const Complex v = mul(data[i + k + half], w);
+                data[i + k] = u + v;
+                data[i + k + half] = u - v;
+            }
+    }
+}
+
+
+// Получить разделяемый план для размера n
+QSharedPointer<const FftPlan> FftPlan::get(int n)
+{
+    QMutexLocker locker(&planMutex);
+    QSharedPointer<const FftPlan> plan = planCache.value(n);
+    if (plan.isNull()) {
+        plan = QSharedPointer<const FftPlan>(new FftPlan(n));
+        planCache.insert(n, plan);
+    }
+    return plan;
+}
+
+
+FftEngine::FftEngine()
+{
+}
+
+
+// Получить размер преобразования
+QSize FftEngine::getTransformSize(const QSize& inSize, const QSize& wSize)
+{
+    Q_ASSERT (!inSize.isEmpty());
+    Q_ASSERT (!wSize.isEmpty());
+
+    // Элементы за пределами данных (со смещением до радиуса вейвлета
+    // в обе стороны) не должны накладываться на данные при циклическом сдвиге
+    return QSize(nextPowerOfTwo(qMax(inSize.width() + wSize.width() / 2, wSize.width())),
+                 nextPowerOfTwo(qMax(inSize.height() + wSize.height() / 2, wSize.height())));
+}
+
+
+// Вычислить свёртку
+void FftEngine::impose(Matrix::Matrix2D<int>* outMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QPoint& topLeft,
+                       const QPoint& bottomRight)
+{
+    Q_ASSERT (outMatrix);
+    Q_ASSERT (!inMatrix.isNull());
+
+    const QRect region(getImposeRegion(inMatrix.getSize(), topLeft, bottomRight));
+    outMatrix->resize(region.size());
+    impose(outMatrix->view(), inMatrix, wMatrix, outsideValue, region);
+}
+
+
+// Вычислить свёртку для области region матрицы данных
+void FftEngine::impose(const Matrix::MatrixView<int>& outMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region)
+{
+    Q_ASSERT (!outMatrix.isNull());
+    Q_ASSERT (!inMatrix.isNull());
+    Q_ASSERT (!wMatrix.isNull());
+    Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+    Q_ASSERT (outMatrix.getSize() == region.size());
+
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, NULL);
+}
+
+
+// Вычислить свёртку для области region и найти экстремумы результата
+void FftEngine::impose(Matrix::ExtremumsAccumulator* extremums,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       const Matrix::MatrixView<int>& outMatrix)
+{
+    Q_ASSERT (extremums);
+    Q_ASSERT (!inMatrix.isNull());
+    Q_ASSERT (!wMatrix.isNull());
+    Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+    Q_ASSERT (outMatrix.isNull() || outMatrix.getSize() == region.size());
+
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, extremums);
+}
+
+
+void FftEngine::impose(Matrix::ExtremumsAccumulator* extremums,
+                       const Matrix::MatrixView<const quint8>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       const Matrix::MatrixView<int>& outMatrix)
+{
+    Q_ASSERT (extremums);
+    Q_ASSERT (!inMatrix.isNull());
+    Q_ASSERT (!wMatrix.isNull());
+    Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+    Q_ASSERT (outMatrix.isNull() || outMatrix.getSize() == region.size());
+
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, extremums);
+}
+
+
+// Вычислить свёртку для области region матрицы данных любого типа
+template <class T>
+void FftEngine::imposeRegion(const Matrix::MatrixView<int>& outMatrix,
+                             const Matrix::MatrixView<const T>& inMatrix,
+                             const Matrix::MatrixView<const int>& wMatrix,
+                             int outsideValue,
+                             const QRect& region,
+                             Matrix::ExtremumsAccumulator* extremums)
+{
+    const int inWidth = inMatrix.getWidth();
+    const int inHeight = inMatrix.getHeight();
+    const int wXCenter = wMatrix.getWidth() / 2;
+    const int wYCenter = wMatrix.getHeight() / 2;
+    const long long wCount = wMatrix.getWidth() * wMatrix.getHeight();
+
+    // Планы переиспользуются, пока размер преобразования не изменится
+    const QSize nSize(getTransformSize(inMatrix.getSize(), wMatrix.getSize()));
+    const int nx = nSize.width();
+    const int ny = nSize.height();
+    if (rowPlan.isNull() || rowPlan->getSize() != nx)
+        rowPlan = FftPlan::get(nx);
+    if (columnPlan.isNull() || columnPlan->getSize() != ny)
+        columnPlan = FftPlan::get(ny);
+
+    // Значение outsideValue вычитается из данных, чтобы область за пределами
+    // матрицы данных была нулевой. Его вклад добавляется к результату отдельно.
+    long long wSum = 0;
+    for (int wj = 0; wj < wMatrix.getHeight(); ++wj) {
+        const int* wRow = wMatrix.getRow(wj);
+        for (int wi = 0; wi < wMatrix.getWidth(); ++wi)
+            wSum += wRow[wi];
+    }
+    const long long outsideSum = wSum * outsideValue;
+
+    // Строки данных, преобразования строк и столбцов и строки результата
+    // вычисляются параллельно частями (см. Parallel::forRange)
+    realMatrix.resize(QSize(nx, inHeight));
+    Parallel::forRange(0, inHeight, getLineChunk(inHeight, nx), [&](int first, int last) {
+        for (int y = first; y < last; ++y) {
+            const T* inRow = inMatrix.getRow(y);
+            double* row = realMatrix.getRow(y);
+            for (int x = 0; x < inWidth; ++x)
+                row[x] = inRow[x] - outsideValue;
+            for (int x = inWidth; x < nx; ++x)
+                row[x] = 0.0;
+        }
+    });
+
+    forward(&spectrumMatrix, realMatrix, inHeight);
+
+    // Умножить спектр данных на сопряжённый спектр вейвлета (корреляция)
+    QSharedPointer<const FftSpectrum> wSpectrum(getSpectrum(wMatrix, nSize));
+    Parallel::forRange(0, ny, getLineChunk(ny, nx / 2 + 1), [&](int first, int last) {
+        for (int y = first; y < last; ++y) {
+            Complex* row = spectrumMatrix.getRow(y);
+            const Complex* wRow = wSpectrum->data.getRow(y);
+            for (int k = 0; k <= nx / 2; ++k)
+                row[k] = mul(row[k], wRow[k]);
+        }
+    });
+
+    transformColumns(&spectrumMatrix, true);
+
+    // Обратное преобразование только тех строк, которые попадают в результат
+    // (попарно). Результат для элемента (i, j) находится в элементе
+    // ((i - wXCenter) mod nx, (j - wYCenter) mod ny) циклической корреляции.
+    // Экстремумы каждой части находятся отдельно и объединяются после вычисления.
+    const int outHeight = region.height();
+    const int pairCount = (outHeight + 1) / 2;
+    const int chunk = getLineChunk(pairCount, nx);
+    realMatrix.resize(QSize(nx, outHeight));
+
+    QVector<Matrix::ExtremumsAccumulator> partExtremums;
+    if (extremums)
+        partExtremums.fill(Matrix::ExtremumsAccumulator(extremums->minVal, extremums->maxVal),
+                           (pairCount + chunk - 1) / chunk);
+    Matrix::ExtremumsAccumulator* parts = partExtremums.data();
+
+    const double scale = 1.0 / ((double) nx * ny);
+    Parallel::forRange(0, pairCount, chunk, [&](int first, int last) {
+        QVector<Complex> buffer(nx);
+        QVector<int> rowBuffer(outMatrix.isNull() ? region.width() : 0);
+        Matrix::ExtremumsAccumulator* part = extremums ? &parts[first / chunk] : NULL;
+        for (int oj = 2 * first; oj < qMin(2 * last, outHeight); ++oj) {
+            if (oj % 2 == 0) {
+                const int y0 = (region.top() + oj - wYCenter + ny) % ny;
+                const bool pair = (oj + 1 < outHeight);
+                const int y1 = (y0 + 1) % ny;
+                inverseRows(realMatrix.getRow(oj), pair ? realMatrix.getRow(oj + 1) : NULL,
+                            spectrumMatrix.getRow(y0), pair ? spectrumMatrix.getRow(y1) : NULL,
+                            buffer.data());
+            }
+
+            const double* row = realMatrix.getRow(oj);
+            int* outRow = outMatrix.isNull() ? rowBuffer.data() : outMatrix.getRow(oj);
+            for (int i = region.left(), oi = 0; i <= region.right(); ++i, ++oi) {
+                const int x = (i - wXCenter + nx) % nx;
+                const long long sum = qRound64(row[x] * scale) + outsideSum;
+                outRow[oi] = sum / wCount;
+            }
+            if (part)
+                part->addRow(outRow, region.width(), 0, oj);
+        }
+    });
+
+    for (int p = 0; p < partExtremums.size(); ++p)
+        extremums->merge(partExtremums.at(p));
+}
+
+
+// Получить объём памяти, занятой вычислителем
+size_t FftEngine::getBytes(void) const
+{
+    return realMatrix.getCapacityBytes() + spectrumMatrix.getCapacityBytes();
+}
+
+
+// Ограничить объём памяти кеша спектров вейвлетов
+void FftEngine::setSpectrumCacheLimit(size_t bytes)
+{
+    QMutexLocker locker(&spectrumMutex);
+    spectrumCache.setMaxCost((int) qMin(bytes / 1024, (size_t) INT_MAX));
+}
+
+
+// Очистить кеши спектров вейвлетов и планов БПФ
+void FftEngine::clearCaches(void)
+{
+    {
+        QMutexLocker locker(&spectrumMutex);
+        spectrumCache.clear();
+    }
+    QMutexLocker locker(&planMutex);
+    planCache.clear();
+}
+
+
+// Получить сопряжённый спектр вейвлета
+QSharedPointer<const FftSpectrum> FftEngine::getSpectrum(const Matrix::MatrixView<const int>& wMatrix,
+                                                         const QSize& nSize)
+{
+    const int wWidth = wMatrix.getWidth();
+    const int wHeight = wMatrix.getHeight();
+
+    // Значения вейвлета и их хеш (FNV-1a)
+    QVector<int> values(wWidth * wHeight);
+    quint64 hash = 14695981039346656037ULL;
+    for (int wj = 0; wj < wHeight; ++wj) {
+        const int* wRow = wMatrix.getRow(wj);
+        for (int wi = 0; wi < wWidth; ++wi) {
+            values[wj * wWidth + wi] = wRow[wi];
+            hash = (hash ^ (quint32) wRow[wi]) * 1099511628211ULL;
+        }
+    }
+
+    SpectrumKey key;
+    key.hash = hash;
+    key.wSize = wMatrix.getSize();
+    key.nSize = nSize;
+
+    {
+        QMutexLocker locker(&spectrumMutex);
+        QSharedPointer<const FftSpectrum>* cached = spectrumCache.object(key);
+        if (cached != NULL && (*cached)->values == values)
+            return *cached;
+    }
+
+    // Вычислить спектр вейвлета, расположенного в начале координат
+    FftSpectrum* spectrum = new FftSpectrum;
+    spectrum->wSize = wMatrix.getSize();
+    spectrum->values = values;
+
+    Matrix::Matrix2D<double> rows(QSize(nSize.width(), wHeight));
+    for (int wj = 0; wj < wHeight; ++wj) {
+        const int* wRow = wMatrix.getRow(wj);
+        double* row = rows.getRow(wj);
+        for (int wi = 0; wi < wWidth; ++wi)
+            row[wi] = wRow[wi];
+        for (int wi = wWidth; wi < nSize.width(); ++wi)
+            row[wi] = 0.0;
+    }
+    forward(&spectrum->data, rows, wHeight);
+    for (int y = 0; y < nSize.height(); ++y) {
+        Complex* row = spectrum->data.getRow(y);
+        for (int k = 0; k <= nSize.width() / 2; ++k)
+            row[k] = std::conj(row[k]);
+    }
+
+    QSharedPointer<const FftSpectrum> result(spectrum);
+    const int cost = (int) qMax((size_t) 1, spectrum->data.getCapacityBytes() / 1024);
+
+    QMutexLocker locker(&spectrumMutex);
+    spectrumCache.insert(key, new QSharedPointer<const FftSpectrum>(result), cost);
+    return result;
+}
+
+
+// Прямое двумерное преобразование вещественной матрицы
+void FftEngine::forward(Matrix::Matrix2D<Complex>* spectrum,
+                        const Matrix::Matrix2D<double>& rows, int usedRows) const
+{
+    Q_ASSERT (spectrum);
+
+    const int nx = rowPlan->getSize();
+    const int ny = columnPlan->getSize();
+    const int halfX = nx / 2;
+    Q_ASSERT (rows.getWidth() == nx);
+    Q_ASSERT (usedRows <= ny && usedRows <= rows.getHeight());
+
+    spectrum->resize(QSize(halfX + 1, ny));
+
+    // Преобразование строк (пары строк независимы и вычисляются параллельно):
+    // две вещественные строки a и b преобразуются как одна комплексная
+    // z = a + i * b, затем A[k] = (Z[k] + conj(Z[n - k])) / 2, B[k] = (Z[k] - conj(Z[n - k])) / 2i
+    const int pairCount = (usedRows + 1) / 2;
+    Parallel::forRange(0, pairCount, getLineChunk(pairCount, nx), [&](int first, int last) {
+        QVector<Complex> buffer(nx);
+        Complex* buf = buffer.data();
+        for (int y = 2 * first; y < qMin(2 * last, usedRows); y += 2) {
+            const double* a = rows.getRow(y);
+            const double* b = (y + 1 < usedRows) ? rows.getRow(y + 1) : NULL;
+            for (int x = 0; x < nx; ++x)
+                buf[x] = Complex(a[x], b != NULL ? b[x] : 0.0);
+            rowPlan->transform(buf, false);
+
+            Complex* specA = spectrum->getRow(y);
+            Complex* specB = (b != NULL) ? spectrum->getRow(y + 1) : NULL;
+            for (int k = 0; k <= halfX; ++k) {
+                const Complex zk = buf[k];
+                const Complex zn = std::conj(buf[(nx - k) & (nx - 1)]);
+                specA[k] = (zk + zn) * 0.5;
+                if (specB != NULL)
+                    specB[k] = Complex((zk - zn).imag() * 0.5, -(zk - zn).real() * 0.5);
+            }
+        }
+    });
+    for (int y = usedRows; y < ny; ++y) {
+        Complex* row = spectrum->getRow(y);
+        for (int k = 0; k <= halfX; ++k)
+            row[k] = Complex();
+    }
+
+    transformColumns(spectrum, false);
+}
+
+
+// Преобразование по столбцам спектра
+void FftEngine::transformColumns(Matrix::Matrix2D<Complex>* spectrum, bool inverse) const
+{
+    Q_ASSERT (spectrum);
+
+    // Столбцы независимы и вычисляются параллельно
+    const int ny = columnPlan->getSize();
+    const int width = spectrum->getWidth();
+    Parallel::forRange(0, width, getLineChunk(width, ny), [&](int first, int last) {
+        QVector<Complex> buffer(ny);
+        Complex* buf = buffer.data();
+        for (int k = first; k < last; ++k) {
+            for (int y = 0; y < ny; ++y)
+                buf[y] = spectrum->getRow(y)[k];
+            columnPlan->transform(buf, inverse);
+            for (int y = 0; y < ny; ++y)
+                spectrum->getRow(y)[k] = buf[y];
+        }
+    });
+}
+
+
+// Обратное преобразование двух строк спектра
+void FftEngine::inverseRows(double* row0, double* row1,
+                            const Complex* spec0, const Complex* spec1, Complex* buf) const
+{
+    Q_ASSERT (row0 && spec0);
+    Q_ASSERT (buf);
+
+    const int nx = rowPlan->getSize();
+    const int halfX = nx / 2;
+
+    // Z[k] = A[k] + i * B[k], где спектры вещественных строк
+    // продолжаются по симметрии: A[n - k] = conj(A[k])
+    for (int k = 0; k <= halfX; ++k) {
+        const Complex b = (spec1 != NULL) ? spec1[k] : Complex();
+        buf[k] = spec0[k] + Complex(-b.imag(), b.real());
+    }
+    for (int k = halfX + 1; k < nx; ++k) {
+        const Complex a = std::conj(spec0[nx - k]);
+        const Complex b = (spec1 != NULL) ? std::conj(spec1[nx - k]) : Complex();
+        buf[k] = a + Complex(-b.imag(), b.real());
+    }
+    rowPlan->transform(buf, true);
+
+    for (int x = 0; x < nx; ++x) {
+        row0[x] = buf[x].real();
+        if (row1 != NULL)
+            row1[x] = buf[x].imag();
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef FFTENGINE_H
+#define FFTENGINE_H
+
+#include <QVector>
+#include <QRect>
+#include <QSharedPointer>
+#include <complex>
+
+#include "matrix.h"
+#include "matrixutils.h"
+
+namespace Wavelet {
+
+    typedef std::complex<double> Complex;
+
+    struct FftSpectrum;     // Спектр вейвлета в кеше спектров
+
+    // План одномерного быстрого преобразования Фурье (БПФ) размером n
+    // (степень двойки): таблицы поворотных множителей и перестановки элементов.
+    // Планы не изменяются после создания и разделяются между потоками.
+    class FftPlan {
+    public:
+        explicit FftPlan(int n);
+
+        // Получить размер преобразования
+        int getSize(void) const { return size; }
+
+        // Выполнить преобразование над data (size элементов) на месте.
+        // Обратное преобразование не нормируется (результат умножен на size).
+        void transform(Complex* data, bool inverse) const;
+
+        // Получить разделяемый план для размера n (из кеша планов)
+        static QSharedPointer<const FftPlan> get(int n);
+
+    private:
+        int size;
+        QVector<Complex> twiddles;      // exp(-2 * pi * i * k / size), k < size / 2
+        QVector<int> bitReverse;        // Перестановка элементов перед преобразованием
+    };
+
+
+    // Вычисление свёртки матрицы данных с матрицей вейвлета через БПФ.
+    // Трудоёмкость O(N * log N) и не зависит от размера вейвлета, поэтому
+    // выгодна для больших вейвлетов с плотным носителем (например, MHAT).
+    // Матрица данных и вейвлет дополняются до размеров, кратных степени двойки,
+    // не меньших суммы размера данных и радиуса вейвлета, поэтому
+    // циклическая свёртка совпадает с линейной.
+    // Вещественные строки преобразуются попарно (две строки - как одна комплексная).
+    // Пары строк, столбцы спектра и строки результата вычисляются параллельно
+    // в глобальном пуле потоков (см. Parallel::forRange).
+    // Спектры вейвлетов кешируются для всего процесса по содержимому вейвлета
+    // и размеру преобразования, планы БПФ - по размеру преобразования,
+    // поэтому повторные вычисления для тех же размеров не пересчитывают их.
+    // Сумма вычисляется в числах с плавающей точкой и округляется до целого,
+    // после чего делится на кол-во элементов вейвлета как в Wavelet::imposeWavelet.
+    // При соблюдении ограничений imposeWavelet (произведение значений по модулю
+    // не превышает 2^31, сумма - 2^50) результат совпадает с imposeWavelet.
+    // За пределами матрицы данные продолжаются значением outsideValue. Для других
+    // способов (Matrix::BorderMode) матрицу данных следует дополнить на радиус
+    // вейвлета функцией Matrix::padMatrix и вычислять свёртку для области region.
+    class FftEngine {
+    public:
+        FftEngine();
+
+        // Вычислить свёртку (параметры см. в Wavelet::imposeWavelet)
+        void impose(Matrix::Matrix2D<int>* outMatrix,
+                    const Matrix::MatrixView<const int>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue = 0,
+                    const QPoint& topLeft = QPoint(-1, -1),
+                    const QPoint& bottomRight = QPoint(-1, -1));
+
+        // Вычислить свёртку для области region матрицы данных
+        // и записать результат в представление outMatrix размером region.
+        void impose(const Matrix::MatrixView<int>& outMatrix,
+                    const Matrix::MatrixView<const int>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue,
+                    const QRect& region);
+
+        // Вычислить свёртку для области region матрицы данных и учесть её
+        // элементы в extremums (координаты - относительно region) без записи
+        // всей матрицы результата. Если задано представление outMatrix
+        // размером region, то результат также записывается в него (для отладки).
+        void impose(Matrix::ExtremumsAccumulator* extremums,
+                    const Matrix::MatrixView<const int>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue,
+                    const QRect& region,
+                    const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+        void impose(Matrix::ExtremumsAccumulator* extremums,
+                    const Matrix::MatrixView<const quint8>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue,
+                    const QRect& region,
+                    const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+
+        // Получить размер преобразования (по каждой оси) для матрицы данных
+        // размером inSize и вейвлета размером wSize
+        static QSize getTransformSize(const QSize& inSize, const QSize& wSize);
+
+        // Получить объём памяти, занятой вычислителем, в байтах
+        // (без учёта разделяемых кешей планов и спектров)
+        size_t getBytes(void) const;
+
+        // Ограничить объём памяти кеша спектров вейвлетов (в байтах)
+        static void setSpectrumCacheLimit(size_t bytes);
+
+        // Очистить кеши спектров вейвлетов и планов БПФ
+        static void clearCaches(void);
+
+    private:
+        // Вычислить свёртку для области region матрицы данных любого типа
+        // (outMatrix и extremums могут быть не заданы)
+        template <class T>
+        void imposeRegion(const Matrix::MatrixView<int>& outMatrix,
+                          const Matrix::MatrixView<const T>& inMatrix,
+                          const Matrix::MatrixView<const int>& wMatrix,
+                          int outsideValue,
+                          const QRect& region,
+                          Matrix::ExtremumsAccumulator* extremums);
+
+        // Получить сопряжённый спектр вейвлета для преобразования размером nSize
+        QSharedPointer<const FftSpectrum> getSpectrum(const Matrix::MatrixView<const int>& wMatrix,
+                                                      const QSize& nSize);
+
+        // Выполнить прямое двумерное преобразование вещественной матрицы
+        // (её строки уже записаны в rows) в спектр spectrum
+        void forward(Matrix::Matrix2D<Complex>* spectrum,
+                     const Matrix::Matrix2D<double>& rows, int usedRows) const;
+
+        // Выполнить прямое или обратное преобразование по столбцам спектра
+        void transformColumns(Matrix::Matrix2D<Complex>* spectrum, bool inverse) const;
+
+        // Выполнить обратное преобразование строк spec0 и spec1 спектра
+        // и записать вещественный результат в строки row0 и row1
+        // (spec1 и row1 могут быть равны NULL). buf - строка преобразования.
+        void inverseRows(double* row0, double* row1,
+                         const Complex* spec0, const Complex* spec1, Complex* buf) const;
+
+        QSharedPointer<const FftPlan> rowPlan, columnPlan;
+
+        Matrix::Matrix2D<double> realMatrix;        // Вещественные строки
+        Matrix::Matrix2D<Complex> spectrumMatrix;   // Спектр (ширина n / 2 + 1)
+    };
+
+}   // namespace Wavelet
+
+#endif // FFTENGINE_H
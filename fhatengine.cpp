@@ -0,0 +1,387 @@
+#include "fhatengine.h"
+
+#include <climits>
+
+#include "wavelet.h"
+#include "waveletsimd.h"
+#include "parallel.h"
+
+using namespace Wavelet;
+
+namespace {
+
+    // Объём префиксных сумм, используемых одной полосой строк результата (кеш второго уровня)
+    const int Band_Cache_Bytes = 256 * 1024;
+
+    // Минимальная высота полосы строк результата
+    const int Min_Band_Rows = 4;
+
+
+    // Получить наибольший модуль элементов матрицы данных.
+    // Для 8 и 16 бит он известен по типу, и матрица не просматривается.
+    qint64 getAbsMax(const Matrix::MatrixView<const int>& inMatrix)
+    {
+        qint64 absMax = 0;
+        for (int y = 0; y < inMatrix.getHeight(); ++y) {
+            const int* inRow = inMatrix.getRow(y);
+            for (int x = 0; x < inMatrix.getWidth(); ++x)
+                absMax = qMax(absMax, qAbs((qint64) inRow[x]));
+        }
+        return absMax;
+    }
+
+    inline qint64 getAbsMax(const Matrix::MatrixView<const quint16>&) { return 65535; }
+
+    inline qint64 getAbsMax(const Matrix::MatrixView<const quint8>&) { return 255; }
+
+}   // namespace
+
+
+FhatEngine::FhatEngine()
+    : outsideValue(0), inAbsMax(0), wAbsSum(0), minOffset(0), maxOffset(0)
+{
+}
+
+
+// Подготовить префиксные суммы строк матрицы данных
+void FhatEngine::setInput(const Matrix::MatrixView<const int>& inMatrix, int outside)
+{
+    setInputRows(inMatrix, outside);
+}
+
+
+void FhatEngine::setInput(const Matrix::MatrixView<const quint16>& inMatrix, int outside)
+{
+    setInputRows(inMatrix, outside);
+}
+
+
+void FhatEngine::setInput(const Matrix::MatrixView<const quint8>& inMatrix, int outside)
+{
+    setInputRows(inMatrix, outside);
+}
+
+
+// Подготовить префиксные суммы строк матрицы данных любого типа
+template <class T>
+void FhatEngine::setInputRows(const Matrix::MatrixView<const T>& inMatrix, int outside)
+{
+    Q_ASSERT (!inMatrix.isNull());
+    Q_ASSERT (!inMatrix.getSize().isEmpty());
+
+    inSize = inMatrix.getSize();
+    outsideValue = outside;
+
+    const int inWidth = inSize.width();
+    inAbsMax = qMax(qAbs((qint64) outside), getAbsMax(inMatrix));
+
+    // Префиксные суммы хранятся в 32 битах, если они точно помещаются в qint32
+    if (inAbsMax * inWidth <= INT_MAX) {
+        prefix.clear();
+        prefix32.resize(QSize(inWidth + 1, inSize.height()));
+        for (int y = 0; y < inSize.height(); ++y) {
+            const T* inRow = inMatrix.getRow(y);
+            qint32* row = prefix32.getRow(y);
+            qint32 sum = 0;
+            row[0] = 0;
+            for (int x = 0; x < inWidth; ++x) {
+                sum += inRow[x];
+                row[x + 1] = sum;
+            }
+        }
+        return;
+    }
+
+    prefix32.clear();
+    prefix.resize(QSize(inWidth + 1, inSize.height()));
+    for (int y = 0; y < inSize.height(); ++y) {
+        const T* inRow = inMatrix.getRow(y);
+        qint64* row = prefix.getRow(y);
+        qint64 sum = 0;
+        row[0] = 0;
+        for (int x = 0; x < inWidth; ++x) {
+            sum += inRow[x];
+            row[x + 1] = sum;
+        }
+    }
+}
+
+
+// Разбить строки матрицы вейвлета на участки с постоянным значением
+void FhatEngine::setWavelet(const Matrix::MatrixView<const int>& wMatrix)
+{
+    Q_ASSERT (!wMatrix.isNull());
+
+    wSize = wMatrix.getSize();
+    const int wWidth = wSize.width();
+    const int wHeight = wSize.height();
+    const int wXCenter = wWidth / 2;
+
+    taps.clear();
+    rowTaps.resize(wHeight + 1);
+    rowSums.resize(wHeight);
+    minOffset = 0;
+    maxOffset = 0;
+    wAbsSum = 0;
+
+    for (int wj = 0; wj < wHeight; ++wj) {
+        const int* wRow = wMatrix.getRow(wj);
+        rowTaps[wj] = taps.size();
+        qint64 sum = 0;
+        // Граница t находится между элементами t - 1 и t строки вейвлета
+        for (int t = 0; t <= wWidth; ++t) {
+            const qint64 before = (t > 0) ? wRow[t - 1] : 0;
+            const qint64 after = (t < wWidth) ? wRow[t] : 0;
+            if (before != after) {
+                Tap tap;
+                tap.offset = t - wXCenter;
+                tap.coef = before - after;
+                taps.append(tap);
+                minOffset = qMin(minOffset, tap.offset);
+                maxOffset = qMax(maxOffset, tap.offset);
+            }
+            sum += after;
+            wAbsSum += qAbs(after);
+        }
+        rowSums[wj] = sum;
+    }
+    rowTaps[wHeight] = taps.size();
+}
+
+
+// Вычислить свёртку для области матрицы данных
+void FhatEngine::impose(Matrix::Matrix2D<int>* outMatrix,
+                        const QPoint& topLeft,
+                        const QPoint& bottomRight)
+{
+    Q_ASSERT (outMatrix);
+
+    const QRect region(getImposeRegion(inSize, topLeft, bottomRight));
+    outMatrix->resize(region.size());
+    impose(outMatrix->view(), region);
+}
+
+
+// Вычислить свёртку для области region матрицы данных
+void FhatEngine::impose(const Matrix::MatrixView<int>& outMatrix, const QRect& region)
+{
+    Q_ASSERT (!prefix.isNull() || !prefix32.isNull());
+    Q_ASSERT (!wSize.isEmpty());
+    Q_ASSERT (!outMatrix.isNull());
+    Q_ASSERT (QRect(QPoint(0, 0), inSize).contains(region));
+    Q_ASSERT (outMatrix.getSize() == region.size());
+
+    imposeBands(outMatrix, region, NULL);
+}
+
+
+// Вычислить свёртку для области region и найти экстремумы результата
+void FhatEngine::impose(Matrix::ExtremumsAccumulator* extremums, const QRect& region,
+                        const Matrix::MatrixView<int>& outMatrix)
+{
+    Q_ASSERT (extremums);
+    Q_ASSERT (!prefix.isNull() || !prefix32.isNull());
+    Q_ASSERT (!wSize.isEmpty());
+    Q_ASSERT (QRect(QPoint(0, 0), inSize).contains(region));
+    Q_ASSERT (outMatrix.isNull() || outMatrix.getSize() == region.size());
+
+    imposeBands(outMatrix, region, extremums);
+}
+
+
+// Вычислить свёртку для области region по полосам строк
+void FhatEngine::imposeBands(const Matrix::MatrixView<int>& outMatrix, const QRect& region,
+                             Matrix::ExtremumsAccumulator* extremums)
+{
+    // Полосы строк результата вычисляются параллельно
+    const int rowBytes = (inSize.width() + 1) * (prefix32.isNull() ? sizeof(qint64) : sizeof(qint32));
+    const int maxRows = qMax(1, Band_Cache_Bytes / rowBytes - wSize.height());
+    const int chunk = Parallel::getChunkSize(region.height(), Min_Band_Rows, maxRows);
+
+    // Экстремумы каждой полосы находятся отдельно и объединяются после вычисления
+    QVector<Matrix::ExtremumsAccumulator> bandExtremums;
+    if (extremums)
+        bandExtremums.fill(Matrix::ExtremumsAccumulator(extremums->minVal, extremums->maxVal),
+                           (region.height() + chunk - 1) / chunk);
+    Matrix::ExtremumsAccumulator* parts = bandExtremums.data();
+
+    Parallel::forRange(region.top(), region.bottom() + 1, chunk, [&](int first, int last) {
+        const QRect band(QPoint(region.left(), first), QPoint(region.right(), last - 1));
+        imposeBand(outMatrix.isNull() ? outMatrix : outMatrix.region(band.translated(-region.topLeft())),
+                   band, region,
+                   extremums ? &parts[(first - region.top()) / chunk] : NULL);
+    });
+
+    for (int b = 0; b < bandExtremums.size(); ++b)
+        extremums->merge(bandExtremums.at(b));
+}
+
+
+// Вычислить свёртку для полосы строк band
+void FhatEngine::imposeBand(const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                            const QRect& region, Matrix::ExtremumsAccumulator* extremums) const
+{
+    if (!prefix32.isNull()) {
+        // Если сумма каждого элемента результата помещается в qint32,
+        // то строка накапливается в 32-битных целых (вдвое больше элементов
+        // в регистре SIMD), иначе префиксные суммы расширяются до 64 бит
+        if (wAbsSum * inAbsMax <= INT_MAX)
+            imposeBandNarrow(outMatrix, band, region, extremums);
+        else
+            imposeBandWide(prefix32, outMatrix, band, region, extremums);
+    }
+    else {
+        imposeBandWide(prefix, outMatrix, band, region, extremums);
+    }
+}
+
+
+// Вычислить полосу строк с 64-битным аккумулятором
+template <class P>
+void FhatEngine::imposeBandWide(const Matrix::Matrix2D<P>& prefixSums,
+                                const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                                const QRect& region, Matrix::ExtremumsAccumulator* extremums) const
+{
+    const int wHeight = wSize.height();
+    const int wYCenter = wHeight / 2;
+    const long long wCount = wSize.width() * wHeight;   // Кол-во элементов в матрице вейвлета
+
+    const int inWidth = inSize.width();
+    const int inHeight = inSize.height();
+
+    // Элементы, для которых все границы попадают внутрь строки префиксных сумм
+    // (0 <= i + offset <= inWidth), вычисляются без проверок
+    const int innerLeft = qMax(band.left(), -minOffset);
+    const int innerRight = qMin(band.right(), inWidth - maxOffset);
+
+    QVector<qint64> acc(band.width());    // Аккумулятор строки результата
+    qint64* accRow = acc.data();
+
+    // Строка результата, если матрица результата не сохраняется
+    QVector<int> rowBuffer(outMatrix.isNull() ? band.width() : 0);
+
+    for (int j = band.top(), oj = 0; j <= band.bottom(); ++j, ++oj) {
+        for (int oi = 0; oi < band.width(); ++oi)
+            accRow[oi] = 0;
+        // Вклад строк вейвлета, целиком лежащих за пределами матрицы данных
+        qint64 outsideSum = 0;
+
+        for (int wj = 0; wj < wHeight; ++wj) {
+            const int inY = j - wYCenter + wj;
+            if (inY < 0 || inY >= inHeight) {
+                outsideSum += rowSums.at(wj) * outsideValue;
+                continue;
+            }
+            const P* row = prefixSums.getRow(inY);
+
+            for (int k = rowTaps.at(wj); k < rowTaps.at(wj + 1); ++k) {
+                const int offset = taps.at(k).offset;
+                const qint64 coef = taps.at(k).coef;
+
+                int i = band.left();
+                for (; i < innerLeft && i <= band.right(); ++i)
+                    accRow[i - band.left()] += coef * extendedPrefix(row, i + offset);
+
+                const P* p = row + offset;
+                qint64* a = accRow - band.left();
+                for (; i <= innerRight; ++i)
+                    a[i] += coef * p[i];
+
+                for (; i <= band.right(); ++i)
+                    accRow[i - band.left()] += coef * extendedPrefix(row, i + offset);
+            }
+        }
+
+        int* outRow = outMatrix.isNull() ? rowBuffer.data() : outMatrix.getRow(oj);
+        for (int oi = 0; oi < band.width(); ++oi)
+            outRow[oi] = (accRow[oi] + outsideSum) / wCount;
+        if (extremums)
+            extremums->addRow(outRow, band.width(), 0, j - region.top());
+    }
+}
+
+
+// Вычислить полосу строк в 32-битных целых
+void FhatEngine::imposeBandNarrow(const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                                  const QRect& region, Matrix::ExtremumsAccumulator* extremums) const
+{
+    const int wHeight = wSize.height();
+    const int wYCenter = wHeight / 2;
+    const qint32 wCount = wSize.width() * wHeight;      // Кол-во элементов в матрице вейвлета
+
+    const int inWidth = inSize.width();
+    const int inHeight = inSize.height();
+
+    // Элементы, для которых все границы попадают внутрь строки префиксных сумм,
+    // вычисляются одним вызовом Wavelet::accumulateTaps по всем границам
+    const int innerLeft = qMax(band.left(), -minOffset);
+    const int innerRight = qMin(band.right(), inWidth - maxOffset);
+    const int innerCount = qMax(0, innerRight - innerLeft + 1);
+
+    // Суммы вычисляются по модулю 2^32 (суммы префиксов с коэффициентами
+    // могут переполняться), итоговая сумма точна, т.к. по модулю
+    // не превышает wAbsSum * inAbsMax <= INT_MAX
+    QVector<qint32> acc(band.width());    // Аккумулятор строки результата
+    quint32* accRow = reinterpret_cast<quint32*>(acc.data());
+    QVector<const int*> tapRows(taps.size());   // Префиксы границ для первого внутреннего элемента
+    QVector<qint32> tapCoefs(taps.size());
+
+    // Строка результата, если матрица результата не сохраняется
+    QVector<int> rowBuffer(outMatrix.isNull() ? band.width() : 0);
+
+    for (int j = band.top(), oj = 0; j <= band.bottom(); ++j, ++oj) {
+        for (int oi = 0; oi < band.width(); ++oi)
+            accRow[oi] = 0;
+        // Вклад строк вейвлета, целиком лежащих за пределами матрицы данных
+        quint32 outsideSum = 0;
+        int tapCount = 0;
+
+        for (int wj = 0; wj < wHeight; ++wj) {
+            const int inY = j - wYCenter + wj;
+            if (inY < 0 || inY >= inHeight) {
+                outsideSum += (quint32) (rowSums.at(wj) * outsideValue);
+                continue;
+            }
+            const qint32* row = prefix32.getRow(inY);
+
+            for (int k = rowTaps.at(wj); k < rowTaps.at(wj + 1); ++k) {
+                const int offset = taps.at(k).offset;
+                const quint32 coef = (quint32) taps.at(k).coef;
+
+                // Элементы у краёв матрицы вычисляются с проверками
+                int i = band.left();
+                for (; i < innerLeft && i <= band.right(); ++i)
+                    accRow[i - band.left()] += coef * (quint32) extendedPrefix(row, i + offset);
+                for (i = qMax(i, innerRight + 1); i <= band.right(); ++i)
+                    accRow[i - band.left()] += coef * (quint32) extendedPrefix(row, i + offset);
+
+                if (innerCount > 0) {
+                    tapRows[tapCount] = row + offset + innerLeft;
+                    tapCoefs[tapCount] = (qint32) coef;
+                    ++tapCount;
+                }
+            }
+        }
+
+        if (tapCount > 0)
+            accumulateTaps(acc.data() + innerLeft - band.left(), innerCount,
+                           tapRows.constData(), tapCoefs.constData(), tapCount);
+
+        int* outRow = outMatrix.isNull() ? rowBuffer.data() : outMatrix.getRow(oj);
+        for (int oi = 0; oi < band.width(); ++oi)
+            outRow[oi] = (qint32) (accRow[oi] + outsideSum) / wCount;
+        if (extremums)
+            extremums->addRow(outRow, band.width(), 0, j - region.top());
+    }
+}
+
+
+// Получить объём памяти, занятой вычислителем
+size_t FhatEngine::getBytes(void) const
+{
+    return prefix.getCapacityBytes() +
+            prefix32.getCapacityBytes() +
+            taps.size() * sizeof(Tap) +
+            rowTaps.size() * sizeof(int) +
+            rowSums.size() * sizeof(qint64);
+}
@@ -0,0 +1,136 @@
+#ifndef FHATENGINE_H
+#define FHATENGINE_H
+
+#include <QVector>
+#include <QRect>
+
+#include "matrix.h"
+#include "matrixutils.h"
+
+namespace Wavelet {
+
+    // Вычисление свёртки с матрицей вейвлета, каждая строка которой состоит
+    // из небольшого числа участков с постоянным значением
+    // (например, вейвлет FHAT: +1 внутри круга и -0.5 в кольце вокруг него).
+    // Сумма по участку строки вычисляется как разность префиксных сумм
+    // строки матрицы данных, поэтому свёртка стоит O(N * K * B), где
+    // N - кол-во элементов результата, K - высота вейвлета,
+    // B - кол-во границ участков в строке вейвлета (для FHAT - не более 4),
+    // вместо O(N * K * K) при прямом вычислении.
+    // Результат совпадает с Wavelet::imposeWavelet бит в бит: сумма
+    // вычисляется точно в целых числах и делится на кол-во элементов вейвлета.
+    // Если диапазон данных это позволяет (например, оттенки серого 0..255),
+    // то префиксные суммы хранятся и суммируются в 32-битных целых
+    // (вдвое меньше памяти и вдвое больше элементов в регистре SIMD,
+    // см. Wavelet::accumulateTaps), иначе - в 64-битных.
+    // За пределами матрицы данные продолжаются значением outsideValue. Для других
+    // способов (Matrix::BorderMode) матрицу данных следует дополнить на радиус
+    // вейвлета функцией Matrix::padMatrix и вычислять свёртку для области region.
+    //
+    // Пример использования:
+    // FhatEngine engine;
+    // engine.setInput(scaledMatrix, 255);      // один раз для матрицы данных
+    // engine.setWavelet(wMatrix);
+    // engine.impose(&outMatrix);
+    class FhatEngine {
+    public:
+        FhatEngine();
+
+        // Подготовить префиксные суммы строк матрицы данных inMatrix.
+        // outsideValue - значение, которое используется при вычислении свёртки,
+        // если вейвлет выходит за пределы матрицы входных данных.
+        // Матрица int просматривается для определения диапазона данных,
+        // для 8 и 16 бит диапазон определяется типом.
+        void setInput(const Matrix::MatrixView<const int>& inMatrix, int outsideValue = 0);
+        void setInput(const Matrix::MatrixView<const quint16>& inMatrix, int outsideValue = 0);
+        void setInput(const Matrix::MatrixView<const quint8>& inMatrix, int outsideValue = 0);
+
+        // Разбить строки матрицы вейвлета на участки с постоянным значением
+        void setWavelet(const Matrix::MatrixView<const int>& wMatrix);
+
+        // Вычислить свёртку для области матрицы данных, заданной topLeft и bottomRight
+        // (см. Wavelet::imposeWavelet). Результат поместить в outMatrix.
+        void impose(Matrix::Matrix2D<int>* outMatrix,
+                    const QPoint& topLeft = QPoint(-1, -1),
+                    const QPoint& bottomRight = QPoint(-1, -1));
+
+        // Вычислить свёртку для области region матрицы данных
+        // и записать результат в представление outMatrix размером region.
+        // Полосы строк результата вычисляются параллельно (см. Parallel::forRange).
+        void impose(const Matrix::MatrixView<int>& outMatrix, const QRect& region);
+
+        // Вычислить свёртку для области region матрицы данных и учесть её
+        // элементы в extremums (координаты - относительно region) без записи
+        // всей матрицы результата. Если задано представление outMatrix
+        // размером region, то результат также записывается в него (для отладки).
+        void impose(Matrix::ExtremumsAccumulator* extremums, const QRect& region,
+                    const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+
+        // Получить размер подготовленной матрицы данных
+        const QSize& getInputSize(void) const { return inSize; }
+
+        // Получить объём памяти, занятой вычислителем, в байтах
+        size_t getBytes(void) const;
+
+    private:
+        // Подготовить префиксные суммы строк матрицы данных любого типа
+        template <class T>
+        void setInputRows(const Matrix::MatrixView<const T>& inMatrix, int outside);
+
+        // Вычислить свёртку для области region по полосам строк
+        // (outMatrix и extremums могут быть не заданы)
+        void imposeBands(const Matrix::MatrixView<int>& outMatrix, const QRect& region,
+                         Matrix::ExtremumsAccumulator* extremums);
+
+        // Вычислить свёртку для полосы строк band области region (в одном потоке).
+        // Если outMatrix не задано, то строки результата не сохраняются.
+        void imposeBand(const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                        const QRect& region, Matrix::ExtremumsAccumulator* extremums) const;
+
+        // Вычислить полосу строк с 64-битным аккумулятором
+        // по префиксным суммам prefixSums (32- или 64-битным)
+        template <class P>
+        void imposeBandWide(const Matrix::Matrix2D<P>& prefixSums,
+                            const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                            const QRect& region, Matrix::ExtremumsAccumulator* extremums) const;
+
+        // Вычислить полосу строк в 32-битных целых по 32-битным префиксным суммам
+        // (итоговая сумма каждого элемента помещается в qint32)
+        void imposeBandNarrow(const Matrix::MatrixView<int>& outMatrix, const QRect& band,
+                              const QRect& region, Matrix::ExtremumsAccumulator* extremums) const;
+
+        // Граница участков строки вейвлета:
+        // в сумму строки входит coef * P(x + offset), где P - префиксная сумма
+        struct Tap {
+            int offset;         // Смещение относительно текущего элемента
+            qint64 coef;        // Разность значений вейвлета слева и справа от границы
+        };
+
+        // Получить префиксную сумму строки row, продолженную значением
+        // outsideValue за пределы матрицы (t - кол-во суммируемых элементов)
+        template <class P>
+        qint64 extendedPrefix(const P* row, int t) const {
+            if (t <= 0)
+                return (qint64) t * outsideValue;
+            if (t >= inSize.width())
+                return row[inSize.width()] + (qint64) (t - inSize.width()) * outsideValue;
+            return row[t];
+        }
+
+        Matrix::Matrix2D<qint64> prefix;    // Префиксные суммы строк (ширина + 1 элемент)
+        Matrix::Matrix2D<qint32> prefix32;  // То же в 32 бита (если суммы помещаются в qint32)
+        QSize inSize;                       // Размер матрицы данных
+        int outsideValue;
+        qint64 inAbsMax;                    // Наибольший модуль данных (и outsideValue)
+
+        QSize wSize;                        // Размер матрицы вейвлета
+        QVector<Tap> taps;                  // Границы участков всех строк вейвлета
+        QVector<int> rowTaps;               // Индекс первой границы строки (wSize.height() + 1 эл.)
+        QVector<qint64> rowSums;            // Суммы значений строк вейвлета
+        qint64 wAbsSum;                     // Сумма модулей значений вейвлета
+        int minOffset, maxOffset;           // Крайние смещения границ участков
+    };
+
+}   // namespace Wavelet
+
+#endif // FHATENGINE_H
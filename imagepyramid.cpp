@@ -0,0 +1,303 @@
+#include "imagepyramid.h"
+
+#include <QMutexLocker>
+#include <climits>
+#include <cstring>
+
+#include "matrixutils.h"
+#include "pixelsimd.h"
+#include "parallel.h"
+#include "trace.h"
+
+using namespace Matrix;
+
+namespace {
+
+    // Минимальный размер стороны октавы
+    const int Min_Level_Size = 16;
+
+    // Ограничение объёма кеша уменьшенных матриц по-умолчанию (в килобайтах)
+    const int Default_Cache_KBytes = 256 * 1024;
+
+    // Ключ кеша для размера size
+    inline quint64 sizeKey(const QSize& size) {
+        return ((quint64) (quint32) size.width() << 32) | (quint32) size.height();
+    }
+
+    // Мин. кол-во элементов исходного уровня в полосе построения
+    // (накладные расходы на полосу)
+    const int Min_Band_Elements = 64 * 1024;
+
+    // Макс. кол-во элементов исходного уровня в полосе построения
+    // (октавы полосы помещаются в кеш процессора)
+    const int Max_Band_Elements = 512 * 1024;
+
+
+    // Записать элементы строки в 8-битную строку уровня
+    // (значения int ограничиваются пределами 0..255)
+    inline void narrowRow(quint8* out, const int* in, int count) {
+        for (int x = 0; x < count; ++x)
+            out[x] = (quint8) qBound(0, in[x], 255);
+    }
+
+    inline void narrowRow(quint8* out, const quint8* in, int count) {
+        memcpy(out, in, count);
+    }
+
+
+    // Источник строк представления матрицы
+    template <class T>
+    class ViewSource : public ImagePyramid::RowSource {
+    public:
+        explicit ViewSource(const MatrixView<const T>& view) : view(view) {}
+        QSize getSize(void) const { return view.getSize(); }
+        void readRow(quint8* out, int y) const { narrowRow(out, view.getRow(y), view.getWidth()); }
+    private:
+        const MatrixView<const T>& view;
+    };
+
+
+    // Чтение строк октавы skipLevels по строкам исходной матрицы:
+    // для каждой пропускаемой октавы хранятся только две строки
+    class SkipReader {
+    public:
+        SkipReader(const ImagePyramid::RowSource& source, int skipLevels)
+            : source(source), skipLevels(skipLevels)
+        {
+            for (int level = 0; level < skipLevels; ++level) {
+                const int width = ImagePyramid::getLevelSize(source.getSize(), level).width();
+                widths.append(width);
+                rows.append(QVector<quint8>(2 * width));
+            }
+        }
+
+        // Записать в out строку y октавы skipLevels
+        void readRow(quint8* out, int y) { readLevelRow(out, skipLevels, y); }
+
+    private:
+        // Записать в out строку y октавы level
+        void readLevelRow(quint8* out, int level, int y)
+        {
+            if (level == 0) {
+                source.readRow(out, y);
+                return;
+            }
+            quint8* row0 = rows[level - 1].data();
+            quint8* row1 = row0 + widths.at(level - 1);
+            readLevelRow(row0, level - 1, 2 * y);
+            readLevelRow(row1, level - 1, 2 * y + 1);
+            ImageUtils::halveRows(out, row0, row1, widths.at(level - 1) / 2);
+        }
+
+        const ImagePyramid::RowSource& source;
+        const int skipLevels;
+        QVector<int> widths;            // Ширина пропускаемых октав
+        QVector<QVector<quint8> > rows; // Пары строк пропускаемых октав
+    };
+
+}   // namespace
+
+
+ImagePyramid::ImagePyramid() : cache(Default_Cache_KBytes)
+{
+}
+
+
+// Построить октавы матрицы
+void ImagePyramid::build(const MatrixView<const int>& image, int skipLevels)
+{
+    Q_ASSERT (!image.isNull());
+    build(ViewSource<int>(image), skipLevels);
+}
+
+
+// Построить октавы 8-битной матрицы
+void ImagePyramid::build(const MatrixView<const quint8>& image, int skipLevels)
+{
+    Q_ASSERT (!image.isNull());
+    Q_ASSERT (skipLevels >= 0);
+
+    // Исходный уровень - сама матрица (без копирования)
+    if (skipLevels == 0)
+        buildLevels(NULL, 0, MatrixView<const quint8>(image.getData(), image.getSize(), image.getStride()));
+    else
+        build(ViewSource<quint8>(image), skipLevels);
+}
+
+
+// Построить октавы матрицы, строки которой читаются из source
+void ImagePyramid::build(const RowSource& source, int skipLevels)
+{
+    buildLevels(&source, skipLevels, MatrixView<const quint8>());
+}
+
+
+// Построить октавы
+void ImagePyramid::buildLevels(const RowSource* source, int skipLevels,
+                               const MatrixView<const quint8>& base)
+{
+    Q_ASSERT (source || !base.isNull());
+    const QSize size(source ? source->getSize() : base.getSize());
+    Q_ASSERT (!size.isEmpty());
+    Q_ASSERT (skipLevels >= 0);
+    Q_ASSERT (skipLevels == 0 || qMin(getLevelSize(size, skipLevels).width(),
+                                      getLevelSize(size, skipLevels).height()) >= Min_Level_Size);
+
+    clear();
+    Trace::Span span(Trace::Stage_Pyramid);
+
+    // Октавы, начиная с исходного уровня
+    // (заполняемые здесь уровни записываются через представления filled)
+    QVector<MatrixView<quint8> > filled;
+    QSize levelSize(getLevelSize(size, skipLevels));
+    for (;;) {
+        Level level;
+        if (levels.isEmpty() && !source) {
+            level.view = base;
+            filled.append(MatrixView<quint8>());
+        }
+        else {
+            Matrix2D<quint8>* matrix = new Matrix2D<quint8>(levelSize);
+            level.matrix = QSharedPointer<const Matrix2D<quint8> >(matrix);
+            level.view = matrix->view();
+            filled.append(matrix->view());
+        }
+        levels.append(level);
+        if (qMin(levelSize.width(), levelSize.height()) / 2 < Min_Level_Size)
+            break;
+        levelSize = getLevelSize(levelSize, 1);
+    }
+
+    // Границы полос кратны 2^(кол-во октав - 1), поэтому строки каждой
+    // октавы полосы вычисляются только по строкам предыдущей октавы той же полосы
+    const int width = levels.first().view.getWidth();
+    const int height = levels.first().view.getHeight();
+    const int align = 1 << (levels.size() - 1);
+    const int minRows = qMax(1, Min_Band_Elements / width);
+    const int maxRows = qMax(minRows, Max_Band_Elements / width);
+    const int chunk = (Parallel::getChunkSize(height, minRows, maxRows) + align - 1) / align * align;
+
+    Parallel::forRange(0, height, chunk, [&](int first, int last) {
+        // Исходный уровень полосы
+        if (source) {
+            SkipReader reader(*source, skipLevels);
+            for (int y = first; y < last; ++y)
+                reader.readRow(filled.first().getRow(y), y);
+        }
+
+        // Октавы полосы
+        for (int level = 1; level < levels.size(); ++level) {
+            const MatrixView<const quint8>& prev = levels.at(level - 1).view;
+            const MatrixView<quint8>& curr = filled.at(level);
+            const int end = (last == height) ? curr.getHeight() : (last >> level);
+            for (int y = first >> level; y < end; ++y)
+                ImageUtils::halveRows(curr.getRow(y), prev.getRow(2 * y), prev.getRow(2 * y + 1),
+                                      curr.getWidth());
+        }
+    });
+}
+
+
+// Получить размер октавы матрицы
+QSize ImagePyramid::getLevelSize(const QSize& size, int level)
+{
+    Q_ASSERT (level >= 0);
+    return QSize(size.width() >> level, size.height() >> level);
+}
+
+
+// Получить кол-во пропускаемых октав матрицы
+int ImagePyramid::getSkipLevels(const QSize& size, qint64 maxElements)
+{
+    int skipLevels = 0;
+    QSize levelSize(size);
+    while ((qint64) levelSize.width() * levelSize.height() > maxElements &&
+           qMin(levelSize.width(), levelSize.height()) / 2 >= Min_Level_Size) {
+        levelSize = getLevelSize(levelSize, 1);
+        ++skipLevels;
+    }
+    return skipLevels;
+}
+
+
+// Очистить уровни и кеш
+void ImagePyramid::clear(void)
+{
+    QMutexLocker locker(&mutex);
+    cache.clear();
+    levels.clear();
+}
+
+
+// Получить размер исходной матрицы
+QSize ImagePyramid::getSize(void) const
+{
+    return levels.isEmpty() ? QSize() : levels.first().view.getSize();
+}
+
+
+// Получить матрицу, уменьшенную до размера size
+ImagePyramid::Level ImagePyramid::getScaled(const QSize& size) const
+{
+    Q_ASSERT (!levels.isEmpty());
+    Q_ASSERT (!size.isEmpty());
+    Q_ASSERT (size.width() <= getSize().width() && size.height() <= getSize().height());
+
+    // Ближайшая октава, не меньшая заданного размера
+    int index = 0;
+    while (index + 1 < levels.size() &&
+           levels.at(index + 1).view.getWidth() >= size.width() &&
+           levels.at(index + 1).view.getHeight() >= size.height())
+        ++index;
+    const Level& level = levels.at(index);
+    if (level.view.getSize() == size)
+        return level;
+
+    const quint64 key = sizeKey(size);
+    {
+        QMutexLocker locker(&mutex);
+        Level* cached = cache.object(key);
+        if (cached != NULL)
+            return *cached;
+    }
+
+    // Матрица вычисляется без блокировки: если её одновременно
+    // вычислили несколько потоков, то в кеше остаётся одна из копий
+    Matrix2D<quint8>* scaled = new Matrix2D<quint8>;
+    {
+        Trace::Span span(Trace::Stage_Scale);
+        scaleMatrix(scaled, level.view, size);
+    }
+    Level result;
+    result.matrix = QSharedPointer<const Matrix2D<quint8> >(scaled);
+    result.view = scaled->view();
+    const int cost = (int) qMax((size_t) 1, scaled->getCapacityBytes() / 1024);
+
+    QMutexLocker locker(&mutex);
+    Level* cached = cache.object(key);
+    if (cached != NULL)
+        return *cached;
+    cache.insert(key, new Level(result), cost);
+    return result;
+}
+
+
+// Ограничить объём памяти кеша уменьшенных матриц
+void ImagePyramid::setCacheLimit(size_t bytes)
+{
+    QMutexLocker locker(&mutex);
+    cache.setMaxCost((int) qMin(bytes / 1024, (size_t) INT_MAX));
+}
+
+
+// Получить объём памяти, занятой октавами и кешем
+size_t ImagePyramid::getBytes(void) const
+{
+    size_t bytes = 0;
+    for (int i = 0; i < levels.size(); ++i)
+        if (!levels.at(i).matrix.isNull())
+            bytes += levels.at(i).matrix->getCapacityBytes();
+
+    QMutexLocker locker(&mutex);
+    return bytes + (size_t) cache.totalCost() * 1024;
+}
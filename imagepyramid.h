@@ -0,0 +1,118 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <QVector>
+#include <QMutex>
+#include <QCache>
+#include <QSharedPointer>
+
+#include "matrix.h"
+
+namespace Matrix {
+
+    // Пирамида уменьшенных копий матрицы данных одного поиска.
+    // Уровни хранят 8-битные оттенки серого (усреднения и масштабирование
+    // значений 0..255 не выходят за эти пределы), поэтому вчетверо меньше
+    // памяти и пропускной способности памяти, чем матрицы int.
+    // Октавы (уровни, уменьшенные в 2, 4, 8... раз) строятся за один проход
+    // по исходной матрице: полосы строк обрабатываются параллельно,
+    // и каждая октава полосы вычисляется усреднением блоков 2x2 (см. halveRows)
+    // предыдущей октавы той же полосы, пока её строки ещё в кеше процессора.
+    // Первые октавы очень большой матрицы можно пропустить (skipLevels):
+    // тогда исходным уровнем пирамиды становится уменьшенная матрица,
+    // а строки пропущенных октав вычисляются по мере чтения исходной
+    // и не хранятся целиком.
+    // Матрица произвольного размера получается масштабированием
+    // (см. scaleMatrix) ближайшего уровня, не меньшего заданного размера,
+    // а не исходной матрицы, и кешируется по размеру, поэтому диаметры с одинаковым оптимальным
+    // размером матрицы (в том числе на разных итерациях) не масштабируют
+    // её повторно.
+    // Исходный уровень пирамиды 8-битной матрицы (без пропуска октав)
+    // не копируется: он ссылается на данные вызывающей стороны, которые
+    // должны оставаться неизменными до очистки пирамиды.
+    // Получение матриц (getScaled) потокобезопасно, построение (build)
+    // и очистка (clear) должны выполняться, пока матрицы не запрашиваются.
+    class ImagePyramid {
+    public:
+        // Уровень или уменьшенная матрица: представление данных и матрица,
+        // которой они принадлежат (пустой указатель - данные вызывающей
+        // стороны, см. build). Копия продлевает жизнь матрицы.
+        struct Level {
+            MatrixView<const quint8> view;
+            QSharedPointer<const Matrix2D<quint8> > matrix;
+        };
+
+        // Источник строк исходной матрицы (например, строк изображения)
+        class RowSource {
+        public:
+            virtual ~RowSource() {}
+
+            // Получить размер исходной матрицы
+            virtual QSize getSize(void) const = 0;
+
+            // Записать в out строку y (getSize().width() элементов).
+            // Вызывается из нескольких потоков одновременно.
+            virtual void readRow(quint8* out, int y) const = 0;
+        };
+
+        ImagePyramid();
+
+        // Построить октавы матрицы image, пропустив skipLevels первых
+        // (предыдущие уровни и кеш очищаются). Значения ограничиваются
+        // пределами 0..255 при чтении строк.
+        void build(const MatrixView<const int>& image, int skipLevels = 0);
+
+        // Построить октавы 8-битной матрицы image. Без пропуска октав
+        // исходным уровнем становится сама image (без копирования),
+        // поэтому её данные должны оставаться неизменными до очистки пирамиды
+        void build(const MatrixView<const quint8>& image, int skipLevels = 0);
+
+        // Построить октавы матрицы, строки которой читаются из source
+        void build(const RowSource& source, int skipLevels = 0);
+
+        // Очистить уровни и кеш
+        void clear(void);
+
+        // Получить размер исходного уровня
+        // (исходной матрицы, уменьшенной на пропущенные октавы)
+        QSize getSize(void) const;
+
+        // Получить матрицу, уменьшенную до размера size
+        // (не больше размера исходной матрицы)
+        Level getScaled(const QSize& size) const;
+
+        // Получить кол-во октав (включая исходный уровень)
+        int getLevelCount(void) const { return levels.size(); }
+
+        // Получить размер октавы level матрицы размером size
+        static QSize getLevelSize(const QSize& size, int level);
+
+        // Получить кол-во октав матрицы размером size, которые нужно пропустить,
+        // чтобы исходный уровень содержал не более maxElements элементов
+        static int getSkipLevels(const QSize& size, qint64 maxElements);
+
+        // Ограничить объём памяти кеша уменьшенных матриц (в байтах)
+        void setCacheLimit(size_t bytes);
+
+        // Получить объём памяти, занятой октавами и кешем, в байтах
+        // (без данных вызывающей стороны)
+        size_t getBytes(void) const;
+
+    private:
+        ImagePyramid(const ImagePyramid&);
+        ImagePyramid& operator= (const ImagePyramid&);
+
+        // Построить октавы: исходный уровень - base, если задан,
+        // иначе строки source с пропуском skipLevels октав
+        void buildLevels(const RowSource* source, int skipLevels,
+                         const MatrixView<const quint8>& base);
+
+        QVector<Level> levels;              // Октавы (levels[0] - исходный уровень)
+
+        mutable QMutex mutex;
+        mutable QCache<quint64, Level> cache;   // Уменьшенные матрицы по размеру
+    };
+
+}   // namespace Matrix
+
+#endif // IMAGEPYRAMID_H
@@ -1,59 +1,162 @@
 #include "imageutils.h"
 
+#include <cstring>
+
+#include "pixelsimd.h"
+#include "parallel.h"
+#include "trace.h"
+
 using namespace ImageUtils;
 
-// Преобразовать цветное изображение в изображение в оттенках серого
-void ImageUtils::colorToGray(QImage* out, const QImage& in)
+namespace {
+
+    // Мин. кол-во пикселов в части параллельного преобразования
+    // (накладные расходы на запуск части)
+    const int Min_Chunk_Pixels = 32 * 1024;
+
+    // Макс. кол-во пикселов в части параллельного преобразования
+    // (строки части помещаются в кеш процессора)
+    const int Max_Chunk_Pixels = 256 * 1024;
+
+    // Кол-во пикселов, преобразуемых за раз при чтении в 8-битную строку
+    const int Narrow_Block_Pixels = 512;
+
+
+    // Выполнить fun(first, last) параллельно для полос строк [0, height)
+    // изображения шириной width
+    template <class F>
+    void forRows(int width, int height, F fun)
+    {
+        const int minRows = qMax(1, Min_Chunk_Pixels / qMax(1, width));
+        const int maxRows = qMax(minRows, Max_Chunk_Pixels / qMax(1, width));
+        Parallel::forRange(0, height, Parallel::getChunkSize(height, minRows, maxRows), fun);
+    }
+
+
+    // Записать оттенки серого области rect изображения в представление matrix
+    template <class T>
+    void readRegion(const QImage& img, const QRect& rect, const Matrix::MatrixView<T>& matrix)
+    {
+        Q_ASSERT(!matrix.isNull());
+        Q_ASSERT(img.rect().contains(rect));
+        Q_ASSERT(matrix.getSize() == rect.size());
+
+        Trace::Span span(Trace::Stage_ImageToMatrix);
+
+        // Заполнить матрицу полосами строк
+        const ImageRowSource reader(img);
+        forRows(rect.width(), rect.height(), [&](int first, int last) {
+            for (int j = first; j < last; ++j)
+                reader.read(matrix.getRow(j), rect.left(), rect.top() + j, rect.width());
+        });
+    }
+
+}   // namespace
+
+
+// Определить способ чтения строк по формату изображения
+ImageRowSource::ImageRowSource(const QImage& img)
+    : img(img), kind(Kind_Other)
 {
-    Q_ASSERT (out);
-    Q_ASSERT (!in.isNull());
+    switch (img.format()) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
+    case QImage::Format_Grayscale8:
+        kind = Kind_Gray8;
+        break;
+#endif
+    case QImage::Format_Indexed8: {
+        kind = Kind_Indexed8;
+        // Индексы вне таблицы цветов дают 0, как и QImage::pixel
+        const QVector<QRgb> table(img.colorTable());
+        for (int i = 0; i < 256; ++i)
+            lut[i] = (i < table.size()) ? qGray(table.at(i)) : 0;
+        break;
+    }
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+        kind = Kind_Rgb32;
+        break;
+    case QImage::Format_RGB888:
+        kind = Kind_Rgb888;
+        break;
+    default:
+        // В том числе форматы с умноженной альфой:
+        // QImage::pixel возвращает цвет без умножения
+        break;
+    }
+}
 
-    *out = QImage(in.size(), QImage::Format_RGB32);
 
-    const int In_Width = in.width();
-    const int In_Height = in.height();
+// Записать оттенки серого пикселов строки
+void ImageRowSource::read(int* out, int x, int y, int count) const
+{
+    const uchar* line = img.constScanLine(y);
+    switch (kind) {
+    case Kind_Gray8:
+        for (int i = 0; i < count; ++i)
+            out[i] = line[x + i];
+        break;
+    case Kind_Indexed8:
+        for (int i = 0; i < count; ++i)
+            out[i] = lut[line[x + i]];
+        break;
+    case Kind_Rgb32:
+        rgb32ToGray(out, reinterpret_cast<const quint32*>(line) + x, count);
+        break;
+    case Kind_Rgb888:
+        rgb888ToGray(out, line + 3 * x, count);
+        break;
+    case Kind_Other:
+        for (int i = 0; i < count; ++i)
+            out[i] = qGray(img.pixel(x + i, y));
+        break;
+    }
+}
 
-    int gray = 0;       // текущее значение серого
-    for (int i = 0; i < In_Width; ++i)
-        for (int j = 0; j < In_Height; ++j) {
-            gray = qGray(in.pixel(i, j));
-            out->setPixel(i, j, qRgb(gray, gray, gray));
-        }
+
+// Записать 8-битные оттенки серого пикселов строки
+void ImageRowSource::read(quint8* out, int x, int y, int count) const
+{
+    if (kind == Kind_Gray8) {
+        memcpy(out, img.constScanLine(y) + x, count);
+        return;
+    }
+
+    // Остальные форматы - через строку int небольшими блоками
+    int block[Narrow_Block_Pixels];
+    for (int i = 0; i < count; i += Narrow_Block_Pixels) {
+        const int n = qMin(Narrow_Block_Pixels, count - i);
+        read(block, x + i, y, n);
+        for (int k = 0; k < n; ++k)
+            out[i + k] = (quint8) block[k];
+    }
 }
 
 
-// Уменьшать размер изображения в степенях двойки
-void ImageUtils::downSampleImage(QImage* out, const QImage& in, unsigned int value)
+// Преобразовать цветное изображение в изображение в оттенках серого
+void ImageUtils::colorToGray(QImage* out, const QImage& in)
 {
     Q_ASSERT (out);
     Q_ASSERT (!in.isNull());
-    Q_ASSERT (value <= 16);
-
-    int ratio = 1 << value; // Значение прореживания изображения
-
-    int newWidth = in.width() >> value;
-    int newHeight = in.height() >> value;
 
-    *out = QImage(newWidth, newHeight, in.format());
+    *out = QImage(in.size(), QImage::Format_RGB32);
 
-    for (int i = 0; i < newWidth; i++)
-        for (int j = 0; j < newHeight; j++) {
+    const int width = in.width();
+    const ImageRowSource reader(in);
 
-            int redSum = 0;
-            int greenSum = 0;
-            int blueSum = 0;
-            for (int ix = i * ratio; ix < ((i + 1) * ratio); ++ix)
-                for (int iy = j * ratio; iy < ((j + 1) * ratio); ++iy) {
-                    QRgb rgb = in.pixel(ix, iy);
-                    redSum += qRed(rgb);
-                    greenSum += qGreen(rgb);
-                    blueSum += qBlue(rgb);
-                }
+    // Получить указатель на данные до параллельной записи строк
+    // (scanLine отсоединяет разделяемые данные изображения)
+    uchar* outBits = out->bits();
+    const int outBytesPerLine = out->bytesPerLine();
 
-            out->setPixel( i, j, qRgb(redSum / (ratio * ratio),
-                                         greenSum  / (ratio * ratio),
-                                         blueSum  / (ratio * ratio)) );
+    forRows(width, in.height(), [&](int first, int last) {
+        QVector<int> gray(width);    // Оттенки серого строки
+        for (int y = first; y < last; ++y) {
+            reader.read(gray.data(), 0, y, width);
+            grayToRgb32(reinterpret_cast<quint32*>(outBits + y * outBytesPerLine),
+                        gray.constData(), width);
         }
+    });
 }
 
 
@@ -66,13 +169,31 @@ void ImageUtils::imageToMatrix(const QImage& img, Matrix::Matrix2D<int>* matrix)
         return;
     // Преобразовать входное изображение в матрицу оттенков серого
     matrix->resize(img.size());
-    int** data = matrix->getData();
-    const int Img_Width = img.width();
-    const int Img_Height = img.height();
-    // Заполнить матрицу
-    for (int i = 0; i < Img_Width; ++i)
-        for (int j = 0; j < Img_Height; ++j)
-            data[i][j] = qGray(img.pixel(i, j));
+    imageToMatrix(img, img.rect(), matrix->view());
+}
+
+
+void ImageUtils::imageToMatrix(const QImage& img, Matrix::Matrix2D<quint8>* matrix)
+{
+    Q_ASSERT(matrix);
+
+    if (img.size().isEmpty())
+        return;
+    matrix->resize(img.size());
+    imageToMatrix(img, img.rect(), matrix->view());
+}
+
+
+// Записать оттенки серого области изображения в представление матрицы
+void ImageUtils::imageToMatrix(const QImage& img, const QRect& rect, const Matrix::MatrixView<int>& matrix)
+{
+    readRegion(img, rect, matrix);
+}
+
+
+void ImageUtils::imageToMatrix(const QImage& img, const QRect& rect, const Matrix::MatrixView<quint8>& matrix)
+{
+    readRegion(img, rect, matrix);
 }
 
 // Получить изображение по матрице
@@ -80,10 +201,16 @@ void ImageUtils::matrixToImage(QImage* img, const Matrix::Matrix2D<int>& matrix)
 {
     Q_ASSERT(img);
     *img = QImage(matrix.getSize(), QImage::Format_RGB32);
-    for (int i = 0; i < matrix.getWidth(); ++i)
-        for (int j = 0; j < matrix.getHeight(); ++j) {
-            int gray = (matrix.getData())[i][j];
-            img->setPixel(i, j, qRgb(gray, gray, gray));
-        }
-}
+    if (img->isNull())
+        return;
+
+    // Получить указатель на данные до параллельной записи строк
+    uchar* bits = img->bits();
+    const int bytesPerLine = img->bytesPerLine();
 
+    forRows(matrix.getWidth(), matrix.getHeight(), [&](int first, int last) {
+        for (int j = first; j < last; ++j)
+            grayToRgb32(reinterpret_cast<quint32*>(bits + j * bytesPerLine),
+                        matrix.getRow(j), matrix.getWidth());
+    });
+}
@@ -3,6 +3,7 @@
 
 #include <QImage>
 #include "matrix.h"
+#include "imagepyramid.h"
 
 // Утилиты для работы с изображением
 namespace ImageUtils {
@@ -11,14 +12,61 @@ namespace ImageUtils {
     // Процедура сама задаёт размер выходного изображения out.
     void colorToGray(QImage* out, const QImage& in);
 
-    // Уменьшать размер изображения в степенях двойки
-    void downSampleImage(QImage* out, const QImage& in, unsigned int value);
-
     // Получить матрицу оттенков серого изображения
     void imageToMatrix(const QImage& img, Matrix::Matrix2D<int>* matrix);
 
+    // Получить матрицу оттенков серого изображения в 8 битах
+    // (вчетверо меньше памяти, чем матрица int; поиск шарика и
+    // Wavelet::FhatEngine принимают её без преобразования)
+    void imageToMatrix(const QImage& img, Matrix::Matrix2D<quint8>* matrix);
+
+    // Записать оттенки серого области rect изображения в представление matrix.
+    // Размер matrix должен совпадать с размером rect,
+    // а rect - лежать внутри изображения.
+    void imageToMatrix(const QImage& img, const QRect& rect, const Matrix::MatrixView<int>& matrix);
+    void imageToMatrix(const QImage& img, const QRect& rect, const Matrix::MatrixView<quint8>& matrix);
+
     // Получить изображение по матрице
     void matrixToImage(QImage* img, const Matrix::Matrix2D<int>& matrix);
+
+
+    /*!
+     * \brief The ImageRowSource класс чтения строк оттенков серого изображения.
+     * Способ чтения выбирается один раз по формату изображения:
+     * распространённые форматы читаются напрямую из строк изображения
+     * (constScanLine), остальные - через QImage::pixel.
+     * Результат для всех форматов совпадает с qGray(img.pixel(x, y)).
+     * Строки можно читать из нескольких потоков одновременно, поэтому
+     * объект можно передать в Matrix::ImagePyramid::build или CircleSearch::start:
+     * тогда уменьшенные копии строятся прямо по строкам изображения,
+     * без промежуточной матрицы исходного размера.
+     * Изображение должно существовать, пока используется объект.
+     */
+    class ImageRowSource : public Matrix::ImagePyramid::RowSource
+    {
+    public:
+        explicit ImageRowSource(const QImage& img);
+
+        QSize getSize(void) const { return img.size(); }
+        void readRow(quint8* out, int y) const { read(out, 0, y, img.width()); }
+
+        // Записать в out оттенки серого count пикселов строки y, начиная с x
+        void read(int* out, int x, int y, int count) const;
+        void read(quint8* out, int x, int y, int count) const;
+
+    private:
+        enum Kind {
+            Kind_Gray8,     // 8 бит оттенка серого
+            Kind_Indexed8,  // 8 бит индекса в таблице цветов
+            Kind_Rgb32,     // 0xAARRGGBB (альфа-канал не учитывается)
+            Kind_Rgb888,    // 3 байта R, G, B
+            Kind_Other      // Прочие форматы (через QImage::pixel)
+        };
+
+        const QImage& img;
+        Kind kind;
+        int lut[256];       // Оттенки серого таблицы цветов (для Kind_Indexed8)
+    };
 }
 
 
@@ -0,0 +1,97 @@
+#include "kernelcache.h"
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <cstring>
+
+using namespace Wavelet;
+
+namespace {
+
+    // Ограничение объёма кеша по-умолчанию (в байтах)
+    const size_t Default_Limit_Bytes = 64 * 1024 * 1024;
+
+    // Ключ кеша матриц
+    struct KernelKey {
+        int waveletId;
+        unsigned int size;
+        quint32 ratioBits;      // Двоичное представление ratio
+        bool operator== (const KernelKey& right) const {
+            return waveletId == right.waveletId && size == right.size && ratioBits == right.ratioBits;
+        }
+    };
+
+    inline uint qHash(const KernelKey& key, uint seed = 0) {
+        return ::qHash(key.ratioBits, seed) ^ (key.waveletId * 31 + key.size);
+    }
+
+    KernelKey getKey(int waveletId, unsigned int size, float ratio) {
+        KernelKey key;
+        key.waveletId = waveletId;
+        key.size = size;
+        memcpy(&key.ratioBits, &ratio, sizeof(quint32));
+        return key;
+    }
+
+    QReadWriteLock kernelLock;
+    QHash<KernelKey, KernelCache::KernelPointer> kernels;
+    size_t kernelBytes = 0;
+    size_t limitBytes = Default_Limit_Bytes;
+
+}   // namespace
+
+
+// Найти матрицу в кеше
+KernelCache::KernelPointer KernelCache::find(int waveletId, unsigned int size, float ratio)
+{
+    QReadLocker locker(&kernelLock);
+    return kernels.value(getKey(waveletId, size, ratio));
+}
+
+
+// Сохранить матрицу в кеше
+KernelCache::KernelPointer KernelCache::insert(int waveletId, unsigned int size, float ratio,
+                                               const KernelPointer& kernel)
+{
+    Q_ASSERT (!kernel.isNull());
+
+    const KernelKey key(getKey(waveletId, size, ratio));
+
+    QWriteLocker locker(&kernelLock);
+    KernelPointer stored(kernels.value(key));
+    if (!stored.isNull())
+        return stored;
+    const size_t bytes = kernel->getCapacityBytes();
+    if (kernelBytes + bytes <= limitBytes) {
+        kernels.insert(key, kernel);
+        kernelBytes += bytes;
+    }
+    return kernel;
+}
+
+
+// Ограничить объём памяти кеша
+void KernelCache::setLimit(size_t bytes)
+{
+    QWriteLocker locker(&kernelLock);
+    limitBytes = bytes;
+}
+
+
+// Получить объём памяти, занятой матрицами кеша
+size_t KernelCache::getBytes(void)
+{
+    QReadLocker locker(&kernelLock);
+    return kernelBytes;
+}
+
+
+// Очистить кеш
+void KernelCache::clear(void)
+{
+    QWriteLocker locker(&kernelLock);
+    kernels.clear();
+    kernelBytes = 0;
+}
@@ -0,0 +1,67 @@
+#ifndef KERNELCACHE_H
+#define KERNELCACHE_H
+
+#include <QSharedPointer>
+
+#include "matrix.h"
+#include "wavelet.h"
+#include "trace.h"
+
+namespace Wavelet {
+
+    // Кеш матриц вейвлетов для всего процесса.
+    // Матрица определяется вейвлетом (функтором F, см. Fhat2d),
+    // размером size и масштабом ratio (см. getWavelet2dMatrix)
+    // и после построения не изменяется, поэтому разделяется между потоками.
+    // Поиск в кеше выполняется под блокировкой на чтение, поэтому
+    // одновременные запросы уже построенных матриц не ожидают друг друга.
+    // Если объём кеша превышает ограничение, то новые матрицы
+    // строятся, но не сохраняются.
+    namespace KernelCache {
+
+        typedef QSharedPointer<const Matrix::Matrix2D<int> > KernelPointer;
+
+        // Найти матрицу в кеше (если её нет - вернуть пустой указатель)
+        KernelPointer find(int waveletId, unsigned int size, float ratio);
+
+        // Сохранить матрицу в кеше. Если матрица уже сохранена
+        // другим потоком, то возвращается сохранённая.
+        KernelPointer insert(int waveletId, unsigned int size, float ratio,
+                             const KernelPointer& kernel);
+
+        // Получить матрицу вейвлета F размером size и масштабом ratio
+        template <class F>
+        KernelPointer get(unsigned int size, float ratio) {
+            KernelPointer kernel(find(F::Id, size, ratio));
+            if (!kernel.isNull())
+                return kernel;
+            Matrix::Matrix2D<int>* matrix = new Matrix::Matrix2D<int>;
+            {
+                Trace::Span span(Trace::Stage_Kernel);
+                getWavelet2dMatrix<int>(matrix, F(), size, ratio);
+            }
+            return insert(F::Id, size, ratio, KernelPointer(matrix));
+        }
+
+        // Заранее построить матрицы вейвлета F размером от minSize до maxSize
+        // (включительно) и масштабом ratio
+        template <class F>
+        void prewarm(unsigned int minSize, unsigned int maxSize, float ratio) {
+            for (unsigned int size = minSize; size <= maxSize; ++size)
+                get<F>(size, ratio);
+        }
+
+        // Ограничить объём памяти кеша (в байтах)
+        void setLimit(size_t bytes);
+
+        // Получить объём памяти, занятой матрицами кеша, в байтах
+        size_t getBytes(void);
+
+        // Очистить кеш
+        void clear(void);
+
+    }   // namespace KernelCache
+
+}   // namespace Wavelet
+
+#endif // KERNELCACHE_H
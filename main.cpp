@@ -1,9 +1,17 @@
 #include "mainwindow.h"
+#include "tuning.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Профиль производительности машины (см. ImageWaveletBatch --calibrate)
+    // загружается до первого поиска
+    Tuning::Profile profile;
+    if (Tuning::load(Tuning::getDefaultPath(), &profile))
+        Tuning::setProfile(profile);
+
     MainWindow w;
     w.show();
 
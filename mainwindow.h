@@ -3,11 +3,11 @@
 
 #include <QMainWindow>
 #include <QProgressDialog>
-#include <cmath>
 #include <QFutureWatcher>
 
 #include "imageviewer.h"
 #include "matrix.h"
+#include "circlesearch.h"
 
 /*!
  * \brief The MainWindow класс окна приложения для поиска в изображении
@@ -27,7 +27,9 @@
  * модифицированным для двухмероного анализа изображения.
  *
  * \note Длина и ширина изображения могут быть неравными друг другу.
- * \note Рекомендуется выбирать не слишком большой размер изображения (не более 2 МПкс)
+ * \note Рекомендуется выбирать не слишком большой размер изображения (не более 2 МПкс).
+ * Очень большие изображения обрабатываются по плиткам без окна
+ * (Detector::detectTiled, ImageWaveletBatch --tile).
  */
 class MainWindow : public QMainWindow
 {
@@ -66,46 +68,6 @@ private slots:
 
 private:
 
-    // Кол-во интервалов для поиска диаметра на каждом шаге итерации
-    static const int Search_Diameter_Intervals = 5;
-
-    // Кол-во итераций поиска
-    static const int Search_Iterations = 5;
-
-    // Критерий оптимальной производительности при поиске оптимального
-    // размера матрицы данных и матрицы вейвлета.
-    // Для каждой конкретной вычислительной машины может быть индивидуален.
-    // Чем больше коэффициент - тем точнее вычисления, но скорость вычислений падает.
-    static const int Optimum_Performance_Criteria = 64;
-
-    /*!
-     * \brief The Extremums struct - структура с информацией об экстремумах,
-     * если diameter = -1.0, значит экстремум не инициализирован
-     */
-    struct Extremums {
-        float diameter;         // Относительный диаметр (от 0 до 1.0)
-        QPointF maxPoint;       // Относительная точка максимума (от 0 до 1.0)
-        int maxVal;             // Значение максимума
-        QPointF minPoint;       // Относительная точка минимума (от 0 до 1.0)
-        int minVal;             // Значение минимума
-        Extremums() : diameter(-1.0)  {}
-        Extremums(float d) : diameter(d)  {}
-    };
-
-
-    /*!
-     * \brief The HandleWrapper структура для запуска асинхронного вычисления
-     * экстремумов
-     */
-    struct HandleWrapper {
-        MainWindow *instance;
-        HandleWrapper(MainWindow *w): instance(w) {}
-        void operator()(MainWindow::Extremums& ex) {
-            instance->handleExtremums(ex);
-        }
-    };
-
-
     /*!
      * \brief createMenus - создать меню для текущего окна
      */
@@ -122,94 +84,26 @@ private:
 
 
     /*!
-     * \brief computeExtremums - вычилисть экстремумы для матрицы matrix и диаметра diameter
-     * \param matrix - матрица значений, для которой выполняется поиск
-     * \param diameter - диаметр структуры, для которой будут вычисляться экстремы
-     * \return экстремумы. Если возвращает экстремум с diameter = -1.0, то данный
-     * экстремум не был определён.
-     */
-    Extremums computeExtremums(const Matrix::Matrix2D<int>& matrix, float diameter) const;
-
-
-    /*!
-     * \brief getOptimumSizes - получить оптимальный размер вейвлета и размер матрицы данных
-     * \param matrixSize - размер матрицы данных
-     * \param diameter - диаметр шарика, для которого требуется найти оптимальные
-     * размеры матрицы данных и матрицы вейвлета
-     * \return пара значений - размер матрицы вейвлета и размер матрицы данных.
-     */
-    QPair<int, QSize> getOptimumSizes(QSize matrixSize, float diameter) const;
-
-
-    /*!
-     * \brief findIndexMaximum - Найти среди списка экстремумов максимальный, и вернуть его индекс.
-     * \param vect - Список экстремумов.
-     * \return индекс, если экстремум найден, -1 - если не найден.
-     */
-    int findIndexMaximum(const QVector<Extremums>& vect) const {
-        // Найти максимумальный экстремум
-        int maxIndex = -1;
-        int maxValue = 0;
-        for (int i = 0; i < vect.size(); ++i)
-            if (vect.at(i).maxVal > maxValue) {
-                maxValue = vect.at(i).maxVal;
-                maxIndex = i;
-            }
-        return maxIndex;
-    }
-
-
-    /*!
-     * \brief getMinDiameter - получить минимальный относительный диаметр шарика
-     * для заданного размера изображения (матрицы)
-     * \param size - размер изображения (или матрицы) для которой будет
-     * вычислен минмиальный относительный диаметр шарика
-     * \return значение минимального относительного диаметра шарика.
-     */
-    float getMinDiameter(const QSize& size) const {
-        // Минимальный диаметр шарика определяется относительно минимальной стороны изображения
-
-        const float Min_Diameter_Pixels = 16.0;     // Минимальный диаметр в пикселах
-
-        return Min_Diameter_Pixels / qMin(size.width(), size.height());
-    }
-
-
-    /*!
-     * \brief getMaxDiameter - получить максимальный относительный диаметр
-     * шарика (относительно минимальной стороны изображения)
-     * \return
+     * \brief finishSearch - вывести результат завершённого поиска на экран
      */
-    float getMaxDiameter(void) const {
-        // Для вейвлета "Французская шляпа" оптимизированного по двумерные вычисления
-        static const float val = 1.0 / sqrt(3.0);
-        return val;
-    }
+    void finishSearch(void);
 
-    /*!
-     * \brief handleExtremums - процедура обработки матрицы изображения
-     * и вычисления экстремумов.
-     * Данная процедура используется для асинхронного вычисления.
-     * \param ex - экстремум, из которого берётся значение диаметра для поиска
-     * и в него кладутся вычисленные данные.
-     */
-    void handleExtremums(MainWindow::Extremums& ex) {
-        ex = computeExtremums(imageMatrix, ex.diameter);
-    }
 
     ImageViewer *viewer;        // Просмоторщик изображений
     QProgressDialog *progressDialog;        // Диалоговое окно прогресса
 
     QString filePath;           // Путь к обрабатываемому и просматриваемому файлу
-    Matrix::Matrix2D<int> imageMatrix;      // Матрица значений исходного изображения
+    Matrix::Matrix2D<quint8> imageMatrix;   // Матрица оттенков серого исходного изображения
 
-    // Список экстремумов, которые асинхронно обрабатываются
-    QVector<MainWindow::Extremums> extrems;
+    // Поиск шарика в imageMatrix (матрица не копируется
+    // и не должна изменяться, пока поиск активен)
+    CircleSearch search;
 
     // Наблюдатель за завершением асинхронных вычислений
     QFutureWatcher<void> watcher;
-    bool isSearching;       // Активен ли процесс асинхронного поиска
-    int searchIter;         // Счётчик итераций поиска
+
+    // Построение матриц вейвлета в фоне (ожидается при закрытии окна)
+    QFuture<void> prewarm;
 };
 
 #endif // MAINWINDOW_H
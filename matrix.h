@@ -2,22 +2,115 @@
 #define MATRIX_H
 
 #include <QSize>
+#include <QPoint>
+#include <QRect>
+#include <QtGlobal>
+#include <cstring>
+#include <cstddef>
 
 namespace Matrix {
 
-    // Класс 2-х мерной матрицы
+    // Представление прямоугольной области 2-х мерной матрицы (без владения памятью).
+    // Представление может ссылаться как на Matrix2D, так и на сторонний буфер.
+    // Элемент с координатами (x, y) - это getRow(y)[x].
+    // origin - положение элемента (0, 0) представления в системе координат
+    // исходной матрицы (используется для пересчёта координат результатов).
+    // Для представления только на чтение используется MatrixView<const T>.
+    template <class T>
+    class MatrixView {
+
+        T* data;                // Указатель на элемент (0, 0) представления
+        QSize size;
+        int stride;             // Кол-во элементов между началами соседних строк
+        QPoint origin;
+    public:
+        MatrixView() : data(NULL), stride(0) {
+        }
+
+        MatrixView(T* d, const QSize& sz, int strd, const QPoint& orig = QPoint()) :
+            data(d), size(sz), stride(strd), origin(orig) {
+            Q_ASSERT(data != NULL || sz.isEmpty());
+            Q_ASSERT(stride >= sz.width());
+        }
+
+        // Преобразование представления на запись в представление только на чтение
+        template <class U>
+        MatrixView(const MatrixView<U>& right) :
+            data(right.getData()), size(right.getSize()),
+            stride(right.getStride()), origin(right.getOrigin()) {
+        }
+
+        bool isNull(void) const { return data == NULL; }
+
+        // Получить размер
+        const QSize& getSize(void) const { return size; }
+
+        // Получить кол-во столбцов (ширину)
+        int getWidth(void) const { return size.width(); }
+
+        // Получить кол-во строк (высоту)
+        int getHeight(void) const { return size.height(); }
+
+        // Получить шаг строк в элементах
+        int getStride(void) const { return stride; }
+
+        // Получить положение представления в исходной матрице
+        const QPoint& getOrigin(void) const { return origin; }
+
+        // Получить указатель на элемент (0, 0)
+        T* getData(void) const { return data; }
+
+        // Получить указатель на начало строки y
+        T* getRow(int y) const {
+            Q_ASSERT(y >= 0 && y < getHeight());
+            return data + (ptrdiff_t) y * stride;
+        }
+
+        // Получить представление области rect (в координатах текущего представления).
+        // Область должна целиком лежать внутри текущего представления.
+        MatrixView region(const QRect& rect) const {
+            Q_ASSERT(QRect(QPoint(0, 0), size).contains(rect));
+            return MatrixView(data + (ptrdiff_t) rect.top() * stride + rect.left(),
+                              rect.size(), stride, origin + rect.topLeft());
+        }
+    };
+
+
+    // Класс 2-х мерной матрицы.
+    // Данные хранятся построчно в одном непрерывном блоке памяти,
+    // выровненном по границе Alignment байт. Каждая строка также начинается
+    // с выровненного адреса, поэтому между строками может быть неиспользуемый
+    // хвост: адрес строки y = getData() + y * getStride().
+    // Элемент с координатами (x, y) - это getRow(y)[x].
+    // Тип T должен быть простым (POD) типом: конструкторы элементов не вызываются.
     template <class T>
     class Matrix2D {
 
-        T** data;
+        T* data;
         QSize size;
+        int stride;             // Кол-во элементов между началами соседних строк
+        size_t capacity;        // Кол-во элементов, под которое выделена память
     public:
-        Matrix2D() : data(NULL) {
+        // Выравнивание буфера и строк матрицы в байтах
+        static const int Alignment = 64;
+
+        Matrix2D() : data(NULL), stride(0), capacity(0) {
+        }
+
+        Matrix2D(const QSize& sz) : data(NULL), stride(0), capacity(0) {
+            resize(sz);
         }
 
-        Matrix2D(const QSize& sz) : size(sz) {
-            Q_ASSERT(size.width() > 0 && size.height() > 0);
-            allocate(size);         // Выделить память
+        Matrix2D(const Matrix2D& right) : data(NULL), stride(0), capacity(0) {
+            *this = right;
+        }
+
+        Matrix2D(Matrix2D&& right) : data(right.data), size(right.size),
+            stride(right.stride), capacity(right.capacity) {
+            right.data = NULL;
+            right.size = QSize();
+            right.stride = 0;
+            right.capacity = 0;
         }
 
         ~Matrix2D() { clear(); }
@@ -25,62 +118,132 @@ namespace Matrix {
         bool isNull(void) const { return data == NULL; }
 
         // Изменить размер матрицы.
-        // Старые данные будут утеряны
+        // Старые данные будут утеряны.
+        // Если ранее выделенной памяти достаточно для нового размера,
+        // то память не перевыделяется.
         void resize(const QSize& sz) {
             Q_ASSERT(sz.width() > 0 && sz.height() > 0);
-            clear();            // Очистить текущую матрицу
-            size = sz;          // Присвоить новый размер
-            allocate(size);     // Выделить память под новый размер
+            const int newStride = alignedStride(sz.width());
+            const size_t required = (size_t) newStride * sz.height();
+            if (data == NULL || required > capacity) {
+                deallocate();
+                allocate(required);
+            }
+            size = sz;
+            stride = newStride;
         }
 
-        // Очистить матрицу
+        // Очистить матрицу и освободить память
         void clear(void) {
-            if (data != NULL && size.width() > 0 && size.height() > 0)
-                deallocate(size);   // Освободить память
+            deallocate();
             size = QSize();
+            stride = 0;
         }
 
-        const Matrix2D& operator= (const Matrix2D& right) {
+        Matrix2D& operator= (const Matrix2D& right) {
             if (this == &right)
                 return *this;
+            if (right.isNull()) {
+                clear();
+                return *this;
+            }
             resize(right.getSize());
-            const T** rightData = const_cast<const T**>(right.getData());
-            for (int i = 0; i < getWidth(); ++i)
-                for (int j = 0; j < getHeight(); ++j)
-                    data[i][j] = rightData[i][j];
+            for (int y = 0; y < getHeight(); ++y)
+                memcpy(getRow(y), right.getRow(y), sizeof(T) * getWidth());
+
+            return *this;
+        }
 
+        Matrix2D& operator= (Matrix2D&& right) {
+            if (this == &right)
+                return *this;
+            deallocate();
+            data = right.data;
+            size = right.size;
+            stride = right.stride;
+            capacity = right.capacity;
+            right.data = NULL;
+            right.size = QSize();
+            right.stride = 0;
+            right.capacity = 0;
             return *this;
         }
 
         // Получить рамер
         const QSize& getSize(void) const { return size; }
 
-        // Получить кол-во строк матрицы
+        // Получить кол-во столбцов матрицы (ширину)
         int getWidth(void) const { return size.width(); }
 
-        // Получить кол-во столбцов матрицы
+        // Получить кол-во строк матрицы (высоту)
         int getHeight(void) const { return size.height(); }
 
+        // Получить шаг строк матрицы в элементах
+        int getStride(void) const { return stride; }
+
+        // Получить объём выделенной под матрицу памяти в байтах
+        size_t getCapacityBytes(void) const { return capacity * sizeof(T); }
+
         // Получить указатель на данные матрицы (следует проверить на null)
-        T** getData(void) const { return data; }
+        T* getData(void) { return data; }
+        const T* getData(void) const { return data; }
+
+        // Получить указатель на начало строки y
+        T* getRow(int y) {
+            Q_ASSERT(y >= 0 && y < getHeight());
+            return data + (size_t) y * stride;
+        }
+        const T* getRow(int y) const {
+            Q_ASSERT(y >= 0 && y < getHeight());
+            return data + (size_t) y * stride;
+        }
+
+        // Получить представление всей матрицы
+        MatrixView<T> view(void) {
+            return MatrixView<T>(data, size, stride);
+        }
+        MatrixView<const T> view(void) const {
+            return MatrixView<const T>(data, size, stride);
+        }
+
+        // Получить представление области rect матрицы
+        MatrixView<T> view(const QRect& rect) {
+            return view().region(rect);
+        }
+        MatrixView<const T> view(const QRect& rect) const {
+            return view().region(rect);
+        }
+
+        // Матрица может передаваться везде, где ожидается представление на чтение
+        operator MatrixView<const T>() const { return view(); }
 
     private:
-        // Выделить память под data
-        void allocate(const QSize& sz) {
-            Q_ASSERT(sz.width() > 0 && sz.height() > 0);
-            data = new T*[sz.width()];   // Строки
-            for (int i = 0; i < sz.width(); ++i)
-                data[i] = new T[sz.height()];  // Столбцы
+        // Получить шаг строки (в элементах) для заданной ширины,
+        // при котором каждая строка начинается с выровненного адреса
+        static int alignedStride(int width) {
+            const size_t bytes = sizeof(T) * width;
+            const size_t alignedBytes = (bytes + Alignment - 1) / Alignment * Alignment;
+            // Если выравнивание не кратно размеру элемента,
+            // то выравниваются только начало буфера
+            if (alignedBytes % sizeof(T) != 0)
+                return width;
+            return (int) (alignedBytes / sizeof(T));
+        }
+
+        // Выделить память под count элементов
+        void allocate(size_t count) {
+            Q_ASSERT(count > 0);
+            data = static_cast<T*>(qMallocAligned(sizeof(T) * count, Alignment));
+            Q_CHECK_PTR(data);
+            capacity = count;
         }
 
         // Освободить память под data
-        void deallocate(const QSize& sz) {
-            Q_ASSERT(data);
-            Q_ASSERT(sz.width() > 0 && sz.height() > 0);
-            for (int i = 0; i < sz.width(); ++i)
-                delete [] data[i];
-            delete [] data;
+        void deallocate(void) {
+            if (data != NULL)
+                qFreeAligned(data);
             data = NULL;
+            capacity = 0;
         }
     };
 
@@ -2,79 +2,560 @@
 
 #include <QRectF>
 #include <QRect>
+#include <QVector>
+#include <cmath>
+#include <climits>
+#include <cstring>
+
+#include "waveletsimd.h"
 
 using namespace Matrix;
 
-// Изменить размер матрицы in на outSize с преобразованием информации, имеющейся в ней
-void Matrix::scaleMatrix(Matrix::Matrix2D<int>* out, const Matrix::Matrix2D<int>& in, const QSize& outSize)
-{
-    // Выходная матрица должна существовать в памяти
-    Q_ASSERT (out);
-    // Входная матрица должна быть определена
-    Q_ASSERT (!in.isNull());
-    // Размер входной матрицы должен быть ненулевым
-    Q_ASSERT (!in.getSize().isEmpty());
-    // Выходные размеры должны быть ненулевыми
-    Q_ASSERT (!outSize.isEmpty());
-    // Размер входной матрицы должен быть равен или больше выходной
-    Q_ASSERT (in.getWidth() >= outSize.width() && in.getHeight() >= outSize.height());
-
-    // Инициализировать размер выходной матрицы
-    *out = Matrix2D<int>(outSize);
-    int** outData = out->getData();
-
-
-    // Обратный коэффициент масштабирования
-    double scaleX = ((double) in.getWidth()) / outSize.width();
-    double scaleY = ((double) in.getHeight()) / outSize.height();
-
-    // По всем элементам выходной матрицы
-    for (int i = 0; i < outSize.width(); ++i)
-        for (int j = 0; j < outSize.height(); ++j) {
-            // Найти координаты границ данного элемента
-            // в системе координат исходной матрицы
-            QRectF outElement;
-            outElement.setLeft(((qreal) i) * scaleX);
-            outElement.setRight(((qreal) (i + 1)) * scaleX);
-            outElement.setTop(((qreal) j) * scaleY);
-            outElement.setBottom(((qreal) (j + 1)) * scaleY);
-
-            // Совокупность элементов входной матрицы,
-            // которые попадают в элемент выходной
-            QRect inElements;
-            inElements.setLeft((int) outElement.left());
-            inElements.setRight((int) outElement.right());
-            inElements.setTop((int) outElement.top());
-            inElements.setBottom((int) outElement.bottom());
-
-            // Ограничить совокупность элементов размерами матрицы
-            inElements = inElements.intersected(QRect(0, 0, in.getWidth(), in.getHeight()));
-
-            // Аккумулятор значений элементов входной матрицы
-            long long sum = 0;
-
-            // Для всех элементов входной матрицы, которые попадают
-            // в границы элемента новой матрицы
-            for (int x = inElements.left(); x <= inElements.right(); ++x)
-                for (int y = inElements.top(); y <= inElements.bottom(); ++y) {
-                    // Область, которая занимает текущий элемент входной матрицы
-                    QRectF inElementRect(x, y, 1.0, 1.0);
-
-                    // Найти область пересечения области элемента входной матрицы
-                    // и области элемента выходной матрицы
-                    QRectF intersectRect(outElement.intersected(inElementRect));
-
-                    // Посчитать площадь области пересечения
-                    double s = intersectRect.width() * intersectRect.height();
-
-                    // Найти и прибавить к аккумулятору значение,
-                    // которое вкладывает элемент входной матрицы в элемент выходной
-                    sum += s * in.getData()[x][y];
+namespace {
+
+    // Площади пересечения элементов масштабирования по одной оси,
+    // вычисленные так же, как в scaleMatrixReference (в числах double,
+    // в том же порядке действий, что и QRectF::intersected), чтобы вклады
+    // элементов округлялись одинаково.
+    // Выходной элемент i пересекается с входными first[i] + k, k < taps,
+    // по weights[i * taps + k] (целиком покрытый входной элемент - ровно 1.0).
+    // Целиком покрытые элементы идут подряд: [fullBegin[i], fullEnd[i]),
+    // частично покрытые - только по краям этого отрезка.
+    struct AxisWeights {
+        int taps;                   // Кол-во весов на выходной элемент
+        QVector<int> first;         // Первый входной элемент для каждого выходного
+        QVector<int> fullBegin;     // Первый целиком покрытый входной элемент
+        QVector<int> fullEnd;       // Элемент после последнего целиком покрытого
+        QVector<double> weights;    // Веса
+    };
+
+
+    // Получить веса масштабирования оси размером inSize до размера outSize
+    void getAxisWeights(AxisWeights* table, int inSize, int outSize)
+    {
+        Q_ASSERT (table);
+        Q_ASSERT (outSize > 0 && inSize >= outSize);
+
+        const double scale = ((double) inSize) / outSize;
+        const int taps = qMin(inSize, (int) ceil(scale) + 1);
+        table->taps = taps;
+        table->first.resize(outSize);
+        table->fullBegin.resize(outSize);
+        table->fullEnd.resize(outSize);
+        table->weights.resize(outSize * taps);
+
+        for (int i = 0; i < outSize; ++i) {
+            // Границы выходного элемента (правая - как QRectF::right(): left + width)
+            const double lo = ((double) i) * scale;
+            const double hi = lo + (((double) (i + 1)) * scale - lo);
+            // Окно весов сдвигается влево у края, чтобы не выходить за пределы оси
+            const int first = qMin((int) lo, inSize - taps);
+            table->first[i] = first;
+
+            double* w = table->weights.data() + i * taps;
+            int fullBegin = first + taps, fullEnd = first + taps;
+            for (int k = 0; k < taps; ++k) {
+                const int x = first + k;
+                w[k] = (x >= (int) lo && x <= (int) hi && x + 1.0 > lo && hi > x)
+                        ? qMin(hi, x + 1.0) - qMax(lo, (double) x) : 0.0;
+                if (w[k] == 1.0) {
+                    Q_ASSERT (fullEnd == first + taps || fullEnd == x);
+                    if (fullEnd == first + taps)
+                        fullBegin = x;
+                    fullEnd = x + 1;
+                }
+            }
+            table->fullBegin[i] = fullBegin;
+            table->fullEnd[i] = fullEnd;
+        }
+    }
+
+
+    // Наибольшая сумма вкладов при масштабировании. При меньших суммах
+    // погрешность сложения в числах double меньше 2^-21, поэтому вклад
+    // с дробной частью меньше Max_Fraction (не близкий к целому снизу)
+    // увеличивает сумму с отброшенной дробной частью ровно на свою целую
+    // часть независимо от порядка сложения.
+    const qint64 Max_Scale_Sum = Q_INT64_C(1) << 32;
+    const double Max_Fraction = 1.0 - 1.0 / (1 << 20);
+
+    // Прибавить к сумме sum вклад term и отбросить дробную часть результата
+    // в числах double (как в scaleMatrixReference)
+    inline qint64 addTruncated(qint64 sum, double term)
+    {
+        return (qint64) ((double) sum + term);
+    }
+
+
+    // Проверить, что значения строки лежат в пределах от 0 до maxVal
+    template <class T>
+    bool isRowInRange(const T* row, int count, int maxVal)
+    {
+        int maxRow = 0, minRow = 0;
+        for (int x = 0; x < count; ++x) {
+            maxRow = qMax(maxRow, (int) row[x]);
+            minRow = qMin(minRow, (int) row[x]);
+        }
+        return maxRow <= maxVal && minRow >= 0;
+    }
+
+
+    template <class T>
+    void scaleMatrixViewReference(const MatrixView<T>& out, const MatrixView<const T>& in);
+
+    // Изменить размер матрицы in до размера представления out
+    template <class T>
+    void scaleMatrixView(const MatrixView<T>& out, const MatrixView<const T>& in)
+    {
+        Q_ASSERT (!out.isNull());
+        Q_ASSERT (!in.isNull());
+        Q_ASSERT (!in.getSize().isEmpty());
+        Q_ASSERT (!out.getSize().isEmpty());
+        Q_ASSERT (in.getWidth() >= out.getWidth() && in.getHeight() >= out.getHeight());
+
+        const int inWidth = in.getWidth();
+
+        AxisWeights xWeights, yWeights;
+        getAxisWeights(&xWeights, inWidth, out.getWidth());
+        getAxisWeights(&yWeights, in.getHeight(), out.getHeight());
+
+        // Площадь выходного элемента (вычисляется как в scaleMatrixReference)
+        const double scaleX = ((double) inWidth) / out.getWidth();
+        const double scaleY = ((double) in.getHeight()) / out.getHeight();
+        const double outArea = scaleX * scaleY;
+
+        // Максимальное значение, при котором сумма строк по вертикали помещается
+        // в qint32, а сумма вкладов - в Max_Scale_Sum
+        const int maxVal = (int) qMin((qint64) INT_MAX / yWeights.taps,
+                                      Max_Scale_Sum / ((qint64) xWeights.taps * yWeights.taps));
+
+        // Сумма по вертикали для каждого столбца in: целиком покрытые строки
+        // и целые части вкладов частично покрытых строк
+        QVector<qint32> column(inWidth);
+        // Есть ли в столбце вклады, близкие к целому снизу
+        QVector<quint8> nearColumn(inWidth);
+        QVector<const T*> tapRows(yWeights.taps);   // Строки in, пересекающиеся с выходной
+        QVector<const T*> fullRows(yWeights.taps);  // Целиком покрытые строки in
+        QVector<int> headTaps(yWeights.taps);       // Частично покрытые строки до целиком покрытых
+        QVector<int> tailTaps(yWeights.taps);       // и после них
+        QVector<int> activeTaps(yWeights.taps);     // Все строки с ненулевым весом
+        const QVector<qint32> ones(yWeights.taps, 1);
+        int checkedRows = 0;                        // Кол-во проверенных строк in
+
+        for (int j = 0; j < out.getHeight(); ++j) {
+            const int firstY = yWeights.first.at(j);
+            const double* wy = yWeights.weights.constData() + j * yWeights.taps;
+
+            // Строки проверяются непосредственно перед первым использованием
+            for (; checkedRows < firstY + yWeights.taps; ++checkedRows)
+                if (!isRowInRange(in.getRow(checkedRows), inWidth, maxVal)) {
+                    scaleMatrixViewReference(out, in);
+                    return;
+                }
+
+            // Целиком покрытые строки идут подряд, частично покрытые - по краям
+            int fullCount = 0, headCount = 0, tailCount = 0, activeCount = 0;
+            for (int k = 0; k < yWeights.taps; ++k) {
+                tapRows[k] = in.getRow(firstY + k);
+                if (wy[k] > 0.0)
+                    activeTaps[activeCount++] = k;
+                if (wy[k] == 1.0)
+                    fullRows[fullCount++] = tapRows[k];
+                else if (wy[k] > 0.0 && fullCount == 0)
+                    headTaps[headCount++] = k;
+                else if (wy[k] > 0.0)
+                    tailTaps[tailCount++] = k;
+            }
+
+            // Сумма по вертикали (целиком покрытые строки - векторными инструкциями)
+            qint32* col = column.data();
+            quint8* nearCol = nearColumn.data();
+            Wavelet::accumulateTaps(col, inWidth, fullRows.constData(), ones.constData(), fullCount);
+            memset(nearCol, 0, inWidth);
+            for (int p = 0; p < headCount + tailCount; ++p) {
+                const int k = (p < headCount) ? headTaps[p] : tailTaps[p - headCount];
+                const double wk = wy[k];
+                const T* row = tapRows[k];
+                for (int x = 0; x < inWidth; ++x) {
+                    const double term = wk * row[x];
+                    const qint32 whole = (qint32) term;
+                    col[x] += whole;
+                    nearCol[x] |= (term - whole >= Max_Fraction);
                 }
+            }
+
+            // Сумма по горизонтали, делённая на площадь элемента результата.
+            // Целиком покрытые столбцы идут подряд и суммируются одним циклом
+            // без ветвлений (сумма целых частей не зависит от порядка сложения).
+            // Цикл остаётся скалярным: отрезки короче вектора при малых масштабах,
+            // и каждый столбец column читается в нём один раз на строку результата,
+            // а сумма по вертикали читает для него все строки in.
+            // Вклады частично покрытых столбцов (не более двух на элемент
+            // результата) вычисляются по элементам для каждой строки: дробная
+            // часть каждого вклада отбрасывается отдельно, как в scaleMatrixReference,
+            // поэтому их нельзя сложить по вертикали заранее.
+            T* outRow = out.getRow(j);
+            for (int i = 0; i < out.getWidth(); ++i) {
+                const int firstX = xWeights.first.at(i);
+                const int fullBegin = xWeights.fullBegin.at(i);
+                const int fullEnd = xWeights.fullEnd.at(i);
+                const double* wx = xWeights.weights.constData() + i * xWeights.taps;
+                qint64 sum = 0;
+                int nearCount = 0;
+                for (int x = fullBegin; x < fullEnd; ++x) {
+                    sum += col[x];
+                    nearCount += nearCol[x];
+                }
+                bool near = nearCount != 0;
+                for (int k = 0; k < xWeights.taps; ++k) {
+                    const int x = firstX + k;
+                    if (x == fullBegin) {
+                        // Пропустить целиком покрытые столбцы
+                        k = fullEnd - firstX - 1;
+                        continue;
+                    }
+                    const double wk = wx[k];
+                    if (wk <= 0.0)
+                        continue;
+                    for (int a = 0; a < activeCount; ++a) {
+                        const int t = activeTaps[a];
+                        const double term = (wk * wy[t]) * tapRows[t][x];
+                        const qint64 whole = (qint64) term;
+                        sum += whole;
+                        near |= (term - whole >= Max_Fraction);
+                    }
+                }
+
+                // Вклады, близкие к целому снизу, могут округляться при сложении,
+                // поэтому сумма вычисляется в том же порядке, что и
+                // в scaleMatrixReference (по столбцам, в столбце - по строкам)
+                if (near) {
+                    sum = 0;
+                    for (int k = 0; k < xWeights.taps; ++k) {
+                        const double wk = wx[k];
+                        const int x = firstX + k;
+                        if (wk == 1.0) {
+                            for (int h = 0; h < headCount; ++h)
+                                sum = addTruncated(sum, wy[headTaps[h]] * tapRows[headTaps[h]][x]);
+                            for (int f = 0; f < fullCount; ++f)
+                                sum += fullRows[f][x];
+                            for (int t = 0; t < tailCount; ++t)
+                                sum = addTruncated(sum, wy[tailTaps[t]] * tapRows[tailTaps[t]][x]);
+                        }
+                        else if (wk > 0.0) {
+                            for (int t = 0; t < yWeights.taps; ++t)
+                                sum = addTruncated(sum, (wk * wy[t]) * tapRows[t][x]);
+                        }
+                    }
+                }
+                outRow[i] = (T) (((double) sum) / outArea);
+            }
+        }
+    }
+
+
+    // Изменить размер матрицы in на outSize с преобразованием информации, имеющейся в ней
+    template <class T>
+    void scaleMatrixTo(Matrix2D<T>* out, const MatrixView<const T>& in, const QSize& outSize)
+    {
+        // Выходная матрица должна существовать в памяти
+        Q_ASSERT (out);
+        // Выходные размеры должны быть ненулевыми
+        Q_ASSERT (!outSize.isEmpty());
+
+        // Инициализировать размер выходной матрицы
+        out->resize(outSize);
+
+        scaleMatrixView(out->view(), in);
+    }
+
+
+    // Изменить размер матрицы in до размера представления out (эталонная реализация)
+    template <class T>
+    void scaleMatrixViewReference(const MatrixView<T>& out, const MatrixView<const T>& in)
+    {
+        // Выходная матрица должна быть определена
+        Q_ASSERT (!out.isNull());
+        // Входная матрица должна быть определена
+        Q_ASSERT (!in.isNull());
+        // Размер входной матрицы должен быть ненулевым
+        Q_ASSERT (!in.getSize().isEmpty());
+
+        const QSize outSize(out.getSize());
+        // Выходные размеры должны быть ненулевыми
+        Q_ASSERT (!outSize.isEmpty());
+        // Размер входной матрицы должен быть равен или больше выходной
+        Q_ASSERT (in.getWidth() >= outSize.width() && in.getHeight() >= outSize.height());
+
+
+        // Обратный коэффициент масштабирования
+        double scaleX = ((double) in.getWidth()) / outSize.width();
+        double scaleY = ((double) in.getHeight()) / outSize.height();
+
+        // По всем элементам выходной матрицы
+        for (int j = 0; j < outSize.height(); ++j) {
+            T* outRow = out.getRow(j);         // Строка выходной матрицы
+            for (int i = 0; i < outSize.width(); ++i) {
+                // Найти координаты границ данного элемента
+                // в системе координат исходной матрицы
+                QRectF outElement;
+                outElement.setLeft(((qreal) i) * scaleX);
+                outElement.setRight(((qreal) (i + 1)) * scaleX);
+                outElement.setTop(((qreal) j) * scaleY);
+                outElement.setBottom(((qreal) (j + 1)) * scaleY);
+
+                // Совокупность элементов входной матрицы,
+                // которые попадают в элемент выходной
+                QRect inElements;
+                inElements.setLeft((int) outElement.left());
+                inElements.setRight((int) outElement.right());
+                inElements.setTop((int) outElement.top());
+                inElements.setBottom((int) outElement.bottom());
+
+                // Ограничить совокупность элементов размерами матрицы
+                inElements = inElements.intersected(QRect(0, 0, in.getWidth(), in.getHeight()));
+
+                // Аккумулятор значений элементов входной матрицы
+                long long sum = 0;
+
+                // Для всех элементов входной матрицы, которые попадают
+                // в границы элемента новой матрицы
+                // (порядок обхода сохраняется: аккумулятор целочисленный,
+                // и результат зависит от порядка суммирования)
+                for (int x = inElements.left(); x <= inElements.right(); ++x)
+                    for (int y = inElements.top(); y <= inElements.bottom(); ++y) {
+                        // Область, которая занимает текущий элемент входной матрицы
+                        QRectF inElementRect(x, y, 1.0, 1.0);
+
+                        // Найти область пересечения области элемента входной матрицы
+                        // и области элемента выходной матрицы
+                        QRectF intersectRect(outElement.intersected(inElementRect));
+
+                        // Посчитать площадь области пересечения
+                        double s = intersectRect.width() * intersectRect.height();
+
+                        // Найти и прибавить к аккумулятору значение,
+                        // которое вкладывает элемент входной матрицы в элемент выходной
+                        sum += s * in.getRow(y)[x];
+                    }
+
+                // Найти среднее для элемента выходной матрицы
+                Q_ASSERT (i >= 0 && i < out.getWidth());
+                Q_ASSERT (j >= 0 && j < out.getHeight());
+                outRow[i] = (T) ( ((double) sum) / (scaleX * scaleY) );
+            }
+        }
+    }
+
+}   // namespace
+
+
+void Matrix::scaleMatrix(Matrix2D<int>* out, const MatrixView<const int>& in, const QSize& outSize)
+{
+    scaleMatrixTo(out, in, outSize);
+}
+
+
+void Matrix::scaleMatrix(Matrix2D<quint16>* out, const MatrixView<const quint16>& in, const QSize& outSize)
+{
+    scaleMatrixTo(out, in, outSize);
+}
+
+
+void Matrix::scaleMatrix(Matrix2D<quint8>* out, const MatrixView<const quint8>& in, const QSize& outSize)
+{
+    scaleMatrixTo(out, in, outSize);
+}
+
+
+void Matrix::scaleMatrix(const MatrixView<int>& out, const MatrixView<const int>& in)
+{
+    scaleMatrixView(out, in);
+}
+
+
+void Matrix::scaleMatrix(const MatrixView<quint16>& out, const MatrixView<const quint16>& in)
+{
+    scaleMatrixView(out, in);
+}
+
+
+void Matrix::scaleMatrix(const MatrixView<quint8>& out, const MatrixView<const quint8>& in)
+{
+    scaleMatrixView(out, in);
+}
+
+
+void Matrix::scaleMatrixReference(const MatrixView<int>& out, const MatrixView<const int>& in)
+{
+    scaleMatrixViewReference(out, in);
+}
+
+
+void Matrix::scaleMatrixReference(const MatrixView<quint16>& out, const MatrixView<const quint16>& in)
+{
+    scaleMatrixViewReference(out, in);
+}
+
+
+void Matrix::scaleMatrixReference(const MatrixView<quint8>& out, const MatrixView<const quint8>& in)
+{
+    scaleMatrixViewReference(out, in);
+}
 
-            // Найти среднее для элемента выходной матрицы
-            Q_ASSERT (i >= 0 && i < out->getWidth());
-            Q_ASSERT (j >= 0 && j < out->getHeight());
-            outData[i][j] = (int) ( ((double) sum) / (scaleX * scaleY) );
+
+
+
+// Найти минимальный и максимальный элементы матрицы
+void Matrix::findExtremums(const Matrix::MatrixView<const int>& matrix,
+                           int* minVal, QPoint* minPoint,
+                           int* maxVal, QPoint* maxPoint)
+{
+    Q_ASSERT (!matrix.isNull());
+    Q_ASSERT (minVal && minPoint);
+    Q_ASSERT (maxVal && maxPoint);
+
+    ExtremumsAccumulator acc(*minVal, *maxVal);
+    acc.minPoint = *minPoint;
+    acc.maxPoint = *maxPoint;
+
+    for (int j = 0; j < matrix.getHeight(); ++j)
+        acc.addRow(matrix.getRow(j), matrix.getWidth(), 0, j);
+
+    *minVal = acc.minVal;
+    *minPoint = acc.minPoint;
+    *maxVal = acc.maxVal;
+    *maxPoint = acc.maxPoint;
+}
+
+
+// Учесть строку матрицы
+void Matrix::ExtremumsAccumulator::addRow(const int* row, int width, int x, int y)
+{
+    Q_ASSERT (row || width == 0);
+
+    int curMin = minVal, curMax = maxVal;
+    int curMinX = minPoint.x(), curMaxX = maxPoint.x();
+    bool newMin = false, newMax = false;
+
+    // Строки обходятся сверху вниз, поэтому при равных значениях
+    // предпочтение отдаётся точке с меньшим X (а при равном X - с меньшим Y)
+    for (int i = 0; i < width; ++i) {
+        const int val = row[i];
+        if (val > curMax || ((maxFound || newMax) && val == curMax && x + i < curMaxX)) {
+            curMax = val;
+            curMaxX = x + i;
+            newMax = true;
         }
+        if (val < curMin || ((minFound || newMin) && val == curMin && x + i < curMinX)) {
+            curMin = val;
+            curMinX = x + i;
+            newMin = true;
+        }
+    }
+
+    if (newMax) {
+        maxVal = curMax;
+        maxPoint = QPoint(curMaxX, y);
+        maxFound = true;
+    }
+    if (newMin) {
+        minVal = curMin;
+        minPoint = QPoint(curMinX, y);
+        minFound = true;
+    }
+}
+
+
+// Объединить с результатом другой части матрицы
+void Matrix::ExtremumsAccumulator::merge(const ExtremumsAccumulator& right)
+{
+    // При равных значениях - точка с меньшим X, а при равном X - с меньшим Y
+    if (right.maxFound &&
+            (right.maxVal > maxVal ||
+             (maxFound && right.maxVal == maxVal &&
+              (right.maxPoint.x() < maxPoint.x() ||
+               (right.maxPoint.x() == maxPoint.x() && right.maxPoint.y() < maxPoint.y()))))) {
+        maxVal = right.maxVal;
+        maxPoint = right.maxPoint;
+        maxFound = true;
+    }
+    if (right.minFound &&
+            (right.minVal < minVal ||
+             (minFound && right.minVal == minVal &&
+              (right.minPoint.x() < minPoint.x() ||
+               (right.minPoint.x() == minPoint.x() && right.minPoint.y() < minPoint.y()))))) {
+        minVal = right.minVal;
+        minPoint = right.minPoint;
+        minFound = true;
+    }
+}
+
+
+namespace {
+
+    // Получить дополненную матрицу out (см. Matrix::padMatrix)
+    template <class T>
+    void padMatrixTo(Matrix2D<T>* out, const MatrixView<const T>& in,
+                     const QRect& rect, BorderMode mode, int value)
+    {
+        Q_ASSERT (out);
+        Q_ASSERT (!in.isNull());
+        Q_ASSERT (rect.isValid());
+        Q_ASSERT (value == (int) (T) value);
+
+        out->resize(rect.size());
+
+        const int inWidth = in.getWidth();
+        const int inHeight = in.getHeight();
+
+        // Столбцы, которые копируются из строки in целиком
+        const int copyLeft = qMax(rect.left(), 0);
+        const int copyRight = qMin(rect.right(), inWidth - 1);
+
+        for (int y = 0; y < out->getHeight(); ++y) {
+            T* outRow = out->getRow(y);
+            const int inY = getBorderIndex(rect.top() + y, inHeight, mode);
+            if (inY < 0) {
+                for (int x = 0; x < out->getWidth(); ++x)
+                    outRow[x] = (T) value;
+                continue;
+            }
+
+            const T* inRow = in.getRow(inY);
+            for (int x = rect.left(); x < copyLeft && x <= rect.right(); ++x) {
+                const int inX = getBorderIndex(x, inWidth, mode);
+                outRow[x - rect.left()] = (inX < 0) ? (T) value : inRow[inX];
+            }
+            if (copyLeft <= copyRight)
+                memcpy(outRow + copyLeft - rect.left(), inRow + copyLeft,
+                       sizeof(T) * (copyRight - copyLeft + 1));
+            for (int x = qMax(copyRight + 1, rect.left()); x <= rect.right(); ++x) {
+                const int inX = getBorderIndex(x, inWidth, mode);
+                outRow[x - rect.left()] = (inX < 0) ? (T) value : inRow[inX];
+            }
+        }
+    }
+
+}   // namespace
+
+
+void Matrix::padMatrix(Matrix2D<int>* out, const MatrixView<const int>& in,
+                       const QRect& rect, BorderMode mode, int value)
+{
+    padMatrixTo(out, in, rect, mode, value);
+}
+
+
+void Matrix::padMatrix(Matrix2D<quint16>* out, const MatrixView<const quint16>& in,
+                       const QRect& rect, BorderMode mode, int value)
+{
+    padMatrixTo(out, in, rect, mode, value);
+}
+
+
+void Matrix::padMatrix(Matrix2D<quint8>* out, const MatrixView<const quint8>& in,
+                       const QRect& rect, BorderMode mode, int value)
+{
+    padMatrixTo(out, in, rect, mode, value);
 }
@@ -5,8 +5,114 @@
 
 namespace Matrix {
 
-    // Изменить размер матрицы с преобразованием информации, имеющейся в исходной матрице
-    void scaleMatrix(Matrix2D<int>* out, const Matrix2D<int>& in, const QSize& outSize);
+    // Способ продолжения матрицы за её пределы
+    enum BorderMode {
+        Border_Constant = 0,    // Заданное значение (... v v | a b c d | v v ...)
+        Border_Replicate,       // Повторение крайнего элемента (... a a | a b c d | d d ...)
+        Border_Mirror           // Зеркальное отражение (... b a | a b c d | d c ...)
+    };
+
+
+    // Получить индекс элемента матрицы размером size (по одной оси),
+    // соответствующий индексу i за пределами матрицы.
+    // Для Border_Constant за пределами матрицы возвращается -1.
+    inline int getBorderIndex(int i, int size, BorderMode mode) {
+        Q_ASSERT(size > 0);
+        if (i >= 0 && i < size)
+            return i;
+        switch (mode) {
+        case Border_Replicate:
+            return (i < 0) ? 0 : size - 1;
+        case Border_Mirror: {
+            // Период отражённой последовательности - 2 * size
+            const int period = 2 * size;
+            i %= period;
+            if (i < 0)
+                i += period;
+            return (i < size) ? i : period - 1 - i;
+        }
+        default:
+            return -1;
+        }
+    }
+
+
+    // Получить матрицу out, соответствующую области rect матрицы in
+    // (в координатах in), продолженной за свои пределы способом mode.
+    // value - значение элементов за пределами матрицы для Border_Constant.
+    // Область может выходить за пределы in на любое расстояние,
+    // поэтому дополненная матрица позволяет вычислять свёртку
+    // без проверок выхода за границы.
+    // Для 16- и 8-битных матриц value должно помещаться в тип элемента.
+    void padMatrix(Matrix2D<int>* out, const MatrixView<const int>& in,
+                   const QRect& rect, BorderMode mode, int value = 0);
+    void padMatrix(Matrix2D<quint16>* out, const MatrixView<const quint16>& in,
+                   const QRect& rect, BorderMode mode, int value = 0);
+    void padMatrix(Matrix2D<quint8>* out, const MatrixView<const quint8>& in,
+                   const QRect& rect, BorderMode mode, int value = 0);
+
+    // Изменить размер матрицы с преобразованием информации, имеющейся в исходной матрице.
+    // Перегрузки для 16- и 8-битных матриц без знака (например, оттенков серого)
+    // вычисляются так же, но читают и записывают в 2-4 раза меньше данных.
+    void scaleMatrix(Matrix2D<int>* out, const MatrixView<const int>& in, const QSize& outSize);
+    void scaleMatrix(Matrix2D<quint16>* out, const MatrixView<const quint16>& in, const QSize& outSize);
+    void scaleMatrix(Matrix2D<quint8>* out, const MatrixView<const quint8>& in, const QSize& outSize);
+
+    // Изменить размер матрицы in до размера представления out
+    // и записать результат в out (без выделения памяти).
+    // Элемент результата - сумма элементов in, взвешенных по площади их
+    // пересечения с элементом результата, делённая на его площадь.
+    // Результат совпадает с scaleMatrixReference (отличается не более чем на 1):
+    // площади пересечения вычисляются так же, и дробная часть суммы отбрасывается
+    // после каждого дробного вклада. Целиком покрытые строки in суммируются
+    // по вертикали векторными инструкциями (см. Wavelet::accumulateTaps),
+    // целиком покрытые столбцы - по горизонтали одним циклом по отрезку
+    // столбцов (без проверки весов), а вклады элементов на краях - по элементам.
+    // Если значения in отрицательны или сумма по вертикали может выйти
+    // за пределы qint32, то используется scaleMatrixReference.
+    void scaleMatrix(const MatrixView<int>& out, const MatrixView<const int>& in);
+    void scaleMatrix(const MatrixView<quint16>& out, const MatrixView<const quint16>& in);
+    void scaleMatrix(const MatrixView<quint8>& out, const MatrixView<const quint8>& in);
+
+    // Изменить размер матрицы in до размера представления out прямым вычислением
+    // площадей пересечения элементов (эталонная реализация scaleMatrix)
+    void scaleMatrixReference(const MatrixView<int>& out, const MatrixView<const int>& in);
+    void scaleMatrixReference(const MatrixView<quint16>& out, const MatrixView<const quint16>& in);
+    void scaleMatrixReference(const MatrixView<quint8>& out, const MatrixView<const quint8>& in);
+
+    // Найти минимальный и максимальный элементы матрицы.
+    // Координаты найденных элементов задаются относительно представления matrix.
+    // При равных значениях выбирается элемент с меньшей координатой X,
+    // а при равных X - с меньшей координатой Y.
+    // Элементы, не превышающие начальные значения *maxVal (не меньшие *minVal),
+    // не учитываются; в этом случае соответствующая точка не изменяется.
+    void findExtremums(const MatrixView<const int>& matrix,
+                       int* minVal, QPoint* minPoint,
+                       int* maxVal, QPoint* maxPoint);
+
+
+    // Поиск минимального и максимального элементов по частям матрицы
+    // (например, по строкам результата свёртки по мере их вычисления).
+    // Правила выбора элементов совпадают с findExtremums: строки одной части
+    // добавляются сверху вниз, а результаты частей объединяются функцией merge
+    // в любом порядке.
+    struct ExtremumsAccumulator {
+        int minVal, maxVal;
+        QPoint minPoint, maxPoint;
+        bool minFound, maxFound;    // Найден ли элемент, превышающий начальное значение
+
+        ExtremumsAccumulator() :
+            minVal(0), maxVal(0), minFound(false), maxFound(false) {}
+        ExtremumsAccumulator(int minInit, int maxInit) :
+            minVal(minInit), maxVal(maxInit), minFound(false), maxFound(false) {}
+
+        // Учесть строку row из width элементов с координатами (x + i, y)
+        void addRow(const int* row, int width, int x, int y);
+
+        // Объединить с результатом другой части матрицы
+        // (с теми же начальными значениями)
+        void merge(const ExtremumsAccumulator& right);
+    };
 
 }   // namespace Matrix
 
@@ -0,0 +1,40 @@
+#include "parallel.h"
+
+#include <QThreadPool>
+
+namespace {
+
+    // Кол-во частей диапазона на один поток
+    const int Chunks_Per_Thread = 4;
+
+}   // namespace
+
+
+// Получить кол-во потоков глобального пула
+int Parallel::getThreadCount(void)
+{
+    return qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+}
+
+
+// Получить размер части диапазона
+int Parallel::getChunkSize(int count, int minChunk, int maxChunk)
+{
+    Q_ASSERT (minChunk > 0);
+
+    const int parts = getThreadCount() * Chunks_Per_Thread;
+    const int chunk = (count + parts - 1) / parts;
+    return qMax(minChunk, qMin(chunk, maxChunk));
+}
+
+
+// Разбить диапазон на части
+QVector<Parallel::Range> Parallel::splitRange(int begin, int end, int chunk)
+{
+    Q_ASSERT (chunk > 0);
+
+    QVector<Range> ranges;
+    for (int first = begin; first < end; first += chunk)
+        ranges.append(Range(first, qMin(first + chunk, end)));
+    return ranges;
+}
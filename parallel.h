@@ -0,0 +1,54 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QVector>
+#include <QPair>
+#include <QtConcurrent/QtConcurrent>
+
+// Параллельное выполнение частей одного вычисления в глобальном пуле потоков.
+// Вызов может быть вложен в задачу, которая уже выполняется в пуле
+// (например, в вычисление экстремумов для одного диаметра): вызывающий поток
+// сам выполняет части, а дополнительные потоки пула подключаются только
+// если они свободны, поэтому кол-во потоков не превышает размер пула.
+namespace Parallel {
+
+    // Диапазон индексов [first, second)
+    typedef QPair<int, int> Range;
+
+    // Получить кол-во потоков глобального пула
+    int getThreadCount(void);
+
+    // Получить размер части диапазона из count элементов:
+    // на каждый поток приходится несколько частей (для выравнивания нагрузки),
+    // размер части не меньше minChunk (накладные расходы на часть)
+    // и не больше maxChunk (данные части помещаются в кеш процессора).
+    int getChunkSize(int count, int minChunk, int maxChunk);
+
+    // Разбить диапазон [begin, end) на части размером chunk (последняя может быть меньше)
+    QVector<Range> splitRange(int begin, int end, int chunk);
+
+
+    // Функтор для QtConcurrent::blockingMap
+    template <class F>
+    struct RangeFunctor {
+        F fun;
+        RangeFunctor(const F& f) : fun(f) {}
+        void operator()(Range& range) { fun(range.first, range.second); }
+    };
+
+
+    // Выполнить fun(first, last) для частей диапазона [begin, end) размером chunk.
+    // Возврат происходит после выполнения всех частей.
+    // Части выполняются параллельно и не должны записывать общие данные.
+    template <class F>
+    void forRange(int begin, int end, int chunk, F fun) {
+        QVector<Range> ranges(splitRange(begin, end, chunk));
+        if (ranges.size() == 1)
+            fun(begin, end);
+        else if (ranges.size() > 1)
+            QtConcurrent::blockingMap(ranges, RangeFunctor<F>(fun));
+    }
+
+}   // namespace Parallel
+
+#endif // PARALLEL_H
@@ -1,9 +1,23 @@
 #ifndef PERFORMANCETIMER_H
 #define PERFORMANCETIMER_H
 
-#include "windows.h"
+#include <QtGlobal>
+#include <chrono>
+
+// Счётчик тактов процессора (TSC) используется только по явному запросу
+// (DEFINES += PERFORMANCE_TIMER_TSC): он дешевле steady_clock, но его частота
+// определяется калибровкой и на некоторых процессорах не постоянна
+#if defined(PERFORMANCE_TIMER_TSC) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define PERFORMANCE_TIMER_USE_TSC
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
 
 // Таймер для измерения производительности выполнения операций
+// (монотонный, не зависит от перевода системных часов)
 // Пример использования:
 // CTimer timer;
 // timer.Start();
@@ -15,37 +29,61 @@
 
 class CTimer {
 protected:
-    LARGE_INTEGER F, T1;
+    quint64 T1;
 public:
-    CTimer() {QueryPerformanceFrequency(&F); T1.QuadPart=0;}
+    CTimer() : T1(0) {}
+
+    // Получить частоту счётчика (тиков в секунду)
+    static inline quint64 GetFrequency(void) {
+#if defined(PERFORMANCE_TIMER_USE_TSC)
+        // Частота TSC определяется один раз по steady_clock
+        static const quint64 frequency = CalibrateTsc();
+        return frequency;
+#else
+        return std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+#endif
+    }
 
-    //__fastcall
-    inline quint64 GetFrequency(void) {return F.QuadPart;}
+    // Получить текущее значение счётчика
+    static inline quint64 GetCounter(void) {
+#if defined(PERFORMANCE_TIMER_USE_TSC)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
 
-    //__fastcall
-    inline quint64 GetCounter(void) {
-        register LARGE_INTEGER T2;
-        QueryPerformanceCounter(&T2);
-        return T2.QuadPart;
+    // Перевести кол-во тиков в наносекунды
+    static inline double TicksToNsecs(quint64 ticks) {
+        return (double) ticks * 1e9 / GetFrequency();
     }
 
-    //__fastcall
-    inline void Start(void) {QueryPerformanceCounter(&T1);}
+    inline void Start(void) {T1 = GetCounter();}
+
+    inline quint64 Ticks_after_Start(void) const {
+        return GetCounter() - T1;
+    }
 
-    //__fastcall
-    inline quint64 Ticks_after_Start(void) {
-        register LARGE_INTEGER T2;
-        QueryPerformanceCounter(&T2);
-        return T2.QuadPart-T1.QuadPart;
+    // Время после Start() в секундах
+    inline double Time(void) const {
+        return (double) (GetCounter() - T1) / GetFrequency();
     }
 
-    // __fastcall
-    inline double Time(void) {
-        LARGE_INTEGER T2;
-        QueryPerformanceCounter(&T2);
-        //QueryPerformanceFrequency(&F);
-        return (double)(T2.QuadPart-T1.QuadPart)/F.QuadPart;
+#if defined(PERFORMANCE_TIMER_USE_TSC)
+private:
+    // Определить частоту TSC по интервалу steady_clock около 10 мс
+    static quint64 CalibrateTsc(void) {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point start = Clock::now();
+        const quint64 startTicks = __rdtsc();
+        Clock::time_point now = start;
+        while (now - start < std::chrono::milliseconds(10))
+            now = Clock::now();
+        const quint64 ticks = __rdtsc() - startTicks;
+        const double secs = std::chrono::duration<double>(now - start).count();
+        return qMax((quint64) 1, (quint64) (ticks / secs));
     }
+#endif
 };
 
 #endif // PERFORMANCETIMER_H
@@ -0,0 +1,339 @@
+#include "pixelsimd.h"
+
+#include "simd.h"
+
+#if defined(SIMD_X86)
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+    // Веса каналов оттенка серого (как в qGray): (r * 11 + g * 16 + b * 5) / 32
+    const int Red_Weight = 11;
+    const int Green_Weight = 16;
+    const int Blue_Weight = 5;
+    const int Weight_Shift = 5;
+
+
+    // Скалярные реализации (также обрабатывают остаток строки)
+    inline int grayOf(int r, int g, int b) {
+        return (r * Red_Weight + g * Green_Weight + b * Blue_Weight) >> Weight_Shift;
+    }
+
+    void rgb32ToGrayScalar(int* out, const quint32* in, int begin, int count)
+    {
+        for (int x = begin; x < count; ++x) {
+            const quint32 p = in[x];
+            out[x] = grayOf((p >> 16) & 0xff, (p >> 8) & 0xff, p & 0xff);
+        }
+    }
+
+    void rgb888ToGrayScalar(int* out, const uchar* in, int begin, int count)
+    {
+        for (int x = begin; x < count; ++x)
+            out[x] = grayOf(in[3 * x], in[3 * x + 1], in[3 * x + 2]);
+    }
+
+    void grayToRgb32Scalar(quint32* out, const int* in, int begin, int count)
+    {
+        for (int x = begin; x < count; ++x)
+            out[x] = 0xff000000u | ((quint32) (in[x] & 0xff) * 0x010101u);
+    }
+
+    void halveRowsScalar(int* out, const int* row0, const int* row1, int begin, int count)
+    {
+        for (int x = begin; x < count; ++x)
+            out[x] = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) / 4;
+    }
+
+    void halveRowsScalar(quint8* out, const quint8* row0, const quint8* row1, int begin, int count)
+    {
+        for (int x = begin; x < count; ++x)
+            out[x] = (quint8) ((row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) >> 2);
+    }
+
+#if defined(SIMD_X86)
+    // Реализации SSE4.1: по 4 пиксела
+    SIMD_TARGET("sse4.1")
+    void rgb32ToGraySse41(int* out, const quint32* in, int count)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i wr = _mm_set1_epi32(Red_Weight);
+        const __m128i wg = _mm_set1_epi32(Green_Weight);
+        const __m128i wb = _mm_set1_epi32(Blue_Weight);
+        int x = 0;
+        for (; x + 4 <= count; x += 4) {
+            const __m128i p = _mm_loadu_si128((const __m128i*) (in + x));
+            __m128i s = _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(p, 16), mask), wr);
+            s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_and_si128(_mm_srli_epi32(p, 8), mask), wg));
+            s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_and_si128(p, mask), wb));
+            _mm_storeu_si128((__m128i*) (out + x), _mm_srli_epi32(s, Weight_Shift));
+        }
+        rgb32ToGrayScalar(out, in, x, count);
+    }
+
+    SIMD_TARGET("sse4.1")
+    void rgb888ToGraySse41(int* out, const uchar* in, int count)
+    {
+        // Байты R, G и B 4 пикселов (12 байт) в 32-битные элементы
+        const __m128i shufR = _mm_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1);
+        const __m128i shufG = _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1);
+        const __m128i shufB = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+        const __m128i wr = _mm_set1_epi32(Red_Weight);
+        const __m128i wg = _mm_set1_epi32(Green_Weight);
+        const __m128i wb = _mm_set1_epi32(Blue_Weight);
+        int x = 0;
+        // Загружается 16 байт, поэтому за 4 пикселами должно быть ещё не менее 4 байт
+        for (; x + 6 <= count; x += 4) {
+            const __m128i p = _mm_loadu_si128((const __m128i*) (in + 3 * x));
+            __m128i s = _mm_mullo_epi32(_mm_shuffle_epi8(p, shufR), wr);
+            s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_shuffle_epi8(p, shufG), wg));
+            s = _mm_add_epi32(s, _mm_mullo_epi32(_mm_shuffle_epi8(p, shufB), wb));
+            _mm_storeu_si128((__m128i*) (out + x), _mm_srli_epi32(s, Weight_Shift));
+        }
+        rgb888ToGrayScalar(out, in, x, count);
+    }
+
+    SIMD_TARGET("sse4.1")
+    void grayToRgb32Sse41(quint32* out, const int* in, int count)
+    {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128i spread = _mm_set1_epi32(0x010101);
+        const __m128i alpha = _mm_set1_epi32((int) 0xff000000u);
+        int x = 0;
+        for (; x + 4 <= count; x += 4) {
+            const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*) (in + x)), mask);
+            _mm_storeu_si128((__m128i*) (out + x), _mm_or_si128(_mm_mullo_epi32(v, spread), alpha));
+        }
+        grayToRgb32Scalar(out, in, x, count);
+    }
+
+    // Деление на 4 с округлением к нулю (как целочисленное деление в C++)
+    SIMD_TARGET("sse4.1")
+    inline __m128i divideBy4Sse41(__m128i s)
+    {
+        return _mm_srai_epi32(_mm_add_epi32(s, _mm_and_si128(_mm_srai_epi32(s, 31),
+                                                             _mm_set1_epi32(3))), 2);
+    }
+
+    SIMD_TARGET("sse4.1")
+    void halveRowsSse41(int* out, const int* row0, const int* row1, int count)
+    {
+        int x = 0;
+        for (; x + 4 <= count; x += 4) {
+            // Суммы столбцов пары строк, затем суммы соседних столбцов
+            const __m128i a = _mm_add_epi32(_mm_loadu_si128((const __m128i*) (row0 + 2 * x)),
+                                            _mm_loadu_si128((const __m128i*) (row1 + 2 * x)));
+            const __m128i b = _mm_add_epi32(_mm_loadu_si128((const __m128i*) (row0 + 2 * x + 4)),
+                                            _mm_loadu_si128((const __m128i*) (row1 + 2 * x + 4)));
+            _mm_storeu_si128((__m128i*) (out + x), divideBy4Sse41(_mm_hadd_epi32(a, b)));
+        }
+        halveRowsScalar(out, row0, row1, x, count);
+    }
+
+    // 16 элементов out по 32 байтам каждой строки: суммы соседних байтов
+    // в 16-битных элементах (не более 4 * 255), сдвиг и упаковка в байты
+    SIMD_TARGET("sse4.1")
+    void halveRowsSse41(quint8* out, const quint8* row0, const quint8* row1, int count)
+    {
+        const __m128i ones = _mm_set1_epi8(1);
+        int x = 0;
+        for (; x + 16 <= count; x += 16) {
+            const __m128i a = _mm_add_epi16(
+                        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) (row0 + 2 * x)), ones),
+                        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) (row1 + 2 * x)), ones));
+            const __m128i b = _mm_add_epi16(
+                        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) (row0 + 2 * x + 16)), ones),
+                        _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) (row1 + 2 * x + 16)), ones));
+            _mm_storeu_si128((__m128i*) (out + x),
+                             _mm_packus_epi16(_mm_srli_epi16(a, 2), _mm_srli_epi16(b, 2)));
+        }
+        halveRowsScalar(out, row0, row1, x, count);
+    }
+
+
+    // Реализации AVX2: по 8 пикселов
+    SIMD_TARGET("avx2")
+    void rgb32ToGrayAvx2(int* out, const quint32* in, int count)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256i wr = _mm256_set1_epi32(Red_Weight);
+        const __m256i wg = _mm256_set1_epi32(Green_Weight);
+        const __m256i wb = _mm256_set1_epi32(Blue_Weight);
+        int x = 0;
+        for (; x + 8 <= count; x += 8) {
+            const __m256i p = _mm256_loadu_si256((const __m256i*) (in + x));
+            __m256i s = _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 16), mask), wr);
+            s = _mm256_add_epi32(s, _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(p, 8), mask), wg));
+            s = _mm256_add_epi32(s, _mm256_mullo_epi32(_mm256_and_si256(p, mask), wb));
+            _mm256_storeu_si256((__m256i*) (out + x), _mm256_srli_epi32(s, Weight_Shift));
+        }
+        rgb32ToGrayScalar(out, in, x, count);
+    }
+
+    SIMD_TARGET("avx2")
+    void grayToRgb32Avx2(quint32* out, const int* in, int count)
+    {
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256i spread = _mm256_set1_epi32(0x010101);
+        const __m256i alpha = _mm256_set1_epi32((int) 0xff000000u);
+        int x = 0;
+        for (; x + 8 <= count; x += 8) {
+            const __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (in + x)), mask);
+            _mm256_storeu_si256((__m256i*) (out + x),
+                                _mm256_or_si256(_mm256_mullo_epi32(v, spread), alpha));
+        }
+        grayToRgb32Scalar(out, in, x, count);
+    }
+
+    SIMD_TARGET("avx2")
+    void halveRowsAvx2(int* out, const int* row0, const int* row1, int count)
+    {
+        const __m256i three = _mm256_set1_epi32(3);
+        int x = 0;
+        for (; x + 8 <= count; x += 8) {
+            const __m256i a = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) (row0 + 2 * x)),
+                                               _mm256_loadu_si256((const __m256i*) (row1 + 2 * x)));
+            const __m256i b = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*) (row0 + 2 * x + 8)),
+                                               _mm256_loadu_si256((const __m256i*) (row1 + 2 * x + 8)));
+            // hadd складывает пары внутри 128-битных половин,
+            // перестановка восстанавливает порядок элементов
+            __m256i s = _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            s = _mm256_add_epi32(s, _mm256_and_si256(_mm256_srai_epi32(s, 31), three));
+            _mm256_storeu_si256((__m256i*) (out + x), _mm256_srai_epi32(s, 2));
+        }
+        halveRowsScalar(out, row0, row1, x, count);
+    }
+
+    SIMD_TARGET("avx2")
+    void halveRowsAvx2(quint8* out, const quint8* row0, const quint8* row1, int count)
+    {
+        const __m256i ones = _mm256_set1_epi8(1);
+        int x = 0;
+        for (; x + 32 <= count; x += 32) {
+            const __m256i a = _mm256_add_epi16(
+                        _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) (row0 + 2 * x)), ones),
+                        _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) (row1 + 2 * x)), ones));
+            const __m256i b = _mm256_add_epi16(
+                        _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) (row0 + 2 * x + 32)), ones),
+                        _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) (row1 + 2 * x + 32)), ones));
+            // packus упаковывает внутри 128-битных половин,
+            // перестановка восстанавливает порядок элементов
+            const __m256i p = _mm256_packus_epi16(_mm256_srli_epi16(a, 2), _mm256_srli_epi16(b, 2));
+            _mm256_storeu_si256((__m256i*) (out + x), _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+        halveRowsScalar(out, row0, row1, x, count);
+    }
+#endif
+
+}   // namespace
+
+
+void ImageUtils::rgb32ToGray(int* out, const quint32* in, int count)
+{
+    Q_ASSERT (count >= 0);
+    Q_ASSERT (count == 0 || (out && in));
+
+    switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+    case Simd::Level_Avx512:
+    case Simd::Level_Avx2:
+        rgb32ToGrayAvx2(out, in, count);
+        return;
+    case Simd::Level_Sse41:
+        rgb32ToGraySse41(out, in, count);
+        return;
+#endif
+    default:
+        rgb32ToGrayScalar(out, in, 0, count);
+        return;
+    }
+}
+
+
+void ImageUtils::rgb888ToGray(int* out, const uchar* in, int count)
+{
+    Q_ASSERT (count >= 0);
+    Q_ASSERT (count == 0 || (out && in));
+
+    // Перестановка байт внутри 128-битных половин AVX2 не даёт выигрыша
+    // по сравнению с SSE4.1 для 3-байтных пикселов
+    switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+    case Simd::Level_Avx512:
+    case Simd::Level_Avx2:
+    case Simd::Level_Sse41:
+        rgb888ToGraySse41(out, in, count);
+        return;
+#endif
+    default:
+        rgb888ToGrayScalar(out, in, 0, count);
+        return;
+    }
+}
+
+
+void ImageUtils::grayToRgb32(quint32* out, const int* in, int count)
+{
+    Q_ASSERT (count >= 0);
+    Q_ASSERT (count == 0 || (out && in));
+
+    switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+    case Simd::Level_Avx512:
+    case Simd::Level_Avx2:
+        grayToRgb32Avx2(out, in, count);
+        return;
+    case Simd::Level_Sse41:
+        grayToRgb32Sse41(out, in, count);
+        return;
+#endif
+    default:
+        grayToRgb32Scalar(out, in, 0, count);
+        return;
+    }
+}
+
+
+void ImageUtils::halveRows(int* out, const int* row0, const int* row1, int count)
+{
+    Q_ASSERT (count >= 0);
+    Q_ASSERT (count == 0 || (out && row0 && row1));
+
+    switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+    case Simd::Level_Avx512:
+    case Simd::Level_Avx2:
+        halveRowsAvx2(out, row0, row1, count);
+        return;
+    case Simd::Level_Sse41:
+        halveRowsSse41(out, row0, row1, count);
+        return;
+#endif
+    default:
+        halveRowsScalar(out, row0, row1, 0, count);
+        return;
+    }
+}
+
+
+void ImageUtils::halveRows(quint8* out, const quint8* row0, const quint8* row1, int count)
+{
+    Q_ASSERT (count >= 0);
+    Q_ASSERT (count == 0 || (out && row0 && row1));
+
+    switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+    case Simd::Level_Avx512:
+    case Simd::Level_Avx2:
+        halveRowsAvx2(out, row0, row1, count);
+        return;
+    case Simd::Level_Sse41:
+        halveRowsSse41(out, row0, row1, count);
+        return;
+#endif
+    default:
+        halveRowsScalar(out, row0, row1, 0, count);
+        return;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef PIXELSIMD_H
+#define PIXELSIMD_H
+
+#include <QtGlobal>
+
+// Векторные процедуры преобразования строк пикселов и матриц.
+// Реализация (скалярная, SSE4.1, AVX2) выбирается по Simd::getLevel(),
+// результаты всех реализаций совпадают.
+namespace ImageUtils {
+
+    // Получить оттенки серого count пикселов формата 0xAARRGGBB
+    // (QImage::Format_RGB32, Format_ARGB32): out[x] = qGray(in[x]).
+    void rgb32ToGray(int* out, const quint32* in, int count);
+
+    // Получить оттенки серого count пикселов по 3 байта R, G, B
+    // (QImage::Format_RGB888): out[x] = qGray(in[3x], in[3x + 1], in[3x + 2]).
+    void rgb888ToGray(int* out, const uchar* in, int count);
+
+    // Получить пикселы 0xFFVVVVVV по count оттенкам серого
+    // (как qRgb(v, v, v): используются младшие 8 бит значения).
+    void grayToRgb32(quint32* out, const int* in, int count);
+
+    // Уменьшить пару соседних строк в 2 раза усреднением блоков 2x2:
+    // out[x] = (row0[2x] + row0[2x + 1] + row1[2x] + row1[2x + 1]) / 4
+    // для count элементов out (строки содержат не менее 2 * count элементов).
+    void halveRows(int* out, const int* row0, const int* row1, int count);
+    void halveRows(quint8* out, const quint8* row0, const quint8* row1, int count);
+
+}   // namespace ImageUtils
+
+#endif // PIXELSIMD_H
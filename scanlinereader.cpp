@@ -0,0 +1,241 @@
+#include "scanlinereader.h"
+
+#include <QColor>
+#include <QtEndian>
+#include <climits>
+
+
+namespace {
+
+    // Размер заголовка файла BMP и минимальный размер заголовка
+    // BITMAPINFOHEADER (более ранний формат OS/2 не поддерживается)
+    const int Bmp_File_Header_Bytes = 14;
+    const int Bmp_Info_Header_Bytes = 40;
+
+    // Способ сжатия BMP без сжатия (BI_RGB)
+    const quint32 Bmp_Uncompressed = 0;
+
+    inline quint32 le32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+    inline quint16 le16(const uchar* p) { return qFromLittleEndian<quint16>(p); }
+
+}   // namespace
+
+
+ScanlineReader::ScanlineReader()
+    : kind(Kind_Lut), pixelBytes(1), rowBytes(0), dataOffset(0), bottomUp(false), nextRow(0)
+{
+}
+
+
+// Открыть файл и прочитать заголовок
+bool ScanlineReader::open(const QString& path)
+{
+    file.close();
+    size = QSize();
+    nextRow = 0;
+    bottomUp = false;
+    error.clear();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    // Формат определяется по сигнатуре
+    const QByteArray magic(file.peek(2));
+    bool opened = false;
+    if (magic == "P5" || magic == "P6") {
+        opened = openNetpbm();
+    }
+    else if (magic == "BM") {
+        opened = openBmp();
+    }
+    else {
+        error = QString("Format does not support streamed reading (binary PGM/PPM or uncompressed BMP only)");
+    }
+
+    if (opened && file.size() < dataOffset + rowBytes * size.height()) {
+        error = QString("Unexpected end of file");
+        opened = false;
+    }
+    if (opened && !file.seek(bottomUp ? dataOffset + rowBytes * (size.height() - 1) : dataOffset)) {
+        error = file.errorString();
+        opened = false;
+    }
+    if (!opened) {
+        size = QSize();
+        file.close();
+        return false;
+    }
+
+    row.resize(rowBytes);
+    return true;
+}
+
+
+// Прочитать заголовок PGM или PPM
+bool ScanlineReader::openNetpbm(void)
+{
+    char type[2];
+    file.read(type, 2);
+
+    int width = 0, height = 0, maxValue = 0;
+    char separator = 0;
+    if (!readNetpbmNumber(&width) || !readNetpbmNumber(&height) || !readNetpbmNumber(&maxValue) ||
+            !file.getChar(&separator)) {
+        error = QString("Invalid PGM/PPM header");
+        return false;
+    }
+    if (width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) {
+        error = QString("Unsupported PGM/PPM image (at most 8 bits per channel)");
+        return false;
+    }
+
+    size = QSize(width, height);
+    dataOffset = file.pos();
+    if (type[1] == '5') {
+        // Оттенки серого 0..maxValue приводятся к 0..255
+        kind = Kind_Lut;
+        pixelBytes = 1;
+        for (int v = 0; v < 256; ++v)
+            lut[v] = (v < maxValue) ? (quint8) ((v * 255 + maxValue / 2) / maxValue) : 255;
+    }
+    else {
+        kind = Kind_Rgb;
+        pixelBytes = 3;
+        if (maxValue != 255) {
+            error = QString("Unsupported PPM image (only 255 levels per channel)");
+            return false;
+        }
+    }
+    rowBytes = (qint64) width * pixelBytes;
+    return true;
+}
+
+
+// Прочитать заголовок BMP
+bool ScanlineReader::openBmp(void)
+{
+    uchar header[Bmp_File_Header_Bytes + Bmp_Info_Header_Bytes];
+    if (file.read((char*) header, sizeof(header)) != sizeof(header)) {
+        error = QString("Invalid BMP header");
+        return false;
+    }
+    const uchar* info = header + Bmp_File_Header_Bytes;
+    const quint32 infoBytes = le32(info);
+    const qint32 width = (qint32) le32(info + 4);
+    const qint32 height = (qint32) le32(info + 8);
+    const int bitCount = le16(info + 14);
+    const quint32 compression = le32(info + 16);
+    const quint32 colorsUsed = le32(info + 32);
+
+    if (infoBytes < (quint32) Bmp_Info_Header_Bytes || width <= 0 || height == 0 || height == INT_MIN ||
+            compression != Bmp_Uncompressed || (bitCount != 8 && bitCount != 24 && bitCount != 32)) {
+        error = QString("Unsupported BMP image (uncompressed 8, 24 or 32 bits only)");
+        return false;
+    }
+
+    // Высота отрицательна, если строки хранятся сверху вниз
+    size = QSize(width, qAbs(height));
+    bottomUp = (height > 0);
+    dataOffset = le32(header + 10);
+    rowBytes = ((qint64) width * bitCount + 31) / 32 * 4;
+
+    if (bitCount == 8) {
+        // Палитра (B, G, R, 0) следует за заголовком изображения,
+        // индексы вне палитры дают 0
+        const int colors = (colorsUsed > 0 && colorsUsed < 256) ? (int) colorsUsed : 256;
+        QByteArray palette;
+        if (file.seek(Bmp_File_Header_Bytes + infoBytes))
+            palette = file.read(colors * 4);
+        if (palette.size() != colors * 4) {
+            error = QString("Invalid BMP palette");
+            return false;
+        }
+        const uchar* entry = reinterpret_cast<const uchar*>(palette.constData());
+        for (int i = 0; i < 256; ++i)
+            lut[i] = (i < colors) ? (quint8) qGray(entry[4 * i + 2], entry[4 * i + 1], entry[4 * i]) : 0;
+        kind = Kind_Lut;
+        pixelBytes = 1;
+    }
+    else {
+        kind = Kind_Bgr;
+        pixelBytes = bitCount / 8;
+    }
+    return true;
+}
+
+
+// Прочитать число заголовка PGM или PPM
+bool ScanlineReader::readNetpbmNumber(int* value)
+{
+    char c = 0;
+    // Пропустить пробелы и комментарии (от # до конца строки)
+    for (;;) {
+        if (!file.getChar(&c))
+            return false;
+        if (c == '#') {
+            while (c != '\n' && c != '\r')
+                if (!file.getChar(&c))
+                    return false;
+        }
+        else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+    }
+
+    qint64 number = 0;
+    int digits = 0;
+    while (c >= '0' && c <= '9') {
+        number = number * 10 + (c - '0');
+        ++digits;
+        if (number > INT_MAX || !file.getChar(&c))
+            return false;
+    }
+    // Символ после числа (пробел) принадлежит заголовку
+    file.ungetChar(c);
+    *value = (int) number;
+    return digits > 0;
+}
+
+
+// Прочитать следующую строку
+bool ScanlineReader::readRow(quint8* out)
+{
+    Q_ASSERT (out);
+
+    if (nextRow >= size.height()) {
+        error = QString("No more rows");
+        return false;
+    }
+
+    // Строки BMP, которые хранятся снизу вверх, читаются с конца файла
+    if (bottomUp && !file.seek(dataOffset + rowBytes * (size.height() - 1 - nextRow))) {
+        error = file.errorString();
+        return false;
+    }
+    if (file.read(reinterpret_cast<char*>(row.data()), rowBytes) != rowBytes) {
+        error = QString("Unexpected end of file");
+        return false;
+    }
+
+    const int width = size.width();
+    const uchar* p = row.constData();
+    switch (kind) {
+    case Kind_Lut:
+        for (int x = 0; x < width; ++x)
+            out[x] = lut[p[x]];
+        break;
+    case Kind_Rgb:
+        for (int x = 0; x < width; ++x, p += 3)
+            out[x] = (quint8) qGray(p[0], p[1], p[2]);
+        break;
+    case Kind_Bgr:
+        for (int x = 0; x < width; ++x, p += pixelBytes)
+            out[x] = (quint8) qGray(p[2], p[1], p[0]);
+        break;
+    }
+    ++nextRow;
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef SCANLINEREADER_H
+#define SCANLINEREADER_H
+
+#include <QString>
+#include <QSize>
+#include <QFile>
+#include <QVector>
+
+/*!
+ * \brief The ScanlineReader класс последовательного чтения строк файла
+ * изображения сверху вниз в оттенках серого (как qGray) без загрузки
+ * изображения целиком. Каждая строка файла читается и преобразуется один раз,
+ * поэтому расход памяти определяется шириной изображения, а время чтения
+ * пропорционально размеру файла (в том числе для многогигапиксельных
+ * изображений, которые не помещаются в QImage).
+ * Поддерживаются форматы, строки которых хранятся без сжатия:
+ * двоичные PGM и PPM (P5, P6, не более 8 бит на канал)
+ * и BMP без сжатия (8 бит с палитрой, 24 и 32 бита).
+ * Для остальных форматов open возвращает false.
+ *
+ * Пример использования:
+ * ScanlineReader reader;
+ * if (reader.open(path))
+ *     for (int y = 0; y < reader.getSize().height(); ++y)
+ *         reader.readRow(row);
+ */
+class ScanlineReader
+{
+public:
+    ScanlineReader();
+
+    // Открыть файл path и прочитать заголовок.
+    // Возвращает false, если файл не удалось открыть или формат
+    // не поддерживается (описание - в getError).
+    bool open(const QString& path);
+
+    // Получить размер изображения (пустой, если файл не открыт)
+    QSize getSize(void) const { return size; }
+
+    // Получить номер следующей строки
+    int getNextRow(void) const { return nextRow; }
+
+    // Записать в out оттенки серого следующей строки (getSize().width() элементов).
+    // Возвращает false при ошибке чтения или если все строки прочитаны.
+    bool readRow(quint8* out);
+
+    // Получить описание последней ошибки
+    const QString& getError(void) const { return error; }
+
+private:
+    ScanlineReader(const ScanlineReader&);
+    ScanlineReader& operator= (const ScanlineReader&);
+
+    // Способ преобразования строки файла в оттенки серого
+    enum Kind {
+        Kind_Lut,       // 1 байт на пиксел: оттенок серого по таблице
+        Kind_Rgb,       // 3 байта R, G, B
+        Kind_Bgr        // 3 или 4 байта B, G, R (, X)
+    };
+
+    // Прочитать заголовок PGM или PPM (P5, P6)
+    bool openNetpbm(void);
+
+    // Прочитать заголовок BMP
+    bool openBmp(void);
+
+    // Прочитать из заголовка PGM или PPM число (с пропуском пробелов и комментариев)
+    bool readNetpbmNumber(int* value);
+
+    QFile file;
+    QSize size;             // Размер изображения
+    Kind kind;
+    int pixelBytes;         // Кол-во байт на пиксел в строке файла
+    qint64 rowBytes;        // Кол-во байт строки в файле (с выравниванием)
+    qint64 dataOffset;      // Смещение первой строки файла
+    bool bottomUp;          // Строки хранятся снизу вверх (BMP)
+    int nextRow;            // Номер следующей строки
+    quint8 lut[256];        // Оттенки серого (для Kind_Lut)
+    QVector<uchar> row;     // Строка файла
+    QString error;          // Описание ошибки
+};
+
+#endif // SCANLINEREADER_H
@@ -0,0 +1,79 @@
+#include "scratchpool.h"
+
+#include <QMutexLocker>
+
+using namespace Matrix;
+
+ScratchPool::ScratchPool() : totalBytes(0), peakBytes(0)
+{
+}
+
+
+ScratchPool::~ScratchPool()
+{
+    clear();
+}
+
+
+// Получить свободный набор временных матриц
+ScratchBuffers* ScratchPool::acquire(void)
+{
+    QMutexLocker locker(&mutex);
+    if (freeSlots.isEmpty()) {
+        Slot* slot = new Slot;
+        allSlots.append(slot);
+        return &slot->buffers;
+    }
+    return &freeSlots.takeLast()->buffers;
+}
+
+
+// Вернуть набор в пул
+void ScratchPool::release(ScratchBuffers* buffers)
+{
+    Q_ASSERT (buffers);
+
+    // Размер набора считается до блокировки, набор принадлежит только текущему потоку
+    const size_t bytes = buffers->getBytes();
+
+    QMutexLocker locker(&mutex);
+    Slot* slot = NULL;
+    for (int i = 0; i < allSlots.size() && slot == NULL; ++i)
+        if (&allSlots.at(i)->buffers == buffers)
+            slot = allSlots.at(i);
+    Q_ASSERT (slot);
+    Q_ASSERT (!freeSlots.contains(slot));
+
+    totalBytes = totalBytes - slot->bytes + bytes;
+    slot->bytes = bytes;
+    peakBytes = qMax(peakBytes, totalBytes);
+    freeSlots.append(slot);
+}
+
+
+// Освободить память всех наборов
+void ScratchPool::clear(void)
+{
+    QMutexLocker locker(&mutex);
+    Q_ASSERT (freeSlots.size() == allSlots.size());
+    qDeleteAll(allSlots);
+    allSlots.clear();
+    freeSlots.clear();
+    totalBytes = 0;
+}
+
+
+// Получить максимальный объём памяти наборов
+size_t ScratchPool::getPeakBytes(void) const
+{
+    QMutexLocker locker(&mutex);
+    return peakBytes;
+}
+
+
+// Сбросить счётчик максимального объёма памяти
+void ScratchPool::resetPeakBytes(void)
+{
+    QMutexLocker locker(&mutex);
+    peakBytes = totalBytes;
+}
@@ -0,0 +1,96 @@
+#ifndef SCRATCHPOOL_H
+#define SCRATCHPOOL_H
+
+#include <QMutex>
+#include <QList>
+
+#include "matrix.h"
+#include "fhatengine.h"
+#include "fftengine.h"
+
+namespace Matrix {
+
+    // Набор временных матриц одного вычисления экстремумов.
+    // Матрицы сохраняют выделенную память между вычислениями
+    // (см. Matrix2D::resize), поэтому повторное использование набора
+    // не приводит к обращениям к распределителю памяти.
+    struct ScratchBuffers {
+        Matrix2D<int> outMatrix;        // Результат свёртки (только для отладки)
+        Wavelet::FhatEngine fhatEngine; // Вычислитель свёртки вейвлета FHAT
+        Wavelet::FftEngine fftEngine;   // Вычислитель свёртки через БПФ
+
+        // Получить объём памяти, занятой набором, в байтах
+        size_t getBytes(void) const {
+            return outMatrix.getCapacityBytes() +
+                    fhatEngine.getBytes() +
+                    fftEngine.getBytes();
+        }
+    };
+
+
+    // Пул наборов временных матриц одного поиска.
+    // Каждый поток, выполняющий вычисление, берёт из пула свободный набор
+    // (acquire) и возвращает его по окончании (release), поэтому наборы
+    // никогда не используются двумя потоками одновременно, а их кол-во
+    // не превышает кол-ва одновременно выполняемых вычислений.
+    // По окончании поиска вся память освобождается вызовом clear().
+    // Пул потокобезопасен.
+    class ScratchPool {
+    public:
+        ScratchPool();
+        ~ScratchPool();
+
+        // Получить свободный набор временных матриц
+        ScratchBuffers* acquire(void);
+
+        // Вернуть набор в пул
+        void release(ScratchBuffers* buffers);
+
+        // Освободить память всех наборов.
+        // Все наборы должны быть возвращены в пул.
+        void clear(void);
+
+        // Получить максимальный объём памяти (в байтах), который одновременно
+        // занимали наборы пула с момента создания или последнего resetPeakBytes()
+        size_t getPeakBytes(void) const;
+
+        // Сбросить счётчик максимального объёма памяти
+        void resetPeakBytes(void);
+
+    private:
+        ScratchPool(const ScratchPool&);
+        ScratchPool& operator= (const ScratchPool&);
+
+        struct Slot {
+            ScratchBuffers buffers;
+            size_t bytes;           // Объём памяти набора на момент возврата в пул
+            Slot() : bytes(0) {}
+        };
+
+        mutable QMutex mutex;
+        QList<Slot*> allSlots;         // Все наборы пула
+        QList<Slot*> freeSlots;     // Свободные наборы
+        size_t totalBytes;          // Суммарный объём памяти наборов
+        size_t peakBytes;           // Максимальный суммарный объём памяти
+    };
+
+
+    // Захват набора временных матриц из пула на время жизни объекта
+    class ScratchLocker {
+    public:
+        explicit ScratchLocker(ScratchPool* p) : pool(p), buffers(p->acquire()) {}
+        ~ScratchLocker() { pool->release(buffers); }
+
+        ScratchBuffers* get(void) const { return buffers; }
+
+    private:
+        ScratchLocker(const ScratchLocker&);
+        ScratchLocker& operator= (const ScratchLocker&);
+
+        ScratchPool* pool;
+        ScratchBuffers* buffers;
+    };
+
+}   // namespace Matrix
+
+#endif // SCRATCHPOOL_H
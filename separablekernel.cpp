@@ -0,0 +1,256 @@
+#include "separablekernel.h"
+
+#include <cmath>
+
+#include "wavelet.h"
+
+using namespace Wavelet;
+
+namespace {
+
+    // Максимальное кол-во итераций степенного метода на одно слагаемое
+    const int Power_Iterations = 300;
+
+    // Порог сходимости степенного метода (относительное изменение сингулярного числа)
+    const double Power_Tolerance = 1e-12;
+
+}   // namespace
+
+
+// Разложить матрицу вейвлета на разделимые слагаемые
+void Wavelet::decomposeWavelet(SeparableKernel* out,
+                               const Matrix::MatrixView<const int>& wMatrix,
+                               int maxRank,
+                               double maxRelativeError)
+{
+    Q_ASSERT (out);
+    Q_ASSERT (!wMatrix.isNull());
+    Q_ASSERT (maxRank > 0);
+
+    const int wWidth = wMatrix.getWidth();
+    const int wHeight = wMatrix.getHeight();
+
+    out->wSize = wMatrix.getSize();
+    out->rank = 0;
+    out->vertical.clear();
+    out->horizontal.clear();
+    out->wSum = 0;
+
+    // Остаток приближения (изначально - сама матрица вейвлета)
+    Matrix::Matrix2D<double> residual(wMatrix.getSize());
+    double norm = 0.0;
+    for (int y = 0; y < wHeight; ++y) {
+        const int* wRow = wMatrix.getRow(y);
+        double* row = residual.getRow(y);
+        for (int x = 0; x < wWidth; ++x) {
+            row[x] = wRow[x];
+            norm += row[x] * row[x];
+            out->wSum += wRow[x];
+        }
+    }
+    norm = sqrt(norm);
+
+    QVector<double> u(wHeight), v(wWidth);
+    double residualNorm = norm;
+
+    while (out->rank < maxRank && residualNorm > maxRelativeError * norm && residualNorm > 0.0) {
+        // Начальное приближение - строка остатка с наибольшей нормой
+        int bestRow = 0;
+        double bestNorm = -1.0;
+        for (int y = 0; y < wHeight; ++y) {
+            const double* row = residual.getRow(y);
+            double n = 0.0;
+            for (int x = 0; x < wWidth; ++x)
+                n += row[x] * row[x];
+            if (n > bestNorm) {
+                bestNorm = n;
+                bestRow = y;
+            }
+        }
+        for (int x = 0; x < wWidth; ++x)
+            v[x] = residual.getRow(bestRow)[x] / sqrt(bestNorm);
+
+        // Степенной метод: u = R * v / |R * v|, v = R' * u / |R' * u|
+        double sigma = 0.0;
+        for (int it = 0; it < Power_Iterations; ++it) {
+            double un = 0.0;
+            for (int y = 0; y < wHeight; ++y) {
+                const double* row = residual.getRow(y);
+                double s = 0.0;
+                for (int x = 0; x < wWidth; ++x)
+                    s += row[x] * v[x];
+                u[y] = s;
+                un += s * s;
+            }
+            un = sqrt(un);
+            if (un == 0.0)
+                break;
+            for (int y = 0; y < wHeight; ++y)
+                u[y] /= un;
+
+            for (int x = 0; x < wWidth; ++x)
+                v[x] = 0.0;
+            for (int y = 0; y < wHeight; ++y) {
+                const double* row = residual.getRow(y);
+                for (int x = 0; x < wWidth; ++x)
+                    v[x] += row[x] * u[y];
+            }
+            double vn = 0.0;
+            for (int x = 0; x < wWidth; ++x)
+                vn += v[x] * v[x];
+            vn = sqrt(vn);
+            if (vn == 0.0)
+                break;
+            for (int x = 0; x < wWidth; ++x)
+                v[x] /= vn;
+
+            const bool converged = fabs(vn - sigma) <= Power_Tolerance * vn;
+            sigma = vn;
+            if (converged)
+                break;
+        }
+        if (sigma == 0.0)
+            break;
+
+        // Добавить слагаемое sigma * u * v' и вычесть его из остатка
+        residualNorm = 0.0;
+        for (int y = 0; y < wHeight; ++y) {
+            double* row = residual.getRow(y);
+            const double su = sigma * u[y];
+            out->vertical.append(su);
+            for (int x = 0; x < wWidth; ++x) {
+                row[x] -= su * v[x];
+                residualNorm += row[x] * row[x];
+            }
+        }
+        residualNorm = sqrt(residualNorm);
+        for (int x = 0; x < wWidth; ++x)
+            out->horizontal.append(v[x]);
+        ++out->rank;
+    }
+
+    // Отчёт о точности приближения
+    out->relativeError = (norm > 0.0) ? residualNorm / norm : 0.0;
+    out->maxAbsError = 0.0;
+    for (int y = 0; y < wHeight; ++y) {
+        const double* row = residual.getRow(y);
+        for (int x = 0; x < wWidth; ++x)
+            out->maxAbsError = qMax(out->maxAbsError, fabs(row[x]));
+    }
+}
+
+
+void Wavelet::imposeWavelet(Matrix::Matrix2D<int>* outMatrix,
+                            const Matrix::MatrixView<const int>& inMatrix,
+                            const SeparableKernel& kernel,
+                            int outsideValue,
+                            const QPoint& topLeft,
+                            const QPoint& bottomRight,
+                            Matrix::BorderMode borderMode)
+{
+    Q_ASSERT (outMatrix);
+    Q_ASSERT (!inMatrix.isNull());
+
+    const QRect region(getImposeRegion(inMatrix.getSize(), topLeft, bottomRight));
+    outMatrix->resize(region.size());
+    imposeWavelet(outMatrix->view(), inMatrix, kernel, outsideValue, region, borderMode);
+}
+
+
+void Wavelet::imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                            const Matrix::MatrixView<const int>& inMatrix,
+                            const SeparableKernel& kernel,
+                            int outsideValue,
+                            const QRect& region,
+                            Matrix::BorderMode borderMode)
+{
+    Q_ASSERT (!outMatrix.isNull());
+    Q_ASSERT (!inMatrix.isNull());
+    Q_ASSERT (!kernel.wSize.isEmpty());
+    Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+    Q_ASSERT (outMatrix.getSize() == region.size());
+
+    const int wWidth = kernel.wSize.width();
+    const int wHeight = kernel.wSize.height();
+    const int wXCenter = wWidth / 2;
+    const int wYCenter = wHeight / 2;
+    const long long wCount = wWidth * wHeight;
+
+    if (borderMode != Matrix::Border_Constant) {
+        // Дополнить данные за пределами матрицы, чтобы вейвлет не выходил за их границы
+        Matrix::Matrix2D<int> halo;
+        Matrix::padMatrix(&halo, inMatrix,
+                          region.adjusted(-wXCenter, -wYCenter,
+                                          wWidth - 1 - wXCenter, wHeight - 1 - wYCenter),
+                          borderMode);
+        imposeWavelet(outMatrix, halo, kernel, 0, QRect(QPoint(wXCenter, wYCenter), region.size()));
+        return;
+    }
+
+    const int inWidth = inMatrix.getWidth();
+    const int inHeight = inMatrix.getHeight();
+
+    // Строки данных, которые участвуют в вычислении области
+    const int rowFirst = qMax(0, region.top() - wYCenter);
+    const int rowLast = qMin(inHeight - 1, region.bottom() + wHeight - 1 - wYCenter);
+    const int rowCount = rowLast - rowFirst + 1;
+    const int outWidth = region.width();
+
+    // Значение outsideValue вычитается из данных, чтобы за пределами матрицы
+    // данные были нулевыми. Его вклад (по точному вейвлету) добавляется отдельно.
+    const long long outsideSum = kernel.wSum * outsideValue;
+
+    // Строка данных, дополненная нулями на ширину вейвлета
+    const int padLeft = wXCenter;
+    QVector<double> padded(outWidth + wWidth - 1);
+    // Результат прохода по строкам для одного слагаемого
+    Matrix::Matrix2D<double> hPass(QSize(outWidth, qMax(rowCount, 1)));
+    // Сумма по всем слагаемым
+    Matrix::Matrix2D<double> acc(region.size());
+    for (int oj = 0; oj < acc.getHeight(); ++oj)
+        for (int oi = 0; oi < outWidth; ++oi)
+            acc.getRow(oj)[oi] = 0.0;
+
+    for (int k = 0; k < kernel.rank; ++k) {
+        const double* h = kernel.getHorizontal(k);
+        const double* v = kernel.getVertical(k);
+
+        // Проход по строкам: свёртка строк данных со строкой слагаемого
+        for (int y = rowFirst; y <= rowLast; ++y) {
+            const int* inRow = inMatrix.getRow(y);
+            double* p = padded.data();
+            for (int t = 0; t < padded.size(); ++t) {
+                const int x = region.left() - padLeft + t;
+                p[t] = (x >= 0 && x < inWidth) ? inRow[x] - outsideValue : 0.0;
+            }
+            double* hRow = hPass.getRow(y - rowFirst);
+            for (int oi = 0; oi < outWidth; ++oi) {
+                double s = 0.0;
+                for (int wi = 0; wi < wWidth; ++wi)
+                    s += h[wi] * p[oi + wi];
+                hRow[oi] = s;
+            }
+        }
+
+        // Проход по столбцам: свёртка результата со столбцом слагаемого
+        for (int j = region.top(), oj = 0; j <= region.bottom(); ++j, ++oj) {
+            double* accRow = acc.getRow(oj);
+            for (int wj = 0; wj < wHeight; ++wj) {
+                const int y = j - wYCenter + wj;
+                if (y < rowFirst || y > rowLast)
+                    continue;
+                const double* hRow = hPass.getRow(y - rowFirst);
+                const double c = v[wj];
+                for (int oi = 0; oi < outWidth; ++oi)
+                    accRow[oi] += c * hRow[oi];
+            }
+        }
+    }
+
+    for (int oj = 0; oj < region.height(); ++oj) {
+        const double* accRow = acc.getRow(oj);
+        int* outRow = outMatrix.getRow(oj);
+        for (int oi = 0; oi < outWidth; ++oi)
+            outRow[oi] = (qRound64(accRow[oi]) + outsideSum) / wCount;
+    }
+}
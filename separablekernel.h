@@ -0,0 +1,75 @@
+#ifndef SEPARABLEKERNEL_H
+#define SEPARABLEKERNEL_H
+
+#include <QVector>
+#include <QRect>
+
+#include "matrix.h"
+#include "matrixutils.h"
+
+namespace Wavelet {
+
+    // Приближение матрицы вейвлета суммой rank разделимых слагаемых:
+    // w[y][x] ~ sum(k) vertical[k][y] * horizontal[k][x].
+    // Свёртка с каждым слагаемым вычисляется двумя одномерными проходами
+    // (по строкам и по столбцам), поэтому трудоёмкость на элемент
+    // равна примерно 2 * rank * K вместо K * K.
+    // Радиально-симметричные вейвлеты (см. getWavelet2dMatrix)
+    // хорошо приближаются небольшим кол-вом слагаемых, если они гладкие (MHAT);
+    // для вейвлетов с резкими границами (FHAT) требуется больший ранг.
+    struct SeparableKernel {
+        QSize wSize;                // Размер исходной матрицы вейвлета
+        int rank;                   // Кол-во слагаемых
+        QVector<double> vertical;   // Столбцы слагаемых (rank * высота), умноженные на сингулярные числа
+        QVector<double> horizontal; // Строки слагаемых (rank * ширина), нормированные
+        qint64 wSum;                // Сумма значений исходной матрицы вейвлета
+
+        // Отчёт о точности приближения:
+        double relativeError;       // Норма Фробениуса разности, делённая на норму вейвлета
+        double maxAbsError;         // Максимальная по модулю разность элементов
+
+        SeparableKernel() : rank(0), wSum(0), relativeError(0.0), maxAbsError(0.0) {}
+
+        // Получить столбец (высота элементов) слагаемого k
+        const double* getVertical(int k) const { return vertical.constData() + k * wSize.height(); }
+
+        // Получить строку (ширина элементов) слагаемого k
+        const double* getHorizontal(int k) const { return horizontal.constData() + k * wSize.width(); }
+    };
+
+
+    // Разложить матрицу вейвлета wMatrix на разделимые слагаемые
+    // (сингулярное разложение степенным методом с исчерпыванием).
+    // Слагаемые добавляются, пока их кол-во меньше maxRank
+    // и относительная ошибка приближения больше maxRelativeError.
+    // Ошибка полученного приближения записывается в out.
+    void decomposeWavelet(SeparableKernel* out,
+                          const Matrix::MatrixView<const int>& wMatrix,
+                          int maxRank,
+                          double maxRelativeError = 0.0);
+
+
+    // Наложить разделимое приближение вейвлета kernel на матрицу данных inMatrix
+    // (параметры см. в Wavelet::imposeWavelet).
+    // Результат приближённый: его отличие от точной свёртки ограничено
+    // ошибкой приближения вейвлета (kernel.maxAbsError * сумма модулей данных / кол-во элементов вейвлета).
+    void imposeWavelet(Matrix::Matrix2D<int>* outMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const SeparableKernel& kernel,
+                       int outsideValue = 0,
+                       const QPoint& topLeft = QPoint(-1, -1),
+                       const QPoint& bottomRight = QPoint(-1, -1),
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+
+    // Наложить разделимое приближение вейвлета на область region матрицы данных
+    // и записать результат в представление outMatrix размером region.
+    void imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const SeparableKernel& kernel,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+
+}   // namespace Wavelet
+
+#endif // SEPARABLEKERNEL_H
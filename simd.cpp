@@ -0,0 +1,120 @@
+#include "simd.h"
+
+#include <QAtomicInt>
+
+#if defined(SIMD_X86)
+#  if defined(Q_CC_MSVC)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+namespace {
+
+#if defined(SIMD_X86)
+    // Выполнить инструкцию cpuid для листа leaf и подлиста subleaf
+    void cpuid(int leaf, int subleaf, quint32 regs[4]) {
+#  if defined(Q_CC_MSVC)
+        int r[4];
+        __cpuidex(r, leaf, subleaf);
+        for (int i = 0; i < 4; ++i)
+            regs[i] = r[i];
+#  else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#  endif
+    }
+
+    // Прочитать регистр XCR0 (какие регистры сохраняет ОС при переключении задач)
+    quint64 readXcr0(void) {
+#  if defined(Q_CC_MSVC)
+        return _xgetbv(0);
+#  else
+        quint32 lo = 0, hi = 0;
+        __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return ((quint64) hi << 32) | lo;
+#  endif
+    }
+#endif
+
+    // Определить уровень поддержки SIMD-инструкций процессором и ОС
+    Simd::Level detectLevel(void) {
+#if defined(SIMD_X86)
+        quint32 regs[4];
+        cpuid(0, 0, regs);
+        const quint32 maxLeaf = regs[0];
+        if (maxLeaf < 1)
+            return Simd::Level_Scalar;
+
+        cpuid(1, 0, regs);
+        const bool sse41 = (regs[2] >> 19) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        const bool avx = (regs[2] >> 28) & 1;
+        if (!sse41)
+            return Simd::Level_Scalar;
+        if (!osxsave || !avx || maxLeaf < 7)
+            return Simd::Level_Sse41;
+
+        // ОС должна сохранять регистры XMM и YMM (биты 1 и 2)
+        const quint64 xcr0 = readXcr0();
+        if ((xcr0 & 0x6) != 0x6)
+            return Simd::Level_Sse41;
+
+        cpuid(7, 0, regs);
+        const bool avx2 = (regs[1] >> 5) & 1;
+        const bool avx512f = (regs[1] >> 16) & 1;
+        const bool avx512bw = (regs[1] >> 30) & 1;
+        if (!avx2)
+            return Simd::Level_Sse41;
+
+        // Для AVX-512 ОС должна сохранять регистры opmask и ZMM (биты 5, 6, 7)
+        if (avx512f && avx512bw && (xcr0 & 0xE0) == 0xE0)
+            return Simd::Level_Avx512;
+        return Simd::Level_Avx2;
+#else
+        return Simd::Level_Scalar;
+#endif
+    }
+
+    // Уровень, выбранный пользователем (-1 - не выбран)
+    QAtomicInt selectedLevel(-1);
+
+}   // namespace
+
+
+// Получить максимальный уровень, поддерживаемый процессором и ОС
+Simd::Level Simd::getSupportedLevel(void)
+{
+    static const Level supported = detectLevel();
+    return supported;
+}
+
+
+// Получить уровень, используемый вычислительными процедурами
+Simd::Level Simd::getLevel(void)
+{
+    const int selected = selectedLevel.load();
+    if (selected < 0)
+        return getSupportedLevel();
+    return (Level) selected;
+}
+
+
+// Ограничить уровень, используемый вычислительными процедурами
+void Simd::setLevel(Level level)
+{
+    selectedLevel.store(qMin(level, getSupportedLevel()));
+}
+
+
+// Получить название уровня
+const char* Simd::getLevelName(Level level)
+{
+    switch (level) {
+    case Level_Scalar: return "scalar";
+    case Level_Sse41: return "sse4.1";
+    case Level_Avx2: return "avx2";
+    case Level_Avx512: return "avx512";
+    }
+    return "unknown";
+}
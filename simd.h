@@ -0,0 +1,52 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <QtGlobal>
+
+// Определение поддерживаемых процессором наборов SIMD-инструкций
+// и выбор реализации вычислительных процедур во время выполнения.
+// Векторные реализации собираются для всех поддерживаемых наборов
+// (функции помечаются SIMD_TARGET), а вызываются только если
+// текущий процессор и операционная система их поддерживают,
+// поэтому одна сборка работает на любом процессоре x86.
+namespace Simd {
+
+    // Уровень поддержки SIMD-инструкций (каждый уровень включает предыдущие)
+    enum Level {
+        Level_Scalar = 0,   // Без векторных инструкций
+        Level_Sse41,        // SSE4.1
+        Level_Avx2,         // AVX2
+        Level_Avx512        // AVX-512F и AVX-512BW
+    };
+
+    // Получить максимальный уровень, поддерживаемый процессором и ОС
+    Level getSupportedLevel(void);
+
+    // Получить уровень, используемый вычислительными процедурами.
+    // По-умолчанию равен getSupportedLevel().
+    Level getLevel(void);
+
+    // Ограничить уровень, используемый вычислительными процедурами
+    // (например, для сравнения реализаций). Уровень не может быть выше
+    // поддерживаемого и при необходимости понижается до него.
+    void setLevel(Level level);
+
+    // Получить название уровня
+    const char* getLevelName(Level level);
+
+}   // namespace Simd
+
+
+// Пометка функции, использующей инструкции набора name
+// (например, SIMD_TARGET("avx2")). Компилятор MSVC не требует пометки.
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+#  define SIMD_TARGET(name) __attribute__((target(name)))
+#  define SIMD_X86
+#elif defined(Q_PROCESSOR_X86) && defined(Q_CC_MSVC)
+#  define SIMD_TARGET(name)
+#  define SIMD_X86
+#else
+#  define SIMD_TARGET(name)
+#endif
+
+#endif // SIMD_H
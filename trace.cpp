@@ -0,0 +1,270 @@
+#include "trace.h"
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QVector>
+
+using namespace Trace;
+
+namespace {
+
+    // Макс. кол-во интервалов в буфере одного потока
+    // (около 2 МБ на поток, далее учитываются только гистограммы)
+    const int Max_Thread_Events = 64 * 1024;
+
+    // Кол-во интервалов гистограммы: интервал b содержит длительности
+    // от 2^(b-1) до 2^b нс (последний - все более длинные)
+    const int Histogram_Buckets = 40;
+
+    const char* const Stage_Names[Stage_Count] = {
+        "decode", "imageToMatrix", "pyramid", "scale", "kernel", "impose", "refine", "search"
+    };
+
+
+    // Интервал этапа
+    struct Event {
+        quint64 start, end;     // Границы в тиках CTimer
+        int stage;
+        int diameter;           // Пометки Trace::Context
+        int iteration;
+    };
+
+
+    // Гистограмма длительностей этапа
+    struct Histogram {
+        quint64 count;
+        double totalNs, minNs, maxNs;
+        quint64 buckets[Histogram_Buckets];
+
+        Histogram() { clear(); }
+
+        void clear(void) {
+            count = 0;
+            totalNs = minNs = maxNs = 0.0;
+            for (int b = 0; b < Histogram_Buckets; ++b)
+                buckets[b] = 0;
+        }
+
+        void add(double ns) {
+            int b = 0;
+            for (quint64 v = (quint64) ns; v > 0 && b + 1 < Histogram_Buckets; v >>= 1)
+                ++b;
+            ++buckets[b];
+            minNs = (count == 0) ? ns : qMin(minNs, ns);
+            maxNs = qMax(maxNs, ns);
+            totalNs += ns;
+            ++count;
+        }
+
+        void merge(const Histogram& other) {
+            if (other.count == 0)
+                return;
+            minNs = (count == 0) ? other.minNs : qMin(minNs, other.minNs);
+            maxNs = qMax(maxNs, other.maxNs);
+            totalNs += other.totalNs;
+            count += other.count;
+            for (int b = 0; b < Histogram_Buckets; ++b)
+                buckets[b] += other.buckets[b];
+        }
+    };
+
+
+    // Буфер интервалов одного потока (пишет только этот поток)
+    struct ThreadLog {
+        int id;                             // Номер потока в трассе
+        QVector<Event> events;
+        quint64 dropped;                    // Кол-во интервалов сверх Max_Thread_Events
+        Histogram histograms[Stage_Count];
+        ThreadLog() : id(0), dropped(0) {}
+    };
+
+
+    QAtomicInt enabledFlag(0);
+
+    // Буферы всех потоков, когда-либо измерявших интервалы
+    // (не удаляются: потоки глобального пула живут до завершения процесса)
+    QMutex logsMutex;
+    QList<ThreadLog*> logs;
+
+    thread_local ThreadLog* threadLog = NULL;
+    thread_local int contextDiameter = -1;
+    thread_local int contextIteration = -1;
+
+
+    // Получить буфер текущего потока
+    ThreadLog* getThreadLog(void)
+    {
+        if (threadLog == NULL) {
+            ThreadLog* log = new ThreadLog;
+            QMutexLocker locker(&logsMutex);
+            log->id = logs.size() + 1;
+            logs.append(log);
+            threadLog = log;
+        }
+        return threadLog;
+    }
+
+
+    // Записать в out гистограммы, объединённые по всем потокам
+    void appendHistograms(QByteArray* out)
+    {
+        Histogram total[Stage_Count];
+        foreach (const ThreadLog* log, logs)
+            for (int s = 0; s < Stage_Count; ++s)
+                total[s].merge(log->histograms[s]);
+
+        out->append('{');
+        bool first = true;
+        for (int s = 0; s < Stage_Count; ++s) {
+            const Histogram& h = total[s];
+            if (h.count == 0)
+                continue;
+            if (!first)
+                out->append(',');
+            first = false;
+            out->append('"').append(Stage_Names[s]).append("\":{\"count\":")
+                    .append(QByteArray::number(h.count))
+                    .append(",\"totalMs\":").append(QByteArray::number(h.totalNs / 1e6, 'f', 6))
+                    .append(",\"minMs\":").append(QByteArray::number(h.minNs / 1e6, 'f', 6))
+                    .append(",\"maxMs\":").append(QByteArray::number(h.maxNs / 1e6, 'f', 6))
+                    .append(",\"buckets\":[");
+            bool firstBucket = true;
+            for (int b = 0; b < Histogram_Buckets; ++b) {
+                if (h.buckets[b] == 0)
+                    continue;
+                if (!firstBucket)
+                    out->append(',');
+                firstBucket = false;
+                out->append('[').append(QByteArray::number(Q_UINT64_C(1) << b))
+                        .append(',').append(QByteArray::number(h.buckets[b])).append(']');
+            }
+            out->append("]}");
+        }
+        out->append('}');
+    }
+
+}   // namespace
+
+
+const char* Trace::getStageName(Stage stage)
+{
+    Q_ASSERT (stage >= 0 && stage < Stage_Count);
+    return Stage_Names[stage];
+}
+
+
+void Trace::setEnabled(bool enabled)
+{
+    enabledFlag.store(enabled ? 1 : 0);
+}
+
+
+bool Trace::isEnabled(void)
+{
+    return enabledFlag.load() != 0;
+}
+
+
+void Trace::clear(void)
+{
+    QMutexLocker locker(&logsMutex);
+    foreach (ThreadLog* log, logs) {
+        log->events.clear();
+        log->dropped = 0;
+        for (int s = 0; s < Stage_Count; ++s)
+            log->histograms[s].clear();
+    }
+}
+
+
+// Учесть интервал этапа
+void Trace::record(Stage stage, quint64 start, quint64 end)
+{
+    Q_ASSERT (stage >= 0 && stage < Stage_Count);
+
+    ThreadLog* log = getThreadLog();
+    log->histograms[stage].add(CTimer::TicksToNsecs(end - start));
+    if (log->events.size() >= Max_Thread_Events) {
+        ++log->dropped;
+        return;
+    }
+
+    Event event;
+    event.start = start;
+    event.end = end;
+    event.stage = stage;
+    event.diameter = contextDiameter;
+    event.iteration = contextIteration;
+    log->events.append(event);
+}
+
+
+// Получить интервалы в формате Chrome Trace Event
+QByteArray Trace::toChromeTrace(void)
+{
+    QMutexLocker locker(&logsMutex);
+
+    // Время отсчитывается от начала самого раннего интервала
+    quint64 origin = 0;
+    bool hasEvents = false;
+    quint64 dropped = 0;
+    foreach (const ThreadLog* log, logs) {
+        dropped += log->dropped;
+        foreach (const Event& event, log->events) {
+            origin = hasEvents ? qMin(origin, event.start) : event.start;
+            hasEvents = true;
+        }
+    }
+
+    QByteArray out("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    foreach (const ThreadLog* log, logs) {
+        foreach (const Event& event, log->events) {
+            if (!first)
+                out.append(',');
+            first = false;
+            out.append("{\"name\":\"").append(Stage_Names[event.stage])
+                    .append("\",\"cat\":\"search\",\"ph\":\"X\",\"pid\":1,\"tid\":")
+                    .append(QByteArray::number(log->id))
+                    .append(",\"ts\":")
+                    .append(QByteArray::number(CTimer::TicksToNsecs(event.start - origin) / 1e3, 'f', 3))
+                    .append(",\"dur\":")
+                    .append(QByteArray::number(CTimer::TicksToNsecs(event.end - event.start) / 1e3, 'f', 3))
+                    .append(",\"args\":{\"diameter\":").append(QByteArray::number(event.diameter))
+                    .append(",\"iteration\":").append(QByteArray::number(event.iteration))
+                    .append("}}");
+        }
+    }
+    out.append("],\"droppedEvents\":").append(QByteArray::number(dropped));
+    out.append(",\"histograms\":");
+    appendHistograms(&out);
+    out.append("}\n");
+    return out;
+}
+
+
+// Получить гистограммы длительностей этапов
+QByteArray Trace::getHistograms(void)
+{
+    QMutexLocker locker(&logsMutex);
+    QByteArray out;
+    appendHistograms(&out);
+    return out;
+}
+
+
+Trace::Context::Context(int diameter, int iteration)
+    : prevDiameter(contextDiameter), prevIteration(contextIteration)
+{
+    contextDiameter = diameter;
+    contextIteration = iteration;
+}
+
+
+Trace::Context::~Context()
+{
+    contextDiameter = prevDiameter;
+    contextIteration = prevIteration;
+}
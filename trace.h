@@ -0,0 +1,112 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+#include "performancetimer.h"
+
+// Измерение времени этапов поиска.
+// Этап отмечается объектом Trace::Span на время его жизни. Длительности
+// этапов накапливаются в гистограммах (по степеням двойки наносекунд),
+// а сами интервалы - в буфере потока (не более Max_Thread_Events на поток,
+// далее учитываются только гистограммы). Каждый поток пишет только в свой
+// буфер, поэтому интервалы не требуют блокировок: при включённом измерении
+// интервал стоит два чтения таймера (см. CTimer), при выключенном - одну
+// проверку флага, и измерение можно не выключать в рабочем режиме.
+// Интервалы помечаются диаметром и шагом поиска, заданными объектом
+// Trace::Context в том же потоке (например, на время вычисления одного диаметра).
+//
+// Пример использования:
+// Trace::setEnabled(true);
+// {
+//     Trace::Span span(Trace::Stage_Impose);
+//     ...
+// }
+// file.write(Trace::toChromeTrace());      // chrome://tracing, Perfetto
+namespace Trace {
+
+    // Этапы поиска
+    enum Stage {
+        Stage_Decode,           // Загрузка изображения
+        Stage_ImageToMatrix,    // Преобразование изображения в матрицу
+        Stage_Pyramid,          // Построение пирамиды поиска
+        Stage_Scale,            // Масштабирование матрицы (Matrix::scaleMatrix)
+        Stage_Kernel,           // Построение матрицы вейвлета
+        Stage_Impose,           // Свёртка с вейвлетом и поиск экстремумов
+        Stage_Refine,           // Уточнение центра на более высоком разрешении
+        Stage_Search,           // Поиск в изображении целиком
+        Stage_Count
+    };
+
+    // Получить название этапа
+    const char* getStageName(Stage stage);
+
+    // Включить или выключить измерение (по-умолчанию выключено)
+    void setEnabled(bool enabled);
+
+    // Включено ли измерение
+    bool isEnabled(void);
+
+    // Удалить накопленные интервалы и гистограммы.
+    // Вызывается, когда интервалы не измеряются ни в одном потоке.
+    void clear(void);
+
+    // Получить интервалы в формате Chrome Trace Event (JSON) вместе
+    // с гистограммами длительностей этапов (ключ "histograms", см. getHistograms).
+    // Вызывается, когда интервалы не измеряются ни в одном потоке.
+    QByteArray toChromeTrace(void);
+
+    // Получить гистограммы длительностей этапов (JSON):
+    // {"<этап>": {"count", "totalMs", "minMs", "maxMs",
+    //             "buckets": [[<верхняя граница, нс>, <кол-во>], ...]}}
+    QByteArray getHistograms(void);
+
+
+    // Учесть интервал этапа stage, начавшийся в момент start (см. CTimer::GetCounter)
+    void record(Stage stage, quint64 start, quint64 end);
+
+
+    /*!
+     * \brief The Span класс интервала этапа поиска: время от создания
+     * до удаления объекта учитывается для этапа stage
+     * (если измерение было включено при создании).
+     */
+    class Span {
+    public:
+        explicit Span(Stage stage)
+            : stage(stage), start(isEnabled() ? CTimer::GetCounter() : 0) {}
+        ~Span() {
+            if (start != 0)
+                record(stage, start, CTimer::GetCounter());
+        }
+
+    private:
+        Span(const Span&);
+        Span& operator= (const Span&);
+
+        Stage stage;
+        quint64 start;      // Начало интервала (0 - не измеряется)
+    };
+
+
+    /*!
+     * \brief The Context класс пометок интервалов потока: на время жизни
+     * объекта интервалы этого потока помечаются диаметром (в пикселах)
+     * и шагом поиска (-1 - без пометки). Объекты могут быть вложены.
+     */
+    class Context {
+    public:
+        Context(int diameter, int iteration);
+        ~Context();
+
+    private:
+        Context(const Context&);
+        Context& operator= (const Context&);
+
+        int prevDiameter, prevIteration;   // Пометки внешнего объекта
+    };
+
+}   // namespace Trace
+
+#endif // TRACE_H
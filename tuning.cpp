@@ -0,0 +1,298 @@
+#include "tuning.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QStandardPaths>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QVector>
+#include <cmath>
+
+#include "matrix.h"
+#include "wavelet.h"
+#include "matrixutils.h"
+#include "fhatengine.h"
+#include "fftengine.h"
+#include "circlesearch.h"
+#include "detector.h"
+#include "simd.h"
+#include "parallel.h"
+#include "performancetimer.h"
+
+using namespace Tuning;
+
+namespace {
+
+    // Допустимые пределы параметров профиля
+    const int Min_Performance_Criteria = 16;
+    const int Max_Performance_Criteria = 128;
+    const int Max_Fft_Ops_Per_Element_Log = 64;
+    const int Min_Tile_Size = 256;
+    const int Max_Tile_Size = 16384;
+
+    // Проверяемые критерии производительности (по возрастанию).
+    // Время поиска растёт вместе с критерием, поэтому проверка прекращается
+    // на первом критерии, превысившем целевое время.
+    const int Criteria_Candidates[] = {32, 40, 48, 56, 64, 80, 96, 128};
+
+    // Проверяемые стороны плиток (по возрастанию). Сравниваются только плитки,
+    // которые вместе с перекрытием ищутся в исходном разрешении (не больше
+    // CircleSearch::Max_Search_Elements элементов, иначе первые октавы пирамиды
+    // пропускаются): время поиска в плитках разного разрешения несравнимо,
+    // т.к. большие плитки ищутся грубее и поэтому быстрее.
+    const int Tile_Candidates[] = {1024, 2048, 3072, 4096};
+
+    // Сторона матрицы данных и половина стороны матрицы вейвлета при замере
+    // свёртки (как в поиске: свёртка вычисляется на уменьшенной матрице)
+    const int Convolution_Side = 256;
+    const int Convolution_Wavelet_Size = 64;
+
+    // Кол-во повторений каждого замера (берётся наименьшее время)
+    const int Calibration_Repeats = 3;
+
+    // Относительный диаметр шарика и ширина размытой границы в пикселах
+    // синтетического кадра
+    const float Frame_Diameter = 0.2;
+    const float Frame_Blur = 2.0;
+
+    // Яркость фона и шарика синтетического кадра
+    const int Dark_Level = 20;
+    const int Bright_Level = 230;
+
+    // Масштаб значений вейвлета (как в CircleSearch)
+    const float Wavelet_Ratio = 1000.0;
+
+    // Имя файла профиля в каталоге настроек
+    const char* const Profile_File = "ImageWavelet/tuning.json";
+
+    // Текущий профиль
+    Profile currentProfile;
+
+
+    // Ограничить значения профиля допустимыми пределами
+    Profile bounded(const Profile& profile)
+    {
+        Profile result(profile);
+        result.performanceCriteria = qBound(Min_Performance_Criteria, profile.performanceCriteria,
+                                            Max_Performance_Criteria);
+        result.fftOpsPerElementLog = qBound(1, profile.fftOpsPerElementLog, Max_Fft_Ops_Per_Element_Log);
+        result.tileSize = qBound(Min_Tile_Size, profile.tileSize, Max_Tile_Size);
+        result.targetMs = qMax(0.0, profile.targetMs);
+        return result;
+    }
+
+
+    QJsonObject toObject(const Profile& profile)
+    {
+        QJsonObject object;
+        object.insert("performanceCriteria", profile.performanceCriteria);
+        object.insert("fftOpsPerElementLog", profile.fftOpsPerElementLog);
+        object.insert("tileSize", profile.tileSize);
+        object.insert("targetMs", profile.targetMs);
+        // Для справки: машина, на которой подобран профиль
+        object.insert("simd", QString(Simd::getLevelName(Simd::getLevel())));
+        object.insert("threads", Parallel::getThreadCount());
+        return object;
+    }
+
+
+    // Построить кадр размером size со светлым шариком на тёмном фоне
+    void makeFrame(QVector<quint8>* frame, const QSize& size)
+    {
+        frame->resize(size.width() * size.height());
+        const float radius = Frame_Diameter * qMin(size.width(), size.height()) / 2;
+        const QPointF center(size.width() * 0.45, size.height() * 0.55);
+        quint8* data = frame->data();
+        Parallel::forRange(0, size.height(), 64, [&](int first, int last) {
+            for (int y = first; y < last; ++y) {
+                quint8* row = data + (qint64) y * size.width();
+                const float dy = y + 0.5 - center.y();
+                for (int x = 0; x < size.width(); ++x) {
+                    const float dx = x + 0.5 - center.x();
+                    const float d = sqrt(dx * dx + dy * dy);
+                    const float coverage = qBound(0.0f, (radius - d) / Frame_Blur + 0.5f, 1.0f);
+                    row[x] = (quint8) qRound(Dark_Level + (Bright_Level - Dark_Level) * coverage);
+                }
+            }
+        });
+    }
+
+
+    // Получить наименьшее время выполнения fun из Calibration_Repeats повторений в мс
+    template <class F>
+    double measure(F fun)
+    {
+        double best = -1.0;
+        for (int r = 0; r < Calibration_Repeats; ++r) {
+            CTimer timer;
+            timer.Start();
+            fun();
+            const double ms = timer.Time() * 1e3;
+            best = (best < 0) ? ms : qMin(best, ms);
+        }
+        return best;
+    }
+
+
+    // Подобрать трудоёмкость свёртки через БПФ в единицах обращения
+    // к префиксной сумме по времени свёртки обоими способами
+    int calibrateFft(void)
+    {
+        // Свёртка 8-битной матрицы с поиском экстремумов, как в поиске
+        const QSize size(Convolution_Side, Convolution_Side);
+        QVector<quint8> frame;
+        makeFrame(&frame, size);
+        const Matrix::MatrixView<const quint8> in(frame.constData(), size, size.width());
+        const QRect region(QPoint(0, 0), size);
+
+        Matrix::Matrix2D<int> kernel;
+        Wavelet::getWavelet2dMatrix<int>(&kernel, Wavelet::Fhat2d(), Convolution_Wavelet_Size, Wavelet_Ratio);
+
+        Wavelet::FhatEngine fhatEngine;
+        fhatEngine.setInput(in, 255);
+        fhatEngine.setWavelet(kernel);
+        const double fhatMs = measure([&]() {
+            Matrix::ExtremumsAccumulator found(Wavelet_Ratio * 255, -Wavelet_Ratio * 255);
+            fhatEngine.impose(&found, region);
+        });
+
+        Wavelet::FftEngine fftEngine;
+        const double fftMs = measure([&]() {
+            Matrix::ExtremumsAccumulator found(Wavelet_Ratio * 255, -Wavelet_Ratio * 255);
+            fftEngine.impose(&found, in, kernel, 255, region);
+        });
+
+        // Время одного обращения к префиксной сумме (см. CircleSearch::getConvolutionCost)
+        const double count = (double) size.width() * size.height();
+        const double tapMs = fhatMs / ((double) kernel.getHeight() * CircleSearch::Fhat_Taps_Per_Row * count);
+        if (tapMs <= 0.0)
+            return Profile().fftOpsPerElementLog;
+        return qRound(fftMs / (tapMs * log2(count) * count));
+    }
+
+
+    // Получить время поиска в кадре frame размером size в мс
+    double measureSearch(const QVector<quint8>& frame, const QSize& size)
+    {
+        // Первый поиск строит матрицы вейвлетов (в замер не входит)
+        Detector::detect(frame.constData(), size.width(), size.height(), size.width());
+        return measure([&]() {
+            Detector::detect(frame.constData(), size.width(), size.height(), size.width());
+        });
+    }
+
+
+}   // namespace
+
+
+const Profile& Tuning::getProfile(void)
+{
+    return currentProfile;
+}
+
+
+void Tuning::setProfile(const Profile& profile)
+{
+    currentProfile = bounded(profile);
+}
+
+
+QString Tuning::getDefaultPath(void)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) + '/' + Profile_File;
+}
+
+
+bool Tuning::load(const QString& path, Profile* profile)
+{
+    Q_ASSERT (profile);
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QJsonParseError error;
+    const QJsonDocument document(QJsonDocument::fromJson(file.readAll(), &error));
+    if (error.error != QJsonParseError::NoError || !document.isObject())
+        return false;
+    const QJsonObject object(document.object());
+    if (!object.contains("performanceCriteria"))
+        return false;
+
+    // Отсутствующие параметры (например, из профиля прежней версии) - по-умолчанию
+    const Profile defaults;
+    Profile result;
+    result.performanceCriteria = object.value("performanceCriteria").toInt(defaults.performanceCriteria);
+    result.fftOpsPerElementLog = object.value("fftOpsPerElementLog").toInt(defaults.fftOpsPerElementLog);
+    result.tileSize = object.value("tileSize").toInt(defaults.tileSize);
+    result.targetMs = object.value("targetMs").toDouble(defaults.targetMs);
+    *profile = bounded(result);
+    return true;
+}
+
+
+bool Tuning::save(const QString& path, const Profile& profile)
+{
+    if (!QDir().mkpath(QFileInfo(path).absolutePath()))
+        return false;
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(QJsonDocument(toObject(profile)).toJson(QJsonDocument::Indented)) >= 0;
+}
+
+
+QByteArray Tuning::toJson(const Profile& profile)
+{
+    return QJsonDocument(toObject(profile)).toJson(QJsonDocument::Compact);
+}
+
+
+Profile Tuning::calibrate(double targetMs, const QSize& frameSize)
+{
+    Q_ASSERT (targetMs > 0.0);
+    Q_ASSERT (!frameSize.isEmpty());
+
+    const Profile previous(currentProfile);
+    Profile profile;
+    profile.targetMs = targetMs;
+
+    // Переход от свёртки по префиксным суммам к свёртке через БПФ
+    profile.fftOpsPerElementLog = calibrateFft();
+    currentProfile = bounded(profile);
+
+    // Наибольший критерий, при котором поиск в кадре укладывается в целевое время
+    // (если не укладывается ни один - наименьший)
+    QVector<quint8> frame;
+    makeFrame(&frame, frameSize);
+    const int criteriaCount = sizeof(Criteria_Candidates) / sizeof(Criteria_Candidates[0]);
+    profile.performanceCriteria = Criteria_Candidates[0];
+    for (int c = 0; c < criteriaCount; ++c) {
+        currentProfile.performanceCriteria = Criteria_Candidates[c];
+        if (measureSearch(frame, frameSize) > targetMs)
+            break;
+        profile.performanceCriteria = Criteria_Candidates[c];
+    }
+    currentProfile = bounded(profile);
+
+    // Наибольшая плитка, поиск в которой (вместе с перекрытием) укладывается
+    // в целевое время: при равном разрешении большие плитки дают меньше
+    // перекрытий на пиксел изображения. Память плитки ограничена
+    // Max_Search_Elements (если не укладывается ни одна - наименьшая)
+    const int halo = Detector::getTileHalo(Detector::TileOptions().maxDiameter);
+    const int tileCount = sizeof(Tile_Candidates) / sizeof(Tile_Candidates[0]);
+    profile.tileSize = Tile_Candidates[0];
+    for (int t = 0; t < tileCount; ++t) {
+        const QSize tileSize(Tile_Candidates[t] + 2 * halo, Tile_Candidates[t] + 2 * halo);
+        if ((qint64) tileSize.width() * tileSize.height() > CircleSearch::Max_Search_Elements)
+            break;
+        makeFrame(&frame, tileSize);
+        if (measureSearch(frame, tileSize) > targetMs)
+            break;
+        profile.tileSize = Tile_Candidates[t];
+    }
+
+    currentProfile = previous;
+    return bounded(profile);
+}
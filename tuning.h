@@ -0,0 +1,89 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <QString>
+#include <QSize>
+#include <QByteArray>
+
+// Параметры производительности поиска, зависящие от вычислительной машины
+// (профиль машины). По-умолчанию используются значения, подобранные
+// для типичного процессора; функция calibrate подбирает их по замерам
+// на текущей машине, а save и load сохраняют профиль в файле
+// (например, при первом запуске и при каждом запуске соответственно).
+//
+// Профиль задаётся до начала поиска: CircleSearch и Detector читают его
+// без блокировки, поэтому setProfile нельзя вызывать во время поиска.
+//
+// Пример использования (при запуске приложения):
+// Tuning::Profile profile;
+// if (Tuning::load(Tuning::getDefaultPath(), &profile))
+//     Tuning::setProfile(profile);
+namespace Tuning {
+
+    // Профиль производительности
+    struct Profile {
+        // Критерий оптимальной производительности при выборе размера матрицы
+        // данных и матрицы вейвлета: допустимая трудоёмкость свёртки -
+        // performanceCriteria ^ 4 операций (см. CircleSearch::getOptimumSizes).
+        // Чем больше критерий - тем точнее вычисления, но скорость вычислений падает.
+        int performanceCriteria;
+
+        // Трудоёмкость свёртки через БПФ на элемент матрицы данных, делённая
+        // на log2 кол-ва элементов, в единицах обращения к префиксной сумме
+        // (определяет переход от свёртки по префиксным суммам к свёртке
+        // через БПФ, см. CircleSearch::getConvolutionCost)
+        int fftOpsPerElementLog;
+
+        // Сторона плитки при поиске по плиткам (см. Detector::TileOptions)
+        int tileSize;
+
+        // Целевое время поиска в мс, для которого подобран профиль (0 - не подбирался)
+        double targetMs;
+
+        Profile() : performanceCriteria(64), fftOpsPerElementLog(8), tileSize(2048), targetMs(0.0) {}
+    };
+
+    // Получить текущий профиль
+    const Profile& getProfile(void);
+
+    // Задать текущий профиль (значения ограничиваются допустимыми пределами)
+    void setProfile(const Profile& profile);
+
+    // Получить путь к файлу профиля по-умолчанию
+    // (общий для приложений ImageWavelet в каталоге настроек пользователя)
+    QString getDefaultPath(void);
+
+    // Загрузить профиль из файла path (JSON).
+    // Возвращает false, если файл не найден или не содержит профиля.
+    bool load(const QString& path, Profile* profile);
+
+    // Сохранить профиль в файл path (каталоги создаются при необходимости)
+    bool save(const QString& path, const Profile& profile);
+
+    // Получить профиль в формате JSON
+    QByteArray toJson(const Profile& profile);
+
+    /*!
+     * \brief calibrate - подобрать профиль по замерам на текущей машине.
+     * Сначала по времени свёртки по префиксным суммам и через БПФ
+     * определяется переход между ними, затем выбирается наибольший критерий
+     * производительности, при котором поиск в синтетическом кадре размером
+     * frameSize занимает не более targetMs. Затем выбирается наибольшая
+     * сторона плитки, при которой поиск в одной плитке с перекрытием
+     * занимает не более targetMs. Плитки больше CircleSearch::Max_Search_Elements
+     * (вместе с перекрытием) не рассматриваются: они ищутся с пропуском октав
+     * пирамиды, т.е. в меньшем разрешении, поэтому их время несравнимо
+     * с временем меньших плиток. Тем самым ограничивается и расход памяти
+     * плиткой (для перекрытия по-умолчанию - не больше 3072x3072 без перекрытия).
+     * Замеры занимают от нескольких секунд до минуты и используют
+     * глобальный пул потоков. Текущий профиль при этом изменяется
+     * и после замеров восстанавливается.
+     * \param targetMs - целевое время поиска в одном кадре в мс
+     * \param frameSize - размер типичного кадра
+     * \return подобранный профиль (не устанавливается как текущий)
+     */
+    Profile calibrate(double targetMs, const QSize& frameSize = QSize(1920, 1080));
+
+}   // namespace Tuning
+
+#endif // TUNING_H
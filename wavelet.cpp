@@ -1,17 +1,350 @@
 #include "wavelet.h"
 
+#include <QVector>
+#include <climits>
+
+#include "waveletsimd.h"
+#include "parallel.h"
+
 using namespace Wavelet;
 
+namespace {
+
+    // Объём данных одной полосы строк результата (кеш второго уровня)
+    const int Band_Cache_Bytes = 256 * 1024;
+
+    // Минимальная высота полосы строк результата
+    const int Min_Band_Rows = 4;
+
+    // Ненулевые элементы матрицы вейвлета
+    struct WaveletTaps {
+        QVector<QPoint> points;     // Координаты элементов в матрице вейвлета
+        QVector<qint32> coefs;      // Значения элементов
+        qint64 absSum;              // Сумма модулей значений
+    };
+
+
+    void getWaveletTaps(WaveletTaps* taps, const Matrix::MatrixView<const int>& wMatrix)
+    {
+        taps->points.clear();
+        taps->coefs.clear();
+        taps->absSum = 0;
+        for (int wj = 0; wj < wMatrix.getHeight(); ++wj) {
+            const int* wRow = wMatrix.getRow(wj);
+            for (int wi = 0; wi < wMatrix.getWidth(); ++wi)
+                if (wRow[wi] != 0) {
+                    taps->points.append(QPoint(wi, wj));
+                    taps->coefs.append(wRow[wi]);
+                    taps->absSum += qAbs((qint64) wRow[wi]);
+                }
+        }
+    }
+
+
+    // Вычислить свёртку области region без проверок выхода за границы
+    // для матрицы данных любого типа (см. Wavelet::imposeInner)
+    template <class T>
+    void imposeInnerRows(const Matrix::MatrixView<int>& outMatrix,
+                         const Matrix::MatrixView<const T>& inMatrix,
+                         const Matrix::MatrixView<const int>& wMatrix,
+                         const QRect& region);
+
+
+    // Вычислить свёртку полосы строк region (см. Wavelet::imposeWavelet)
+    template <class T>
+    void imposeBand(const Matrix::MatrixView<int>& outMatrix,
+                    const Matrix::MatrixView<const T>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue,
+                    const QRect& region,
+                    Matrix::BorderMode borderMode);
+
+
+    // Вычислить свёртку области region по полосам строк
+    // (outMatrix и extremums могут быть не заданы, см. Wavelet::imposeWavelet)
+    template <class T>
+    void imposeBands(const Matrix::MatrixView<int>& outMatrix,
+                     const Matrix::MatrixView<const T>& inMatrix,
+                     const Matrix::MatrixView<const int>& wMatrix,
+                     int outsideValue,
+                     const QRect& region,
+                     Matrix::BorderMode borderMode,
+                     Matrix::ExtremumsAccumulator* extremums);
+
+}   // namespace
+
+
+QRect Wavelet::getImposeRegion(const QSize& inSize,
+                               const QPoint& topLeft,
+                               const QPoint& bottomRight)
+{
+    Q_ASSERT (!inSize.isEmpty());
+
+    if (topLeft == QPoint(-1, -1) &&
+        bottomRight == QPoint(-1, -1))
+        return QRect(QPoint(0, 0), inSize);
+
+    // Ограничить координаты размерами матрицы
+    const int inLeft = qBound(0, topLeft.x(), inSize.width() - 1);
+    const int inTop = qBound(0, topLeft.y(), inSize.height() - 1);
+    const int inRight = qBound(inLeft, bottomRight.x(), inSize.width() - 1);
+    const int inBottom = qBound(inTop, bottomRight.y(), inSize.height() - 1);
+
+    return QRect(QPoint(inLeft, inTop), QPoint(inRight, inBottom));
+}
+
+
 void Wavelet::imposeWavelet(Matrix::Matrix2D<int>* outMatrix,
-                   const Matrix::Matrix2D<int>& inMatrix,
-                   const Matrix::Matrix2D<int>& wMatrix,
+                   const Matrix::MatrixView<const int>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
                    int outsideValue,
                    const QPoint& topLeft,
-                   const QPoint& bottomRight)
+                   const QPoint& bottomRight,
+                   Matrix::BorderMode borderMode)
 {
     Q_ASSERT (outMatrix);
     Q_ASSERT (!inMatrix.isNull());
-    Q_ASSERT (!wMatrix.isNull());
+
+    // Обрабатываемые элементы исходного изображения
+    const QRect region(getImposeRegion(inMatrix.getSize(), topLeft, bottomRight));
+
+    // Размер выходной матрицы
+    outMatrix->resize(region.size());
+
+    imposeWavelet(outMatrix->view(), inMatrix, wMatrix, outsideValue, region, borderMode);
+}
+
+
+namespace {
+
+    // Вычислить свёртку области region в представление outMatrix
+    // (см. Wavelet::imposeWavelet)
+    template <class T>
+    void imposeRegion(const Matrix::MatrixView<int>& outMatrix,
+                      const Matrix::MatrixView<const T>& inMatrix,
+                      const Matrix::MatrixView<const int>& wMatrix,
+                      int outsideValue,
+                      const QRect& region,
+                      Matrix::BorderMode borderMode)
+    {
+        Q_ASSERT (!outMatrix.isNull());
+        Q_ASSERT (!inMatrix.isNull());
+        Q_ASSERT (!wMatrix.isNull());
+        Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+        Q_ASSERT (outMatrix.getSize() == region.size());
+
+        imposeBands(outMatrix, inMatrix, wMatrix, outsideValue, region, borderMode, NULL);
+    }
+
+
+    // Вычислить свёртку области region с поиском экстремумов
+    // (см. Wavelet::imposeWavelet)
+    template <class T>
+    void imposeExtremums(Matrix::ExtremumsAccumulator* extremums,
+                         const Matrix::MatrixView<const T>& inMatrix,
+                         const Matrix::MatrixView<const int>& wMatrix,
+                         int outsideValue,
+                         const QRect& region,
+                         Matrix::BorderMode borderMode,
+                         const Matrix::MatrixView<int>& outMatrix)
+    {
+        Q_ASSERT (extremums);
+        Q_ASSERT (!inMatrix.isNull());
+        Q_ASSERT (!wMatrix.isNull());
+        Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(region));
+        Q_ASSERT (outMatrix.isNull() || outMatrix.getSize() == region.size());
+
+        imposeBands(outMatrix, inMatrix, wMatrix, outsideValue, region, borderMode, extremums);
+    }
+
+}   // namespace
+
+
+void Wavelet::imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                   const Matrix::MatrixView<const int>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode)
+{
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, borderMode);
+}
+
+
+void Wavelet::imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                   const Matrix::MatrixView<const quint16>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode)
+{
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, borderMode);
+}
+
+
+void Wavelet::imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                   const Matrix::MatrixView<const quint8>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode)
+{
+    imposeRegion(outMatrix, inMatrix, wMatrix, outsideValue, region, borderMode);
+}
+
+
+void Wavelet::imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                   const Matrix::MatrixView<const int>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode,
+                   const Matrix::MatrixView<int>& outMatrix)
+{
+    imposeExtremums(extremums, inMatrix, wMatrix, outsideValue, region, borderMode, outMatrix);
+}
+
+
+void Wavelet::imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                   const Matrix::MatrixView<const quint16>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode,
+                   const Matrix::MatrixView<int>& outMatrix)
+{
+    imposeExtremums(extremums, inMatrix, wMatrix, outsideValue, region, borderMode, outMatrix);
+}
+
+
+void Wavelet::imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                   const Matrix::MatrixView<const quint8>& inMatrix,
+                   const Matrix::MatrixView<const int>& wMatrix,
+                   int outsideValue,
+                   const QRect& region,
+                   Matrix::BorderMode borderMode,
+                   const Matrix::MatrixView<int>& outMatrix)
+{
+    imposeExtremums(extremums, inMatrix, wMatrix, outsideValue, region, borderMode, outMatrix);
+}
+
+
+namespace {
+
+    // Вычислить свёртку области region по полосам строк
+    template <class T>
+    void imposeBands(const Matrix::MatrixView<int>& outMatrix,
+                     const Matrix::MatrixView<const T>& inMatrix,
+                     const Matrix::MatrixView<const int>& wMatrix,
+                     int outsideValue,
+                     const QRect& region,
+                     Matrix::BorderMode borderMode,
+                     Matrix::ExtremumsAccumulator* extremums)
+    {
+        // Полосы строк результата вычисляются параллельно. Высота полосы выбирается
+        // так, чтобы строки данных, участвующие в её вычислении, помещались в кеш.
+        const int rowBytes = (region.width() + wMatrix.getWidth()) * sizeof(T);
+        const int maxRows = qMax(1, Band_Cache_Bytes / rowBytes - wMatrix.getHeight());
+        const int chunk = Parallel::getChunkSize(region.height(), Min_Band_Rows, maxRows);
+
+        // Экстремумы каждой полосы находятся отдельно и объединяются после вычисления
+        QVector<Matrix::ExtremumsAccumulator> bandExtremums;
+        if (extremums)
+            bandExtremums.fill(Matrix::ExtremumsAccumulator(extremums->minVal, extremums->maxVal),
+                               (region.height() + chunk - 1) / chunk);
+        Matrix::ExtremumsAccumulator* parts = bandExtremums.data();
+
+        Parallel::forRange(region.top(), region.bottom() + 1, chunk, [&](int first, int last) {
+            const QRect band(QPoint(region.left(), first), QPoint(region.right(), last - 1));
+
+            // Если матрица результата не сохраняется, то полоса
+            // вычисляется во временную матрицу размером с полосу
+            Matrix::Matrix2D<int> bandMatrix;
+            Matrix::MatrixView<int> bandView;
+            if (outMatrix.isNull()) {
+                bandMatrix.resize(band.size());
+                bandView = bandMatrix.view();
+            }
+            else
+                bandView = outMatrix.region(band.translated(-region.topLeft()));
+
+            imposeBand(bandView, inMatrix, wMatrix, outsideValue, band, borderMode);
+
+            if (extremums) {
+                Matrix::ExtremumsAccumulator* part = &parts[(first - region.top()) / chunk];
+                for (int y = 0; y < bandView.getHeight(); ++y)
+                    part->addRow(bandView.getRow(y), bandView.getWidth(), 0, first - region.top() + y);
+            }
+        });
+
+        for (int b = 0; b < bandExtremums.size(); ++b)
+            extremums->merge(bandExtremums.at(b));
+    }
+
+
+    // Вычислить свёртку полосы строк
+    template <class T>
+    void imposeBand(const Matrix::MatrixView<int>& outMatrix,
+                    const Matrix::MatrixView<const T>& inMatrix,
+                    const Matrix::MatrixView<const int>& wMatrix,
+                    int outsideValue,
+                    const QRect& region,
+                    Matrix::BorderMode borderMode)
+    {
+        const int wWidth = wMatrix.getWidth();
+        const int wHeight = wMatrix.getHeight();
+        const int wXCenter = wWidth / 2;
+        const int wYCenter = wHeight / 2;
+
+        // Внутренняя область: вейвлет целиком лежит внутри матрицы данных
+        const QRect inner(region.intersected(QRect(QPoint(wXCenter, wYCenter),
+                                                   QPoint(inMatrix.getWidth() - wWidth + wXCenter,
+                                                          inMatrix.getHeight() - wHeight + wYCenter))));
+        if (!inner.isEmpty())
+            imposeInnerRows(outMatrix.region(inner.translated(-region.topLeft())), inMatrix, wMatrix, inner);
+        if (inner == region)
+            return;
+
+        // Граничные полосы сверху, снизу, слева и справа от внутренней области
+        // (если внутренняя область пуста - вся область целиком)
+        QVector<QRect> borders;
+        if (inner.isEmpty())
+            borders << region;
+        else
+            borders << QRect(QPoint(region.left(), region.top()), QPoint(region.right(), inner.top() - 1))
+                    << QRect(QPoint(region.left(), inner.bottom() + 1), QPoint(region.right(), region.bottom()))
+                    << QRect(QPoint(region.left(), inner.top()), QPoint(inner.left() - 1, inner.bottom()))
+                    << QRect(QPoint(inner.right() + 1, inner.top()), QPoint(region.right(), inner.bottom()));
+
+        // Данные для граничной полосы дополняются за пределами матрицы
+        // согласно borderMode, после чего вейвлет целиком лежит внутри дополненных данных
+        Matrix::Matrix2D<T> halo;
+        for (int b = 0; b < borders.size(); ++b) {
+            const QRect& border = borders.at(b);
+            if (!border.isValid())
+                continue;
+            Matrix::padMatrix(&halo, inMatrix,
+                              border.adjusted(-wXCenter, -wYCenter,
+                                              wWidth - 1 - wXCenter, wHeight - 1 - wYCenter),
+                              borderMode, outsideValue);
+            imposeInnerRows(outMatrix.region(border.translated(-region.topLeft())),
+                            Matrix::MatrixView<const T>(halo), wMatrix,
+                            QRect(QPoint(wXCenter, wYCenter), border.size()));
+        }
+    }
+
+}   // namespace
+
+
+// Вычислить свёртку области region без оптимизаций (эталонная реализация)
+void Wavelet::imposeReference(const Matrix::MatrixView<int>& outMatrix,
+                              const Matrix::MatrixView<const int>& inMatrix,
+                              const Matrix::MatrixView<const int>& wMatrix,
+                              int outsideValue,
+                              const QRect& region,
+                              Matrix::BorderMode borderMode)
+{
+    Q_ASSERT (outMatrix.getSize() == region.size());
 
     // Константы матрицы вейвлета
     const int wWidth = wMatrix.getWidth();
@@ -23,74 +356,110 @@ void Wavelet::imposeWavelet(Matrix::Matrix2D<int>* outMatrix,
     const int inWidth = inMatrix.getWidth();
     const int inHeight = inMatrix.getHeight();
 
-    // Обрабатываемые элементы исходного изображения
-    int inLeft = 0, inTop = 0;          // Элемент левого верхнего угла
-    int inRight = 0, inBottom = 0;      // Элемент правого нижнего угла
-
-    if (topLeft == QPoint(-1, -1) &&
-        bottomRight == QPoint(-1, -1)) {
-        inLeft = 0;
-        inRight = inWidth - 1;
-        inTop = 0;
-        inBottom = inHeight - 1;
-    }
-    else {
-        if (topLeft.x() < 0)
-            inLeft = 0;
-        else if (topLeft.x() > inWidth - 1)
-            inLeft = inWidth - 1;
-
-        if (topLeft.y() < 0)
-            inTop = 0;
-        else if (topLeft.y() > inHeight - 1)
-            inTop = inHeight - 1;
-
-        if (bottomRight.x() < 0)
-            inRight = 0;
-        else if (bottomRight.x() > inWidth - 1)
-            inRight = inWidth - 1;
-
-        if (bottomRight.y() < 0)
-            inBottom = 0;
-        else if (bottomRight.y() > inHeight - 1)
-            inBottom = inHeight - 1;
-
-        if (inRight < inLeft)
-            inRight = inLeft;
-        if (inBottom < inTop)
-            inBottom = inTop;
-    }
-
-
-    int outWidth = inRight - inLeft + 1;
-    int outHeight = inBottom - inTop + 1;
-
-    // Размер выходной матрицы
-    outMatrix->resize(QSize(outWidth, outHeight));
-
-    // Указатели на данные матриц
-    int** outData = outMatrix->getData();
-    int** inData = inMatrix.getData();
-    int** wData = wMatrix.getData();
     // Временные переменные
     long long waveletSum = 0;       // Сумма при вычислении свёртки
     int inX = 0, inY = 0;           // Координаты элемента исходной матрицы
 
-    for (int i = inLeft, oi = 0; i <= inRight; ++i, ++oi)
-        for (int j = inTop, oj = 0; j <= inBottom; ++j, ++oj) {
+    for (int j = region.top(), oj = 0; j <= region.bottom(); ++j, ++oj) {
+        int* outRow = outMatrix.getRow(oj);         // Строка выходной матрицы
+        for (int i = region.left(), oi = 0; i <= region.right(); ++i, ++oi) {
             // Вычислить свёртку для текущего элемента
             waveletSum = 0;
-            for (int wi = 0; wi < wWidth; ++wi) {
-                inX = i - wXCenter + wi;
-                for (int wj = 0; wj < wHeight; ++wj) {
-                    inY = j - wYCenter + wj;
-                    if (inX >= 0 && inX < inWidth &&
-                            inY >= 0 && inY < inHeight)
-                        waveletSum += ((long long) inData[inX][inY]) * wData[wi][wj];
+            for (int wj = 0; wj < wHeight; ++wj) {
+                inY = Matrix::getBorderIndex(j - wYCenter + wj, inHeight, borderMode);
+                const int* wRow = wMatrix.getRow(wj);
+                const int* inRow = (inY >= 0) ? inMatrix.getRow(inY) : NULL;
+                for (int wi = 0; wi < wWidth; ++wi) {
+                    inX = Matrix::getBorderIndex(i - wXCenter + wi, inWidth, borderMode);
+                    if (inRow != NULL && inX >= 0)
+                        waveletSum += ((long long) inRow[inX]) * wRow[wi];
                     else
-                        waveletSum += ((long long) outsideValue) * wData[wi][wj];
+                        waveletSum += ((long long) outsideValue) * wRow[wi];
                 }
             }
-            outData[oi][oj] = waveletSum / wCount;
+            outRow[oi] = waveletSum / wCount;
         }
+    }
+}
+
+
+// Вычислить свёртку области region, в которой вейвлет целиком лежит внутри матрицы данных
+void Wavelet::imposeInner(const Matrix::MatrixView<int>& outMatrix,
+                          const Matrix::MatrixView<const int>& inMatrix,
+                          const Matrix::MatrixView<const int>& wMatrix,
+                          const QRect& region)
+{
+    imposeInnerRows(outMatrix, inMatrix, wMatrix, region);
 }
+
+
+namespace {
+
+    template <class T>
+    void imposeInnerRows(const Matrix::MatrixView<int>& outMatrix,
+                         const Matrix::MatrixView<const T>& inMatrix,
+                         const Matrix::MatrixView<const int>& wMatrix,
+                         const QRect& region)
+    {
+        Q_ASSERT (outMatrix.getSize() == region.size());
+
+        const int wWidth = wMatrix.getWidth();
+        const int wHeight = wMatrix.getHeight();
+        const int wXCenter = wWidth / 2;
+        const int wYCenter = wHeight / 2;
+        const int wCount = wWidth * wHeight;
+
+        // Данные, участвующие в вычислении
+        const QRect used(region.adjusted(-wXCenter, -wYCenter,
+                                         wWidth - 1 - wXCenter, wHeight - 1 - wYCenter));
+        Q_ASSERT (QRect(QPoint(0, 0), inMatrix.getSize()).contains(used));
+
+        WaveletTaps taps;
+        getWaveletTaps(&taps, wMatrix);
+        const int tapCount = taps.points.size();
+
+        // Максимальное по модулю значение данных
+        qint64 inAbsMax = 0;
+        for (int y = used.top(); y <= used.bottom(); ++y) {
+            const T* inRow = inMatrix.getRow(y);
+            for (int x = used.left(); x <= used.right(); ++x)
+                inAbsMax = qMax(inAbsMax, qAbs((qint64) inRow[x]));
+        }
+
+        // Суммы помещаются в 32-битное целое: векторное вычисление
+        const bool narrow = taps.absSum * inAbsMax <= (qint64) INT_MAX;
+
+        QVector<const T*> rows(tapCount);
+        QVector<qint32> acc(narrow ? region.width() : 0);
+        QVector<qint64> wideAcc(narrow ? 0 : region.width());
+
+        for (int j = region.top(), oj = 0; j <= region.bottom(); ++j, ++oj) {
+            for (int t = 0; t < tapCount; ++t) {
+                const QPoint& tap = taps.points.at(t);
+                rows[t] = inMatrix.getRow(j - wYCenter + tap.y()) + region.left() - wXCenter + tap.x();
+            }
+
+            int* outRow = outMatrix.getRow(oj);
+            if (narrow) {
+                accumulateTaps(acc.data(), region.width(), rows.constData(),
+                               taps.coefs.constData(), tapCount);
+                for (int oi = 0; oi < region.width(); ++oi)
+                    outRow[oi] = acc.at(oi) / wCount;
+            } else {
+                // Суммирование в 64-битных целых
+                qint64* wide = wideAcc.data();
+                for (int oi = 0; oi < region.width(); ++oi)
+                    wide[oi] = 0;
+                for (int t = 0; t < tapCount; ++t) {
+                    const T* row = rows.at(t);
+                    const qint64 c = taps.coefs.at(t);
+                    for (int oi = 0; oi < region.width(); ++oi)
+                        wide[oi] += c * row[oi];
+                }
+                for (int oi = 0; oi < region.width(); ++oi)
+                    outRow[oi] = wide[oi] / wCount;
+            }
+        }
+    }
+
+}   // namespace
@@ -3,9 +3,11 @@
 
 #include <QSize>
 #include <QPoint>
+#include <QRect>
 #include <cmath>
 
 #include "matrix.h"
+#include "matrixutils.h"
 
 namespace Wavelet {
 
@@ -43,8 +45,29 @@ namespace Wavelet {
     }
 
 
+    // ФУНКТОРЫ ВЕЙВЛЕТОВ:
+    // Вызов функтора встраивается в цикл построения матрицы вейвлета
+    // (в отличие от вызова по указателю на функцию).
+    // Id - уникальный идентификатор вейвлета (ключ кеша матриц, см. KernelCache).
+    struct Fhat {
+        enum { Id = 1 };
+        float operator()(float t) const { return getFhat(t); }
+    };
+
+    struct Mhat {
+        enum { Id = 2 };
+        float operator()(float t) const { return getMhat(t); }
+    };
+
+    struct Fhat2d {
+        enum { Id = 3 };
+        float operator()(float t) const { return getFhat2d(t); }
+    };
+
+
     // Получить квадратную матрицу out вейвлета fun, размером size и
     // с масштабом значений ratio.
+    // fun - функтор вейвлета (см. Fhat2d) или указатель на функцию float(float).
     // Возвращает квадратную матрицу out с нечётным числом строк и столбцов.
     // Размер стороны матрицы при различных значениях заданного размера size:
     // mSize = size * 2 + 1, или:
@@ -54,11 +77,12 @@ namespace Wavelet {
     // и т.д.
     // ratio - масштабирующий коэффициент результирующих значений вейвлета
     // (результирующие значения вейвлета заданы в интервале от -1.0 до +1.0)
-    template<class T>
-    void getWavelet2dMatrix(Matrix::Matrix2D<T>* out, float (*fun)(float), unsigned int size, float ratio)
+    // Матрица симметрична относительно центра, поэтому значения вычисляются
+    // для одной четверти и отражаются в остальные.
+    template<class T, class F>
+    void getWavelet2dMatrix(Matrix::Matrix2D<T>* out, F fun, unsigned int size, float ratio)
     {
         Q_ASSERT (out);
-        Q_ASSERT (fun);
 
         // Центр вейвлета по оси Х находится на пикселе с индексом:
         // (int) [mSize / 2], где
@@ -68,24 +92,31 @@ namespace Wavelet {
 
         // Итоговая матрица, которая инициализирована необходимым размером
         out->resize(QSize(MSize, MSize));
-        T** data = out->getData();      // Указатель на память данных матрицы
 
         const float Center = (float) MSize / 2;     // Центр вейвлета по обоим осям
-
-        for (int i = 0; i < MSize; ++i)
-            for (int j = 0; j < MSize; ++j) {
-                // Берём центр указанного пиксела
-                // и считаем расстояние до центрального узла матрицы
+        const int Half = MSize / 2;                 // Индекс центрального элемента
+
+        for (int j = 0; j <= Half; ++j) {
+            T* row = out->getRow(j);                    // Указатель на строку матрицы
+            T* mirrorRow = out->getRow(MSize - 1 - j);  // Симметричная строка
+            // Берём центр указанного пиксела
+            // и считаем расстояние до центрального узла матрицы
+            float dy = fabs(Center - j - 0.5);
+            for (int i = 0; i <= Half; ++i) {
                 float dx = fabs(Center - i - 0.5);
-                float dy = fabs(Center - j - 0.5);
                 float d = sqrt(dx * dx + dy *dy);  // расстояние до центра матрицы
 
                 // Найти значение вейвлета (от -1.0 до +1.0)
                 float v = fun( d / Center );
 
                 // Отмасштабировать и сохранить
-                data[i][j] = (T) (v * ratio);
+                const T value = (T) (v * ratio);
+                row[i] = value;
+                row[MSize - 1 - i] = value;
+                mirrorRow[i] = value;
+                mirrorRow[MSize - 1 - i] = value;
             }
+        }
     }
 
 
@@ -94,10 +125,18 @@ namespace Wavelet {
     // Размер итоговой матрицы outMatrix меньше или равен inMatrix
     // (зависит от параметров topLeft и bottomRight).
     // Наложение матрицы вейвлета производится на область матрицы данных inMatrix
-    // ограниченная topLeft, и bottomRight.
+    // ограниченная topLeft, и bottomRight (включительно). Координаты области
+    // ограничиваются размерами inMatrix. Элементы inMatrix за пределами
+    // области участвуют в вычислении свёртки.
     // Если topLeft и bottomRight инициализированы по-умолчанию,
     // то вычисляется вся входная матрица данных.
     // Процедура оптимизирована для целочисленного вычисления.
+    // Элементы, для которых вейвлет целиком лежит внутри матрицы данных,
+    // вычисляются непосредственно по inMatrix, а для граничных полос
+    // данные предварительно дополняются за пределами матрицы (см. Matrix::padMatrix),
+    // поэтому во внутреннем цикле нет проверок выхода за границы (см. imposeInner).
+    // Полосы строк результата вычисляются параллельно в глобальном пуле потоков
+    // (см. Parallel::forRange), в том числе если вызов выполняется в задаче пула.
     // Внимание!!!
     // Необходимо следить за тем, чтобы произведение максимальных
     // значений inMatrix и wMatrix не превышало по модулю 2^31 или 2 147 483 648!
@@ -107,12 +146,102 @@ namespace Wavelet {
     // порога 2^31.
     // outsideValue - значение, которое используется при вычислении свёртки,
     // если вейвлет выходит за пределы матрицы входных данных. По-умолчанию принимается = 0.
+    // borderMode - способ продолжения данных за пределы матрицы
+    // (outsideValue используется только для Matrix::Border_Constant).
     void imposeWavelet(Matrix::Matrix2D<int>* outMatrix,
-                       const Matrix::Matrix2D<int>& inMatrix,
-                       const Matrix::Matrix2D<int>& wMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
                        int outsideValue = 0,
                        const QPoint& topLeft = QPoint(-1, -1),
-                       const QPoint& bottomRight = QPoint(-1, -1));
+                       const QPoint& bottomRight = QPoint(-1, -1),
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+
+
+    // Наложить матрицу вейвлета wMatrix на область region матрицы данных inMatrix
+    // и записать результат в представление outMatrix (без выделения памяти).
+    // Размер outMatrix должен совпадать с размером region,
+    // а region - лежать внутри inMatrix.
+    // Перегрузки для 16- и 8-битных матриц данных без знака (например,
+    // оттенков серого) вычисляются так же, но читают в 2-4 раза меньше данных
+    // (элементы расширяются до 32 бит при суммировании, см. accumulateTaps).
+    // Для них outsideValue с Matrix::Border_Constant должно помещаться в тип элемента.
+    void imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+    void imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                       const Matrix::MatrixView<const quint16>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+    void imposeWavelet(const Matrix::MatrixView<int>& outMatrix,
+                       const Matrix::MatrixView<const quint8>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant);
+
+
+    // Наложить матрицу вейвлета wMatrix на область region матрицы данных inMatrix
+    // и учесть элементы результата в extremums (координаты - относительно region,
+    // см. Matrix::findExtremums). Полосы строк результата сразу после вычисления
+    // просматриваются в поиске экстремумов, поэтому матрица результата
+    // размером region не требуется. Если задано представление outMatrix
+    // размером region, то результат также записывается в него (для отладки).
+    // Перегрузки для 16- и 8-битных матриц данных - как для представления outMatrix.
+    void imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                       const Matrix::MatrixView<const int>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant,
+                       const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+    void imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                       const Matrix::MatrixView<const quint16>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant,
+                       const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+    void imposeWavelet(Matrix::ExtremumsAccumulator* extremums,
+                       const Matrix::MatrixView<const quint8>& inMatrix,
+                       const Matrix::MatrixView<const int>& wMatrix,
+                       int outsideValue,
+                       const QRect& region,
+                       Matrix::BorderMode borderMode = Matrix::Border_Constant,
+                       const Matrix::MatrixView<int>& outMatrix = Matrix::MatrixView<int>());
+
+
+    // Вычислить свёртку области region прямым суммированием с проверкой
+    // выхода за границы для каждого элемента вейвлета
+    // (эталонная реализация imposeWavelet для сравнения результатов).
+    void imposeReference(const Matrix::MatrixView<int>& outMatrix,
+                         const Matrix::MatrixView<const int>& inMatrix,
+                         const Matrix::MatrixView<const int>& wMatrix,
+                         int outsideValue,
+                         const QRect& region,
+                         Matrix::BorderMode borderMode = Matrix::Border_Constant);
+
+
+    // Вычислить свёртку области region, для каждого элемента которой вейвлет
+    // целиком лежит внутри матрицы данных (без проверок выхода за границы).
+    // Если произведение максимального модуля данных на сумму модулей элементов
+    // вейвлета не превышает 2^31, то суммы вычисляются в 32-битных целых
+    // векторными инструкциями (см. Simd::getLevel()), иначе - в 64-битных.
+    void imposeInner(const Matrix::MatrixView<int>& outMatrix,
+                     const Matrix::MatrixView<const int>& inMatrix,
+                     const Matrix::MatrixView<const int>& wMatrix,
+                     const QRect& region);
+
+
+    // Получить обрабатываемую область матрицы размером inSize
+    // по границам topLeft и bottomRight (см. imposeWavelet)
+    QRect getImposeRegion(const QSize& inSize,
+                          const QPoint& topLeft = QPoint(-1, -1),
+                          const QPoint& bottomRight = QPoint(-1, -1));
 
 
 }   // namespace Wavelet
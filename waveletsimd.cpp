@@ -0,0 +1,220 @@
+#include "waveletsimd.h"
+
+#include "simd.h"
+
+#include <cstring>
+
+#if defined(SIMD_X86)
+#  include <immintrin.h>
+#endif
+
+namespace {
+
+    // Скалярная реализация.
+    // Вычисление по модулю 2^32 (в беззнаковых целых), как и в векторных реализациях
+    template <class T>
+    void accumulateScalar(qint32* acc, int count,
+                          const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        quint32* a = reinterpret_cast<quint32*>(acc);
+        for (int x = 0; x < count; ++x)
+            a[x] = 0;
+        for (int t = 0; t < tapCount; ++t) {
+            const T* row = rows[t];
+            const quint32 c = (quint32) coefs[t];
+            for (int x = 0; x < count; ++x)
+                a[x] += c * (quint32) row[x];
+        }
+    }
+
+#if defined(SIMD_X86)
+    // Остаток строки, не кратный ширине вектора
+    template <class T>
+    inline void accumulateTail(qint32* acc, int begin, int count,
+                               const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        for (int x = begin; x < count; ++x) {
+            quint32 s = 0;
+            for (int t = 0; t < tapCount; ++t)
+                s += (quint32) coefs[t] * (quint32) rows[t][x];
+            acc[x] = (qint32) s;
+        }
+    }
+
+
+    // Загрузить элементы данных, расширенные до 32 бит
+    // (4 элемента для SSE4.1, 8 - для AVX2, 16 - для AVX-512)
+    SIMD_TARGET("sse4.1")
+    inline __m128i loadSse41(const int* p) { return _mm_loadu_si128((const __m128i*) p); }
+    SIMD_TARGET("sse4.1")
+    inline __m128i loadSse41(const quint16* p) { return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*) p)); }
+    SIMD_TARGET("sse4.1")
+    inline __m128i loadSse41(const quint8* p) {
+        int v;
+        memcpy(&v, p, sizeof(v));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+    }
+
+    SIMD_TARGET("avx2")
+    inline __m256i loadAvx2(const int* p) { return _mm256_loadu_si256((const __m256i*) p); }
+    SIMD_TARGET("avx2")
+    inline __m256i loadAvx2(const quint16* p) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) p)); }
+    SIMD_TARGET("avx2")
+    inline __m256i loadAvx2(const quint8* p) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) p)); }
+
+    SIMD_TARGET("avx512f")
+    inline __m512i loadAvx512(const int* p) { return _mm512_loadu_si512(p); }
+    SIMD_TARGET("avx512f")
+    inline __m512i loadAvx512(const quint16* p) { return _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*) p)); }
+    SIMD_TARGET("avx512f")
+    inline __m512i loadAvx512(const quint8* p) { return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) p)); }
+
+
+    // Реализация SSE4.1: блоки по 16 элементов (4 регистра), затем по 4
+    template <class T>
+    SIMD_TARGET("sse4.1")
+    void accumulateSse41(qint32* acc, int count,
+                         const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        int x = 0;
+        for (; x + 16 <= count; x += 16) {
+            __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+            __m128i a2 = _mm_setzero_si128(), a3 = _mm_setzero_si128();
+            for (int t = 0; t < tapCount; ++t) {
+                const __m128i c = _mm_set1_epi32(coefs[t]);
+                const T* p = rows[t] + x;
+                a0 = _mm_add_epi32(a0, _mm_mullo_epi32(c, loadSse41(p)));
+                a1 = _mm_add_epi32(a1, _mm_mullo_epi32(c, loadSse41(p + 4)));
+                a2 = _mm_add_epi32(a2, _mm_mullo_epi32(c, loadSse41(p + 8)));
+                a3 = _mm_add_epi32(a3, _mm_mullo_epi32(c, loadSse41(p + 12)));
+            }
+            _mm_storeu_si128((__m128i*) (acc + x), a0);
+            _mm_storeu_si128((__m128i*) (acc + x + 4), a1);
+            _mm_storeu_si128((__m128i*) (acc + x + 8), a2);
+            _mm_storeu_si128((__m128i*) (acc + x + 12), a3);
+        }
+        for (; x + 4 <= count; x += 4) {
+            __m128i a = _mm_setzero_si128();
+            for (int t = 0; t < tapCount; ++t)
+                a = _mm_add_epi32(a, _mm_mullo_epi32(_mm_set1_epi32(coefs[t]), loadSse41(rows[t] + x)));
+            _mm_storeu_si128((__m128i*) (acc + x), a);
+        }
+        accumulateTail(acc, x, count, rows, coefs, tapCount);
+    }
+
+
+    // Реализация AVX2: блоки по 32 элемента (4 регистра), затем по 8
+    template <class T>
+    SIMD_TARGET("avx2")
+    void accumulateAvx2(qint32* acc, int count,
+                        const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        int x = 0;
+        for (; x + 32 <= count; x += 32) {
+            __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+            __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+            for (int t = 0; t < tapCount; ++t) {
+                const __m256i c = _mm256_set1_epi32(coefs[t]);
+                const T* p = rows[t] + x;
+                a0 = _mm256_add_epi32(a0, _mm256_mullo_epi32(c, loadAvx2(p)));
+                a1 = _mm256_add_epi32(a1, _mm256_mullo_epi32(c, loadAvx2(p + 8)));
+                a2 = _mm256_add_epi32(a2, _mm256_mullo_epi32(c, loadAvx2(p + 16)));
+                a3 = _mm256_add_epi32(a3, _mm256_mullo_epi32(c, loadAvx2(p + 24)));
+            }
+            _mm256_storeu_si256((__m256i*) (acc + x), a0);
+            _mm256_storeu_si256((__m256i*) (acc + x + 8), a1);
+            _mm256_storeu_si256((__m256i*) (acc + x + 16), a2);
+            _mm256_storeu_si256((__m256i*) (acc + x + 24), a3);
+        }
+        for (; x + 8 <= count; x += 8) {
+            __m256i a = _mm256_setzero_si256();
+            for (int t = 0; t < tapCount; ++t)
+                a = _mm256_add_epi32(a, _mm256_mullo_epi32(_mm256_set1_epi32(coefs[t]), loadAvx2(rows[t] + x)));
+            _mm256_storeu_si256((__m256i*) (acc + x), a);
+        }
+        accumulateTail(acc, x, count, rows, coefs, tapCount);
+    }
+
+
+    // Реализация AVX-512: блоки по 64 элемента (4 регистра), затем по 16
+    template <class T>
+    SIMD_TARGET("avx512f")
+    void accumulateAvx512(qint32* acc, int count,
+                          const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        int x = 0;
+        for (; x + 64 <= count; x += 64) {
+            __m512i a0 = _mm512_setzero_si512(), a1 = _mm512_setzero_si512();
+            __m512i a2 = _mm512_setzero_si512(), a3 = _mm512_setzero_si512();
+            for (int t = 0; t < tapCount; ++t) {
+                const __m512i c = _mm512_set1_epi32(coefs[t]);
+                const T* p = rows[t] + x;
+                a0 = _mm512_add_epi32(a0, _mm512_mullo_epi32(c, loadAvx512(p)));
+                a1 = _mm512_add_epi32(a1, _mm512_mullo_epi32(c, loadAvx512(p + 16)));
+                a2 = _mm512_add_epi32(a2, _mm512_mullo_epi32(c, loadAvx512(p + 32)));
+                a3 = _mm512_add_epi32(a3, _mm512_mullo_epi32(c, loadAvx512(p + 48)));
+            }
+            _mm512_storeu_si512(acc + x, a0);
+            _mm512_storeu_si512(acc + x + 16, a1);
+            _mm512_storeu_si512(acc + x + 32, a2);
+            _mm512_storeu_si512(acc + x + 48, a3);
+        }
+        for (; x + 16 <= count; x += 16) {
+            __m512i a = _mm512_setzero_si512();
+            for (int t = 0; t < tapCount; ++t)
+                a = _mm512_add_epi32(a, _mm512_mullo_epi32(_mm512_set1_epi32(coefs[t]), loadAvx512(rows[t] + x)));
+            _mm512_storeu_si512(acc + x, a);
+        }
+        accumulateTail(acc, x, count, rows, coefs, tapCount);
+    }
+#endif
+
+
+    // Выбрать реализацию по Simd::getLevel()
+    template <class T>
+    void accumulate(qint32* acc, int count, const T* const* rows, const qint32* coefs, int tapCount)
+    {
+        Q_ASSERT (acc);
+        Q_ASSERT (count >= 0);
+        Q_ASSERT (tapCount == 0 || (rows && coefs));
+
+        switch (Simd::getLevel()) {
+#if defined(SIMD_X86)
+        case Simd::Level_Avx512:
+            accumulateAvx512(acc, count, rows, coefs, tapCount);
+            return;
+        case Simd::Level_Avx2:
+            accumulateAvx2(acc, count, rows, coefs, tapCount);
+            return;
+        case Simd::Level_Sse41:
+            accumulateSse41(acc, count, rows, coefs, tapCount);
+            return;
+#endif
+        default:
+            accumulateScalar(acc, count, rows, coefs, tapCount);
+            return;
+        }
+    }
+
+}   // namespace
+
+
+void Wavelet::accumulateTaps(qint32* acc, int count,
+                             const int* const* rows, const qint32* coefs, int tapCount)
+{
+    accumulate(acc, count, rows, coefs, tapCount);
+}
+
+
+void Wavelet::accumulateTaps(qint32* acc, int count,
+                             const quint16* const* rows, const qint32* coefs, int tapCount)
+{
+    accumulate(acc, count, rows, coefs, tapCount);
+}
+
+
+void Wavelet::accumulateTaps(qint32* acc, int count,
+                             const quint8* const* rows, const qint32* coefs, int tapCount)
+{
+    accumulate(acc, count, rows, coefs, tapCount);
+}
@@ -0,0 +1,30 @@
+#ifndef WAVELETSIMD_H
+#define WAVELETSIMD_H
+
+#include <QtGlobal>
+
+namespace Wavelet {
+
+    // Просуммировать вклады элементов вейвлета для count подряд идущих
+    // элементов строки результата:
+    // acc[x] = sum(t < tapCount) coefs[t] * rows[t][x], x < count.
+    // rows[t] - указатель на элемент данных, соответствующий первому элементу
+    // результата и элементу вейвлета t.
+    // Вычисление ведётся в 32-битных целых по модулю 2^32: результат точен,
+    // если итоговая сумма помещается в qint32 (частичные суммы могут
+    // переполняться, например при суммировании префиксных сумм).
+    // Реализация (скалярная, SSE4.1, AVX2, AVX-512) выбирается
+    // по Simd::getLevel(), результаты всех реализаций совпадают.
+    void accumulateTaps(qint32* acc, int count,
+                        const int* const* rows, const qint32* coefs, int tapCount);
+
+    // То же для 16- и 8-битных данных без знака
+    // (элементы расширяются до 32 бит при загрузке)
+    void accumulateTaps(qint32* acc, int count,
+                        const quint16* const* rows, const qint32* coefs, int tapCount);
+    void accumulateTaps(qint32* acc, int count,
+                        const quint8* const* rows, const qint32* coefs, int tapCount);
+
+}   // namespace Wavelet
+
+#endif // WAVELETSIMD_H